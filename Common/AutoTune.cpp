@@ -0,0 +1,146 @@
+/** File:    AutoTune.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "AutoTune.h"
+#include "BenchReport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
+
+#define MAX_CANDIDATES 64
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static RelaxConfig make_config(int scheme, int threads, int bandRows)
+{
+    RelaxConfig config;
+    config.scheme = scheme;
+    config.threads = threads;
+    config.bandRows = bandRows;
+    return config;
+}
+
+//the cached config of the combination, 0 if there is none
+static int find_cached(const char *cachePath, const char *solver, int width, int height, int cpus, const char *model,
+                       RelaxConfig *config)
+{
+    FILE *file = fopen(cachePath, "r");
+    if(!file) return 0;
+
+    char line[512];
+    int found = 0;
+    while(!found && fgets(line, sizeof(line), file))
+    {
+        char lineSolver[64];
+        char scheme[32];
+        int lineWidth;
+        int lineHeight;
+        int lineCpus;
+        RelaxConfig lineConfig;
+        float nsPerCell;
+        int modelStart = 0;
+        if(sscanf(line, "%63s %dx%d %d %31s %d %d %f %n", lineSolver, &lineWidth, &lineHeight, &lineCpus, scheme,
+                  &lineConfig.threads, &lineConfig.bandRows, &nsPerCell, &modelStart) != 8 || modelStart == 0) continue;
+        line[strcspn(line, "\r\n")] = '\0';
+
+        lineConfig.scheme = relaxSchemeByName(scheme);
+        if(lineConfig.scheme == RELAX_SCHEMES) continue;
+        if(strcmp(lineSolver, solver) != 0 || lineWidth != width || lineHeight != height || lineCpus != cpus) continue;
+        if(strcmp(line+modelStart, model) != 0) continue;
+        *config = lineConfig;
+        found = 1;
+    }
+    fclose(file);
+    return found;
+}
+
+int autoTuneRelax(const char *solver, int width, int height, const char *cachePath, double budget, RelaxConfig *config)
+{
+    int cpus = (int)std::thread::hardware_concurrency();
+    if(cpus < 1) cpus = 1;
+    char model[128];
+    readCpuModel(model, sizeof(model));
+    if(find_cached(cachePath, solver, width, height, cpus, model, config)) return 1;
+
+    RelaxConfig candidates[MAX_CANDIDATES];
+    int numCandidates = 0;
+    candidates[numCandidates++] = make_config(RELAX_COLUMNS, 1, 1);
+    candidates[numCandidates++] = make_config(RELAX_ROWS, 1, 1);
+    for(int threads=1; threads<=cpus && numCandidates+3<=MAX_CANDIDATES; threads*=2)
+    {
+        for(int bandRows=4; bandRows<=64; bandRows*=4) candidates[numCandidates++] = make_config(RELAX_REDBLACK, threads, bandRows);
+    }
+
+    //a smooth right hand side; relaxing it converges the same way the pressure solve does
+    int total = width*height;
+    float *x = (float *)calloc(total, sizeof(float));
+    float *b = (float *)malloc(sizeof(float)*total);
+    for(int k=0; k<total; k++) b[k] = (float)((k%width)*(k/width)%17)*0.01f;
+
+    //every candidate gets its share of the budget, at least three sweeps after a warmup
+    Relax relax;
+    double best = 1e30;
+    double cells = (double)(width-2)*(height-2);
+    for(int k=0; k<numCandidates; k++)
+    {
+        relax.setConfig(candidates[k]);
+        relax.sweep(x, b, width, 1, width-2, 1, height-2, 1.0f, 4.0f);
+
+        double shortest = 1e30;
+        double start = now();
+        int sweeps = 0;
+        do
+        {
+            double sweepStart = now();
+            relax.sweep(x, b, width, 1, width-2, 1, height-2, 1.0f, 4.0f);
+            double time = now()-sweepStart;
+            if(time < shortest) shortest = time;
+            sweeps++;
+        }while(sweeps < 3 || now()-start < budget/numCandidates);
+
+        if(shortest < best)
+        {
+            best = shortest;
+            *config = candidates[k];
+        }
+    }
+    free(x);
+    free(b);
+
+    printf("autotune: %s %dx%d uses %s, %d thread%s, %d rows per band, %.3f ns/cell\n", solver, width, height,
+           relaxSchemeName(config->scheme), config->threads, config->threads > 1 ? "s" : "", config->bandRows, best/cells*1e9);
+
+    FILE *file = fopen(cachePath, "a");
+    if(!file)
+    {
+        perror(cachePath);
+        return 0;
+    }
+    fprintf(file, "%s %dx%d %d %s %d %d %.3f %s\n", solver, width, height, cpus, relaxSchemeName(config->scheme),
+            config->threads, config->bandRows, best/cells*1e9, model);
+    fclose(file);
+    return 0;
+}
@@ -0,0 +1,40 @@
+/** File:    AutoTune.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __AUTOTUNE_H__
+#define __AUTOTUNE_H__
+
+#include "Relax.h"
+
+//picks the fastest relaxation the first time a solver meets a grid size on a
+//machine, and remembers it in a cache file of one line per combination
+//  solver widthxheight cpus scheme threads bandRows ns/cell cpu model
+//the candidates are every scheme, red-black on 1, 2, 4, ... up to the
+//hardware threads with a few band heights; each is timed on scratch arrays
+//of the solver's size, so the viewers pay for tuning once per host
+#define AUTOTUNE_CACHE "autotune.cache"
+#define AUTOTUNE_BUDGET 0.3
+
+//width x height floats, relaxing all but the outer ring. returns 1 if the
+//config came from the cache, 0 if it was timed now within about budget seconds
+int autoTuneRelax(const char *solver, int width, int height, const char *cachePath, double budget, RelaxConfig *config);
+
+#endif
@@ -0,0 +1,164 @@
+/** File:    BenchCompare.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+//compares two benchmark reports and flags the results that got slower
+//  benchcmp [-confidence percent] [-threshold percent] old.json new.json
+//every result of new that old has too is compared with Welch's t-test; the
+//change in the mean is given with its confidence interval, and a result is
+//flagged slower or faster when the whole interval lies beyond the threshold.
+//scenario rows are followed by their accuracy in both runs. the exit status
+//is 1 if anything got slower, 2 on bad input
+
+#include "BenchReport.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+//inverse of the standard normal cdf by Newton's method
+static double normal_quantile(double p)
+{
+    double z = 0.0;
+    for(int k=0; k<50; k++)
+    {
+        double cdf = 0.5*erfc(-z/sqrt(2.0));
+        double pdf = exp(-0.5*z*z)/sqrt(2.0*M_PI);
+        double step = (cdf-p)/pdf;
+        z -= step;
+        if(fabs(step) < 1e-12) break;
+    }
+    return z;
+}
+
+//two sided critical value of Student's t, Cornish-Fisher expansion around the
+//normal quantile; within 0.3% of the tables from 3 degrees of freedom at 95%
+static double t_critical(double confidence, double df)
+{
+    double z = normal_quantile(0.5+confidence/2.0);
+    double z2 = z*z;
+    double g1 = (z2+1.0)*z/4.0;
+    double g2 = ((5.0*z2+16.0)*z2+3.0)*z/96.0;
+    double g3 = (((3.0*z2+19.0)*z2+17.0)*z2-15.0)*z/384.0;
+    double g4 = ((((79.0*z2+776.0)*z2+1482.0)*z2-1920.0)*z2-945.0)*z/92160.0;
+    return z+g1/df+g2/(df*df)+g3/(df*df*df)+g4/(df*df*df*df);
+}
+
+static void print_accuracy(const char *label, double before, double after, const char *format, double scale)
+{
+    if(isnan(before) && isnan(after)) return;
+    char text[64];
+    printf("  %s ", label);
+    if(isnan(before)) printf("-");
+    else
+    {
+        snprintf(text, sizeof(text), format, before*scale);
+        printf("%s", text);
+    }
+    printf(" -> ");
+    if(isnan(after)) printf("-");
+    else
+    {
+        snprintf(text, sizeof(text), format, after*scale);
+        printf("%s", text);
+    }
+}
+
+int main(int argc, char **argv)
+{
+    double confidence = 0.95;
+    double threshold = 0.02;
+    int arg = 1;
+    for(; arg+1<argc && argv[arg][0] == '-'; arg+=2)
+    {
+        if(strcmp(argv[arg], "-confidence") == 0) confidence = atof(argv[arg+1])/100.0;
+        else if(strcmp(argv[arg], "-threshold") == 0) threshold = atof(argv[arg+1])/100.0;
+        else break;
+    }
+    if(argc-arg != 2 || confidence <= 0.0 || confidence >= 1.0 || threshold < 0.0)
+    {
+        fprintf(stderr, "usage: %s [-confidence percent] [-threshold percent] old.json new.json\n", argv[0]);
+        return 2;
+    }
+
+    BenchResults before;
+    BenchResults after;
+    if(!before.load(argv[arg]) || !after.load(argv[arg+1])) return 2;
+
+    printf("%s %s: %s -> %s\n", after.getSolver(), after.getTool(), before.getGitHash(), after.getGitHash());
+    if(strcmp(before.getSolver(), after.getSolver()) != 0 || strcmp(before.getTool(), after.getTool()) != 0)
+    {
+        printf("warning: comparing %s %s against %s %s\n", before.getSolver(), before.getTool(), after.getSolver(), after.getTool());
+    }
+    if(strcmp(before.getCpuModel(), after.getCpuModel()) != 0 || before.getThreads() != after.getThreads())
+    {
+        printf("warning: measured on different machines or thread counts\n  %s, %d threads\n  %s, %d threads\n",
+               before.getCpuModel(), before.getThreads(), after.getCpuModel(), after.getThreads());
+    }
+    printf("%.0f%% confidence, threshold %.1f%%\n", confidence*100.0, threshold*100.0);
+    printf("%-9s %-16s %6s %-8s %10s %10s %8s %20s\n", "kind", "name", "size", "metric", "old", "new", "change", "interval");
+
+    int slower = 0;
+    int compared = 0;
+    for(int k=0; k<after.getNumResults(); k++)
+    {
+        const BenchResult *b = after.getResult(k);
+        const BenchResult *a = before.find(b->kind, b->name, b->size);
+        if(!a || a->numSamples < 2 || b->numSamples < 2 || !(a->mean > 0.0)) continue;
+        compared++;
+
+        //Welch's t-test on the difference of the means, relative to the old mean
+        double va = a->stddev*a->stddev/a->numSamples;
+        double vb = b->stddev*b->stddev/b->numSamples;
+        double se = sqrt(va+vb);
+        double df = 1e6;
+        if(va+vb > 0.0) df = (va+vb)*(va+vb)/(va*va/(a->numSamples-1)+vb*vb/(b->numSamples-1));
+        double half = t_critical(confidence, df)*se;
+        double change = (b->mean-a->mean)/a->mean;
+        double low = (b->mean-a->mean-half)/a->mean;
+        double high = (b->mean-a->mean+half)/a->mean;
+
+        const char *verdict = "";
+        if(low > threshold)
+        {
+            verdict = "SLOWER";
+            slower++;
+        }
+        else if(high < -threshold) verdict = "faster";
+
+        char interval[64];
+        snprintf(interval, sizeof(interval), "[%+.1f%%, %+.1f%%]", low*100.0, high*100.0);
+        printf("%-9s %-16s %6d %-8s %10.4g %10.4g %+7.1f%% %20s %s\n", b->kind, b->name, b->size, b->metric,
+               a->mean, b->mean, change*100.0, interval, verdict);
+
+        if(strcmp(b->kind, "scenario") == 0)
+        {
+            printf("         ");
+            print_accuracy("div", a->divergence, b->divergence, "%.3e", 1.0);
+            print_accuracy("energy", a->energy, b->energy, "%+.2f%%", 100.0);
+            print_accuracy("L2", a->l2, b->l2, "%.2f%%", 100.0);
+            print_accuracy("mass", a->mass, b->mass, "%+.2f%%", 100.0);
+            printf("\n");
+        }
+    }
+
+    printf("%d of %d results slower\n", slower, compared);
+    return slower > 0 ? 1 : 0;
+}
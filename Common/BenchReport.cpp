@@ -0,0 +1,403 @@
+/** File:    BenchReport.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "BenchReport.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <time.h>
+#include <unistd.h>
+
+void initBenchResult(BenchResult *result, const char *kind, const char *name, int size, const char *metric,
+                     const double *samples, int numSamples)
+{
+    snprintf(result->kind, BENCH_NAME, "%s", kind);
+    snprintf(result->name, BENCH_NAME, "%s", name);
+    result->size = size;
+    snprintf(result->metric, BENCH_NAME, "%s", metric);
+    if(numSamples > BENCH_MAX_SAMPLES) numSamples = BENCH_MAX_SAMPLES;
+    result->numSamples = numSamples;
+
+    double sum = 0.0;
+    for(int k=0; k<numSamples; k++)
+    {
+        result->samples[k] = samples[k];
+        sum += samples[k];
+    }
+    result->mean = numSamples > 0 ? sum/numSamples : NAN;
+    double squares = 0.0;
+    for(int k=0; k<numSamples; k++) squares += (samples[k]-result->mean)*(samples[k]-result->mean);
+    result->stddev = numSamples > 1 ? sqrt(squares/(numSamples-1)) : 0.0;
+
+    result->divergence = NAN;
+    result->energy = NAN;
+    result->l2 = NAN;
+    result->mass = NAN;
+}
+
+void readCpuModel(char *text, int size)
+{
+    snprintf(text, size, "unknown");
+    FILE *info = fopen("/proc/cpuinfo", "r");
+    if(!info) return;
+    char line[256];
+    while(fgets(line, sizeof(line), info))
+    {
+        if(strncmp(line, "model name", 10) != 0) continue;
+        char *value = strchr(line, ':');
+        if(!value) continue;
+        value++;
+        while(*value == ' ' || *value == '\t') value++;
+        value[strcspn(value, "\r\n")] = '\0';
+        snprintf(text, size, "%s", value);
+        break;
+    }
+    fclose(info);
+}
+
+//first line of a command's output without the newline, empty if it fails
+static void command_line(const char *command, char *text, int size)
+{
+    text[0] = '\0';
+    FILE *pipe = popen(command, "r");
+    if(!pipe) return;
+    if(!fgets(text, size, pipe)) text[0] = '\0';
+    pclose(pipe);
+    text[strcspn(text, "\r\n")] = '\0';
+}
+
+static void put_string(FILE *file, const char *text)
+{
+    fputc('"', file);
+    for(const char *c=text; *c; c++)
+    {
+        if(*c == '"' || *c == '\\') fprintf(file, "\\%c", *c);
+        else if((unsigned char)*c < 0x20) fprintf(file, "\\u%04x", *c);
+        else fputc(*c, file);
+    }
+    fputc('"', file);
+}
+
+//JSON has no NAN or infinity
+static void put_number(FILE *file, double value)
+{
+    if(isfinite(value)) fprintf(file, "%.9g", value);
+    else fprintf(file, "null");
+}
+
+BenchReport::BenchReport()
+{
+    file = NULL;
+    numResults = 0;
+}
+
+BenchReport::~BenchReport()
+{
+    close();
+}
+
+int BenchReport::open(const char *path, const char *tool, const char *solver, int threads, int cpu)
+{
+    close();
+    file = fopen(path, "wb");
+    if(!file)
+    {
+        perror(path);
+        return 0;
+    }
+    numResults = 0;
+
+    //the hash of the tree the benchmark runs in, "-dirty" if it has local changes
+    char gitHash[BENCH_NAME];
+    command_line("git describe --always --dirty --abbrev=12 2>/dev/null", gitHash, sizeof(gitHash));
+    if(gitHash[0] == '\0') snprintf(gitHash, sizeof(gitHash), "unknown");
+    char model[BENCH_NAME*2];
+    readCpuModel(model, sizeof(model));
+    char date[BENCH_NAME];
+    time_t now = time(NULL);
+    strftime(date, sizeof(date), "%Y-%m-%dT%H:%M:%SZ", gmtime(&now));
+
+    fprintf(file, "{\n  \"tool\": ");
+    put_string(file, tool);
+    fprintf(file, ",\n  \"solver\": ");
+    put_string(file, solver);
+    fprintf(file, ",\n  \"gitHash\": ");
+    put_string(file, gitHash);
+    fprintf(file, ",\n  \"cpuModel\": ");
+    put_string(file, model);
+    fprintf(file, ",\n  \"cpus\": %ld,\n  \"threads\": %d,\n  \"cpu\": %d,\n  \"date\": ",
+            sysconf(_SC_NPROCESSORS_ONLN), threads, cpu);
+    put_string(file, date);
+    fprintf(file, ",\n  \"results\": [");
+    return 1;
+}
+
+void BenchReport::add(const BenchResult *result)
+{
+    if(!file) return;
+
+    fprintf(file, "%s\n    {\"kind\": ", numResults > 0 ? "," : "");
+    put_string(file, result->kind);
+    fprintf(file, ", \"name\": ");
+    put_string(file, result->name);
+    fprintf(file, ", \"size\": %d, \"metric\": ", result->size);
+    put_string(file, result->metric);
+    fprintf(file, ",\n     \"samples\": [");
+    for(int k=0; k<result->numSamples; k++)
+    {
+        if(k > 0) fprintf(file, ", ");
+        put_number(file, result->samples[k]);
+    }
+    fprintf(file, "], \"mean\": ");
+    put_number(file, result->mean);
+    fprintf(file, ", \"stddev\": ");
+    put_number(file, result->stddev);
+    fprintf(file, ",\n     \"divergence\": ");
+    put_number(file, result->divergence);
+    fprintf(file, ", \"energy\": ");
+    put_number(file, result->energy);
+    fprintf(file, ", \"l2\": ");
+    put_number(file, result->l2);
+    fprintf(file, ", \"mass\": ");
+    put_number(file, result->mass);
+    fprintf(file, "}");
+    numResults++;
+}
+
+int BenchReport::close()
+{
+    if(!file) return 1;
+    fprintf(file, "\n  ]\n}\n");
+    int ok = !ferror(file);
+    ok = fclose(file) == 0 && ok;
+    file = NULL;
+    return ok;
+}
+
+//just enough of a JSON reader for the reports above; unknown keys are skipped
+struct JsonCursor
+{
+    const char *pos;
+    const char *end;
+};
+
+static void skip_space(JsonCursor *json)
+{
+    while(json->pos < json->end && strchr(" \t\r\n", *json->pos)) json->pos++;
+}
+
+static int expect(JsonCursor *json, char c)
+{
+    skip_space(json);
+    if(json->pos >= json->end || *json->pos != c) return 0;
+    json->pos++;
+    return 1;
+}
+
+//the next character if it is one of chars, 0 otherwise
+static char peek(JsonCursor *json, const char *chars)
+{
+    skip_space(json);
+    if(json->pos >= json->end || !strchr(chars, *json->pos)) return 0;
+    return *json->pos;
+}
+
+//text is truncated to size, escapes other than \" and \\ come out as '?'
+static int parse_string(JsonCursor *json, char *text, int size)
+{
+    if(!expect(json, '"')) return 0;
+    int length = 0;
+    while(json->pos < json->end && *json->pos != '"')
+    {
+        char c = *json->pos++;
+        if(c == '\\')
+        {
+            if(json->pos >= json->end) return 0;
+            c = *json->pos++;
+            if(c == 'u') json->pos += 4;
+            if(c != '"' && c != '\\') c = '?';
+        }
+        if(length < size-1) text[length++] = c;
+    }
+    text[length] = '\0';
+    return expect(json, '"');
+}
+
+//null reads as NAN
+static int parse_number(JsonCursor *json, double *value)
+{
+    skip_space(json);
+    if(json->end-json->pos >= 4 && strncmp(json->pos, "null", 4) == 0)
+    {
+        json->pos += 4;
+        *value = NAN;
+        return 1;
+    }
+    char text[64];
+    int length = 0;
+    while(json->pos < json->end && strchr("+-.0123456789eE", *json->pos) && length < 63) text[length++] = *json->pos++;
+    text[length] = '\0';
+    char *stop;
+    *value = strtod(text, &stop);
+    return length > 0 && *stop == '\0';
+}
+
+static int skip_value(JsonCursor *json)
+{
+    char text[8];
+    double value;
+    char c = peek(json, "\"{[tfn");
+    if(c == '"') return parse_string(json, text, sizeof(text));
+    if(c == 't' || c == 'f' || c == 'n')
+    {
+        while(json->pos < json->end && *json->pos >= 'a' && *json->pos <= 'z') json->pos++;
+        return 1;
+    }
+    if(c != '{' && c != '[') return parse_number(json, &value);
+
+    char close = c == '{' ? '}' : ']';
+    json->pos++;
+    if(expect(json, close)) return 1;
+    do
+    {
+        if(c == '{' && (!parse_string(json, text, sizeof(text)) || !expect(json, ':'))) return 0;
+        if(!skip_value(json)) return 0;
+    }while(expect(json, ','));
+    return expect(json, close);
+}
+
+static int parse_result(JsonCursor *json, BenchResult *result)
+{
+    initBenchResult(result, "", "", 0, "", NULL, 0);
+    if(!expect(json, '{')) return 0;
+    if(expect(json, '}')) return 1;
+    do
+    {
+        char key[BENCH_NAME];
+        double value = 0.0;
+        if(!parse_string(json, key, sizeof(key)) || !expect(json, ':')) return 0;
+
+        int ok = 1;
+        if(strcmp(key, "kind") == 0) ok = parse_string(json, result->kind, BENCH_NAME);
+        else if(strcmp(key, "name") == 0) ok = parse_string(json, result->name, BENCH_NAME);
+        else if(strcmp(key, "metric") == 0) ok = parse_string(json, result->metric, BENCH_NAME);
+        else if(strcmp(key, "size") == 0)
+        {
+            ok = parse_number(json, &value);
+            result->size = (int)value;
+        }
+        else if(strcmp(key, "mean") == 0) ok = parse_number(json, &result->mean);
+        else if(strcmp(key, "stddev") == 0) ok = parse_number(json, &result->stddev);
+        else if(strcmp(key, "divergence") == 0) ok = parse_number(json, &result->divergence);
+        else if(strcmp(key, "energy") == 0) ok = parse_number(json, &result->energy);
+        else if(strcmp(key, "l2") == 0) ok = parse_number(json, &result->l2);
+        else if(strcmp(key, "mass") == 0) ok = parse_number(json, &result->mass);
+        else if(strcmp(key, "samples") == 0)
+        {
+            ok = expect(json, '[');
+            if(ok && !expect(json, ']'))
+            {
+                do
+                {
+                    ok = parse_number(json, &value);
+                    if(ok && result->numSamples < BENCH_MAX_SAMPLES) result->samples[result->numSamples++] = value;
+                }while(ok && expect(json, ','));
+                ok = ok && expect(json, ']');
+            }
+        }
+        else ok = skip_value(json);
+        if(!ok) return 0;
+    }while(expect(json, ','));
+    return expect(json, '}');
+}
+
+int BenchResults::load(const char *path)
+{
+    tool[0] = solver[0] = gitHash[0] = cpuModel[0] = date[0] = '\0';
+    threads = 0;
+    results.clear();
+
+    FILE *file = fopen(path, "rb");
+    if(!file)
+    {
+        perror(path);
+        return 0;
+    }
+    fseek(file, 0, SEEK_END);
+    long size = ftell(file);
+    fseek(file, 0, SEEK_SET);
+    char *text = (char *)malloc(size > 0 ? size : 1);
+    int ok = size > 0 && fread(text, 1, size, file) == (size_t)size;
+    fclose(file);
+
+    JsonCursor json = {text, text+(ok ? size : 0)};
+    ok = ok && expect(&json, '{');
+    if(ok && !expect(&json, '}'))
+    {
+        do
+        {
+            char key[BENCH_NAME];
+            double value = 0.0;
+            ok = parse_string(&json, key, sizeof(key)) && expect(&json, ':');
+            if(!ok) break;
+
+            if(strcmp(key, "tool") == 0) ok = parse_string(&json, tool, sizeof(tool));
+            else if(strcmp(key, "solver") == 0) ok = parse_string(&json, solver, sizeof(solver));
+            else if(strcmp(key, "gitHash") == 0) ok = parse_string(&json, gitHash, sizeof(gitHash));
+            else if(strcmp(key, "cpuModel") == 0) ok = parse_string(&json, cpuModel, sizeof(cpuModel));
+            else if(strcmp(key, "date") == 0) ok = parse_string(&json, date, sizeof(date));
+            else if(strcmp(key, "threads") == 0)
+            {
+                ok = parse_number(&json, &value);
+                threads = (int)value;
+            }
+            else if(strcmp(key, "results") == 0)
+            {
+                ok = expect(&json, '[');
+                if(ok && !expect(&json, ']'))
+                {
+                    do
+                    {
+                        BenchResult result;
+                        ok = parse_result(&json, &result);
+                        if(ok) results.push_back(result);
+                    }while(ok && expect(&json, ','));
+                    ok = ok && expect(&json, ']');
+                }
+            }
+            else ok = skip_value(&json);
+        }while(ok && expect(&json, ','));
+        ok = ok && expect(&json, '}');
+    }
+    free(text);
+
+    if(!ok) fprintf(stderr, "%s: not a benchmark report\n", path);
+    return ok;
+}
+
+const BenchResult* BenchResults::find(const char *kind, const char *name, int size)
+{
+    for(int k=0; k<(int)results.size(); k++)
+    {
+        if(results[k].size == size && strcmp(results[k].kind, kind) == 0 && strcmp(results[k].name, name) == 0) return &results[k];
+    }
+    return NULL;
+}
@@ -0,0 +1,111 @@
+/** File:    BenchReport.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __BENCHREPORT_H__
+#define __BENCHREPORT_H__
+
+#include <stdio.h>
+#include <vector>
+
+//benchmark results as JSON, for tracking performance across builds
+//  {"tool": "bench", "solver": "GridStable", "gitHash": "...", "cpuModel": "...",
+//   "cpus": 8, "threads": 1, "cpu": 0, "date": "...",
+//   "results": [{"kind": "kernel", "name": "advection", "size": 64, "metric": "ns/cell",
+//                "samples": [...], "mean": ..., "stddev": ...,
+//                "divergence": null, "energy": null, "l2": null, "mass": null}, ...]}
+//samples are independent repeats of the same measurement, lower is better;
+//the accuracy fields belong to scenarios and are null where they do not apply
+#define BENCH_MAX_SAMPLES 64
+#define BENCH_NAME 64
+
+struct BenchResult
+{
+    char kind[BENCH_NAME];
+    char name[BENCH_NAME];
+    int size;
+    char metric[BENCH_NAME];
+    int numSamples;
+    double samples[BENCH_MAX_SAMPLES];
+    double mean;
+    double stddev;
+
+    //NAN where they do not apply
+    double divergence;
+    double energy;
+    double l2;
+    double mass;
+};
+
+//fills in mean and stddev from the samples and sets the accuracy to NAN
+void initBenchResult(BenchResult *result, const char *kind, const char *name, int size, const char *metric,
+                     const double *samples, int numSamples);
+
+//the "model name" of /proc/cpuinfo, "unknown" where there is none
+void readCpuModel(char *text, int size);
+
+class BenchReport
+{
+public:
+    BenchReport();
+    ~BenchReport();
+
+    //threads the measurements ran on and the cpu they were pinned to, -1 for none;
+    //the git hash, cpu model and date are looked up here, returns 1 on success
+    int open(const char *path, const char *tool, const char *solver, int threads, int cpu);
+    int isOpen(){ return file != NULL; }
+    void add(const BenchResult *result);
+    //returns 1 if everything was written
+    int close();
+
+private:
+    FILE *file;
+    int numResults;
+};
+
+//a report read back
+class BenchResults
+{
+public:
+    //returns 1 on success, prints what is wrong otherwise
+    int load(const char *path);
+
+    const char* getTool(){ return tool; }
+    const char* getSolver(){ return solver; }
+    const char* getGitHash(){ return gitHash; }
+    const char* getCpuModel(){ return cpuModel; }
+    const char* getDate(){ return date; }
+    int getThreads(){ return threads; }
+    int getNumResults(){ return (int)results.size(); }
+    const BenchResult* getResult(int k){ return &results[k]; }
+    //NULL if there is no such result
+    const BenchResult* find(const char *kind, const char *name, int size);
+
+private:
+    char tool[BENCH_NAME];
+    char solver[BENCH_NAME];
+    char gitHash[BENCH_NAME];
+    char cpuModel[BENCH_NAME*2];
+    char date[BENCH_NAME];
+    int threads;
+    std::vector<BenchResult> results;
+};
+
+#endif
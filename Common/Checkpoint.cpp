@@ -0,0 +1,292 @@
+/** File:    Checkpoint.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Checkpoint.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+#define CHECKPOINT_MAX_ENTRIES 64
+#define BYTE_ORDER_MARK 0x01020304u
+
+static uint64_t alignUp(uint64_t value)
+{
+    return (value+CHECKPOINT_ALIGN-1)/CHECKPOINT_ALIGN*CHECKPOINT_ALIGN;
+}
+
+CheckpointWriter::CheckpointWriter()
+{
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, CHECKPOINT_MAGIC, 8);
+    header.version = CHECKPOINT_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+
+    params = (CheckpointParam *)calloc(CHECKPOINT_MAX_ENTRIES, sizeof(CheckpointParam));
+    fields = (CheckpointField *)calloc(CHECKPOINT_MAX_ENTRIES, sizeof(CheckpointField));
+    data = (const float **)calloc(CHECKPOINT_MAX_ENTRIES, sizeof(const float *));
+}
+
+CheckpointWriter::~CheckpointWriter()
+{
+    free(params);
+    free(fields);
+    free(data);
+}
+
+void CheckpointWriter::setSolver(const char *solver)
+{
+    memset(header.solver, 0, CHECKPOINT_NAME);
+    strncpy(header.solver, solver, CHECKPOINT_NAME-1);
+}
+
+void CheckpointWriter::addParam(const char *name, double value)
+{
+    if(header.numParams == CHECKPOINT_MAX_ENTRIES) return;
+
+    CheckpointParam *param = &params[header.numParams++];
+    strncpy(param->name, name, CHECKPOINT_NAME-1);
+    param->value = value;
+}
+
+void CheckpointWriter::addField(const char *name, const float *_data, int width, int height)
+{
+    if(header.numFields == CHECKPOINT_MAX_ENTRIES) return;
+
+    data[header.numFields] = _data;
+    CheckpointField *field = &fields[header.numFields++];
+    strncpy(field->name, name, CHECKPOINT_NAME-1);
+    field->width = width;
+    field->height = height;
+    field->bytes = (uint64_t)width*height*sizeof(float);
+}
+
+uint64_t CheckpointWriter::getFieldBytes()
+{
+    uint64_t bytes = 0;
+    for(uint32_t k=0; k<header.numFields; k++) bytes += fields[k].bytes;
+    return bytes;
+}
+
+void CheckpointWriter::copyFields(float *buffer)
+{
+    for(uint32_t k=0; k<header.numFields; k++)
+    {
+        memcpy(buffer, data[k], fields[k].bytes);
+        data[k] = buffer;
+        buffer += fields[k].bytes/sizeof(float);
+    }
+}
+
+static int writeAll(int fd, const void *buf, uint64_t bytes, uint64_t offset)
+{
+    const char *ptr = (const char *)buf;
+    while(bytes > 0)
+    {
+        ssize_t done = pwrite(fd, ptr, bytes, offset);
+        if(done <= 0) return 0;
+        ptr += done;
+        bytes -= done;
+        offset += done;
+    }
+    return 1;
+}
+
+int CheckpointWriter::write(const char *path)
+{
+    uint64_t offset = alignUp(sizeof(CheckpointHeader)+
+                              header.numParams*sizeof(CheckpointParam)+
+                              header.numFields*sizeof(CheckpointField));
+    for(uint32_t k=0; k<header.numFields; k++)
+    {
+        fields[k].offset = offset;
+        offset = alignUp(offset+fields[k].bytes);
+    }
+    header.fileSize = offset;
+
+    char tmpPath[1024];
+    snprintf(tmpPath, sizeof(tmpPath), "%s.tmp", path);
+
+    int fd = ::open(tmpPath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        perror(tmpPath);
+        return 0;
+    }
+
+    uint64_t pos = 0;
+    int ok = writeAll(fd, &header, sizeof(header), pos);
+    pos += sizeof(header);
+    ok = ok && writeAll(fd, params, header.numParams*sizeof(CheckpointParam), pos);
+    pos += header.numParams*sizeof(CheckpointParam);
+    ok = ok && writeAll(fd, fields, header.numFields*sizeof(CheckpointField), pos);
+    for(uint32_t k=0; k<header.numFields && ok; k++)
+    {
+        ok = writeAll(fd, data[k], fields[k].bytes, fields[k].offset);
+    }
+    ok = ok && ftruncate(fd, header.fileSize) == 0;
+    ok = ok && fdatasync(fd) == 0;
+    ok = (::close(fd) == 0) && ok;
+    ok = ok && rename(tmpPath, path) == 0;
+
+    if(!ok)
+    {
+        perror(path);
+        unlink(tmpPath);
+    }
+    return ok;
+}
+
+CheckpointReader::CheckpointReader()
+{
+    map = NULL;
+    mapSize = 0;
+    header = NULL;
+    params = NULL;
+    fields = NULL;
+}
+
+CheckpointReader::~CheckpointReader()
+{
+    close();
+}
+
+int CheckpointReader::open(const char *path, const char *solver)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        perror(path);
+        return 0;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(CheckpointHeader))
+    {
+        fprintf(stderr, "%s: not a checkpoint\n", path);
+        ::close(fd);
+        return 0;
+    }
+
+    void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(ptr == MAP_FAILED)
+    {
+        perror(path);
+        return 0;
+    }
+    map = (unsigned char *)ptr;
+    mapSize = st.st_size;
+    header = (CheckpointHeader *)map;
+    params = (CheckpointParam *)(map+sizeof(CheckpointHeader));
+    fields = (CheckpointField *)(params+header->numParams);
+
+    const char *error = NULL;
+    if(memcmp(header->magic, CHECKPOINT_MAGIC, 8) != 0) error = "not a checkpoint";
+    else if(header->version != CHECKPOINT_VERSION) error = "unsupported checkpoint version";
+    else if(header->byteOrder != BYTE_ORDER_MARK) error = "checkpoint written with another byte order";
+    else if(solver && strncmp(header->solver, solver, CHECKPOINT_NAME) != 0) error = "checkpoint of another solver";
+    else if(header->fileSize > mapSize ||
+            sizeof(CheckpointHeader)+header->numParams*sizeof(CheckpointParam)+
+            header->numFields*sizeof(CheckpointField) > mapSize) error = "truncated checkpoint";
+
+    for(uint32_t k=0; !error && k<header->numFields; k++)
+    {
+        if(fields[k].offset+fields[k].bytes > mapSize ||
+           fields[k].bytes != (uint64_t)fields[k].width*fields[k].height*sizeof(float)) error = "corrupt checkpoint field";
+    }
+
+    if(error)
+    {
+        fprintf(stderr, "%s: %s\n", path, error);
+        close();
+        return 0;
+    }
+
+    //restores read every field front to back
+    madvise(map, mapSize, MADV_WILLNEED);
+    return 1;
+}
+
+void CheckpointReader::close()
+{
+    if(map) munmap(map, mapSize);
+    map = NULL;
+    mapSize = 0;
+    header = NULL;
+    params = NULL;
+    fields = NULL;
+}
+
+const char* CheckpointReader::getFieldName(int k, int *width, int *height)
+{
+    if(!header || k < 0 || k >= (int)header->numFields) return NULL;
+
+    *width = fields[k].width;
+    *height = fields[k].height;
+    return fields[k].name;
+}
+
+int CheckpointReader::getParam(const char *name, double *value)
+{
+    if(!header) return 0;
+
+    for(uint32_t k=0; k<header->numParams; k++)
+    {
+        if(strncmp(params[k].name, name, CHECKPOINT_NAME) == 0)
+        {
+            *value = params[k].value;
+            return 1;
+        }
+    }
+    return 0;
+}
+
+const float* CheckpointReader::getField(const char *name, int width, int height)
+{
+    if(!header) return NULL;
+
+    for(uint32_t k=0; k<header->numFields; k++)
+    {
+        if(strncmp(fields[k].name, name, CHECKPOINT_NAME) != 0) continue;
+        if(fields[k].width != (uint32_t)width || fields[k].height != (uint32_t)height) return NULL;
+        return (const float *)(map+fields[k].offset);
+    }
+    return NULL;
+}
+
+int CheckpointReader::readField(const char *name, float *dest, int width, int height)
+{
+    const float *field = getField(name, width, height);
+    if(!field)
+    {
+        fprintf(stderr, "checkpoint has no %dx%d field %s\n", width, height, name);
+        return 0;
+    }
+
+    memcpy(dest, field, sizeof(float)*width*height);
+    return 1;
+}
@@ -0,0 +1,114 @@
+/** File:    Checkpoint.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __CHECKPOINT_H__
+#define __CHECKPOINT_H__
+
+#include <stdint.h>
+#include <stddef.h>
+
+//binary checkpoint of a solver, native byte order
+//  header | param table | field table | fields, each starting on a 4096 byte boundary
+//fields are raw float arrays in the solver's own layout, so a reader maps the file
+//and copies (or reads) them in place without any parsing
+#define CHECKPOINT_MAGIC "SFCKPT\r\n"
+#define CHECKPOINT_VERSION 1
+#define CHECKPOINT_ALIGN 4096
+#define CHECKPOINT_NAME 16
+
+struct CheckpointHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    char solver[CHECKPOINT_NAME];
+    uint32_t numParams;
+    uint32_t numFields;
+    uint64_t fileSize;
+};
+
+struct CheckpointParam
+{
+    char name[CHECKPOINT_NAME];
+    double value;
+};
+
+struct CheckpointField
+{
+    char name[CHECKPOINT_NAME];
+    uint32_t width;
+    uint32_t height;
+    uint64_t offset;
+    uint64_t bytes;
+};
+
+class CheckpointWriter
+{
+public:
+    CheckpointWriter();
+    ~CheckpointWriter();
+
+    //fields are referenced, not copied, until write() returns
+    void setSolver(const char *solver);
+    void addParam(const char *name, double value);
+    void addField(const char *name, const float *data, int width, int height);
+
+    //copies every field into buffer, back to back, and writes from there afterwards
+    uint64_t getFieldBytes();
+    void copyFields(float *buffer);
+
+    //writes to path.tmp and renames it over path once it is on disk, returns 1 on success
+    int write(const char *path);
+
+private:
+    CheckpointHeader header;
+    CheckpointParam *params;
+    CheckpointField *fields;
+    const float **data;
+};
+
+class CheckpointReader
+{
+public:
+    CheckpointReader();
+    ~CheckpointReader();
+
+    //maps path and checks it was written by the named solver (any when NULL), returns 1 on success
+    int open(const char *path, const char *solver);
+    void close();
+
+    const char* getSolver(){ return header ? header->solver : NULL; }
+    int getNumFields(){ return header ? header->numFields : 0; }
+    const char* getFieldName(int k, int *width, int *height);
+    int getParam(const char *name, double *value);
+    //the field inside the mapping, NULL when missing or of another size
+    const float* getField(const char *name, int width, int height);
+    int readField(const char *name, float *dest, int width, int height);
+
+private:
+    unsigned char *map;
+    uint64_t mapSize;
+    CheckpointHeader *header;
+    CheckpointParam *params;
+    CheckpointField *fields;
+};
+
+#endif
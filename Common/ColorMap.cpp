@@ -0,0 +1,125 @@
+/** File:    ColorMap.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ColorMap.h"
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+static inline void mapDensity(float dens, unsigned char *pixel)
+{
+    float c = 1.0f-dens;
+    if(c < 0.0f) c = 0.0f;
+    if(c > 1.0f) c = 1.0f;
+
+    unsigned char value = (unsigned char)(c*255.0f+0.5f);
+    pixel[0] = value;
+    pixel[1] = 255;
+    pixel[2] = value;
+    pixel[3] = 255;
+}
+
+#ifdef __SSE2__
+//four densities to four packed pixels, green and alpha are always 255
+static inline __m128i mapDensity4(__m128 dens)
+{
+    const __m128 zero = _mm_setzero_ps();
+    const __m128 one = _mm_set1_ps(1.0f);
+    const __m128 scale = _mm_set1_ps(255.0f);
+    const __m128 half = _mm_set1_ps(0.5f);
+    const __m128i greenAlpha = _mm_set1_epi32((int)0xFF00FF00);
+
+    __m128 c = _mm_min_ps(_mm_max_ps(_mm_sub_ps(one, dens), zero), one);
+    __m128i value = _mm_cvttps_epi32(_mm_add_ps(_mm_mul_ps(c, scale), half));
+
+    return _mm_or_si128(_mm_or_si128(value, _mm_slli_epi32(value, 16)), greenAlpha);
+}
+#endif
+
+void densityToRGBA(const float *dens, unsigned char *pixels, int n)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    for(; i+4<=n; i+=4)
+    {
+        _mm_storeu_si128((__m128i *)(pixels+i*4), mapDensity4(_mm_loadu_ps(dens+i)));
+    }
+#endif
+
+    for(; i<n; i++) mapDensity(dens[i], pixels+i*4);
+}
+
+void vertexDensityToRGBA(const float *d, int stride, int width, int height, unsigned char *pixels, int pixelStride)
+{
+    for(int y=0; y<height; y++)
+    {
+        const float *row0 = d+y*stride;
+        const float *row1 = row0+stride;
+        unsigned char *out = pixels+y*pixelStride*4;
+        int x = 0;
+
+#ifdef __SSE2__
+        const __m128 quarter = _mm_set1_ps(0.25f);
+        for(; x+4<=width; x+=4)
+        {
+            __m128 sum = _mm_add_ps(_mm_add_ps(_mm_loadu_ps(row0+x), _mm_loadu_ps(row0+x+1)),
+                                    _mm_add_ps(_mm_loadu_ps(row1+x), _mm_loadu_ps(row1+x+1)));
+            _mm_storeu_si128((__m128i *)(out+x*4), mapDensity4(_mm_mul_ps(sum, quarter)));
+        }
+#endif
+
+        for(; x<width; x++)
+        {
+            mapDensity((row0[x]+row0[x+1]+row1[x]+row1[x+1])/4.0f, out+x*4);
+        }
+    }
+}
+
+void vertexSpeedToRGBA(const float *u, const float *v, int stride, int width, int height, float scale, unsigned char *pixels, int pixelStride)
+{
+    //speeds go through a short row buffer so the colormap runs vectorized
+    float speed[64];
+
+    for(int y=0; y<height; y++)
+    {
+        const float *u0 = u+y*stride;
+        const float *u1 = u0+stride;
+        const float *v0 = v+y*stride;
+        const float *v1 = v0+stride;
+        unsigned char *out = pixels+y*pixelStride*4;
+
+        for(int x0=0; x0<width; x0+=64)
+        {
+            int n = width-x0 < 64 ? width-x0 : 64;
+            for(int k=0; k<n; k++)
+            {
+                int x = x0+k;
+                float vu = (u0[x]+u0[x+1]+u1[x]+u1[x+1])/4.0f;
+                float vv = (v0[x]+v0[x+1]+v1[x]+v1[x+1])/4.0f;
+                speed[k] = sqrtf(vu*vu+vv*vv)*scale;
+            }
+            densityToRGBA(speed, out+x0*4, n);
+        }
+    }
+}
@@ -0,0 +1,41 @@
+/** File:    ColorMap.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __COLORMAP_H__
+#define __COLORMAP_H__
+
+//packed RGBA8 output, 4 bytes per pixel in R,G,B,A order (GL_RGBA/GL_UNSIGNED_BYTE)
+//density d is mapped to (1-d, 1, 1-d), the same colors draw_density() used to emit
+
+//maps n density values to n pixels
+void densityToRGBA(const float *dens, unsigned char *pixels, int n);
+
+//averages the four cells around every interior vertex and maps the result
+//vertex (x, y) covers cells (x, y), (x+1, y), (x, y+1), (x+1, y+1) of a field with row stride
+//width and height count vertices, so the field needs at least (width+1)*(height+1) cells
+//pixelStride is the row length of the image in pixels, which may be larger for sub-rectangles
+void vertexDensityToRGBA(const float *d, int stride, int width, int height, unsigned char *pixels, int pixelStride);
+
+//speed of the velocity averaged around every interior vertex, times scale, mapped like density
+//u and v are cell centered fields laid out like d above
+void vertexSpeedToRGBA(const float *u, const float *v, int stride, int width, int height, float scale, unsigned char *pixels, int pixelStride);
+
+#endif
@@ -0,0 +1,67 @@
+/** File:    Courant.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Courant.h"
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+float maxMagnitude(const float *value, int n, float fastest)
+{
+    int i = 0;
+
+#ifdef __SSE2__
+    if(n >= 4)
+    {
+        //clearing the sign bit is the magnitude, four at a time
+        const __m128 magnitude = _mm_castsi128_ps(_mm_set1_epi32(0x7fffffff));
+        __m128 best = _mm_set1_ps(fastest);
+        for(; i+4<=n; i+=4)
+        {
+            best = _mm_max_ps(best, _mm_and_ps(_mm_loadu_ps(value+i), magnitude));
+        }
+
+        float lanes[4];
+        _mm_storeu_ps(lanes, best);
+        for(int k=0; k<4; k++) if(lanes[k] > fastest) fastest = lanes[k];
+    }
+#endif
+
+    for(; i<n; i++)
+    {
+        float m = fabsf(value[i]);
+        if(m > fastest) fastest = m;
+    }
+    return fastest;
+}
+
+int courantSteps(float remaining, float fastest, float cfl, int maxSteps)
+{
+    if(maxSteps < 1) return 1;
+    float cells = remaining*fastest;
+    //too fast, or not a number after a blow up
+    if(!(cells <= cfl*maxSteps)) return maxSteps;
+
+    int steps = (int)ceilf(cells/cfl);
+    return steps > 1 ? steps : 1;
+}
@@ -0,0 +1,37 @@
+/** File:    Courant.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __COURANT_H__
+#define __COURANT_H__
+
+//adaptive stepping: a step of some length of time is split into the fewest
+//equal substeps that carry no velocity further than cfl cells, speeds in cells
+//per unit time, the largest component of the velocity standing for it
+#define COURANT_MAX_SUBSTEPS 8
+
+//the largest magnitude among n values, or fastest if none is larger;
+//solvers call it on each row they have just written, while it is in cache
+float maxMagnitude(const float *value, int n, float fastest);
+
+//substeps the remaining time needs at a speed of fastest, 1 to maxSteps
+int courantSteps(float remaining, float fastest, float cfl, int maxSteps);
+
+#endif
@@ -0,0 +1,150 @@
+/** File:    DirtyTiles.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "DirtyTiles.h"
+#include <stdlib.h>
+#include <float.h>
+
+DirtyTiles::DirtyTiles()
+{
+    change = NULL;
+    tileMax = NULL;
+    rects = NULL;
+    numRects = 0;
+}
+
+DirtyTiles::~DirtyTiles()
+{
+    free(change);
+    free(tileMax);
+    free(rects);
+}
+
+void DirtyTiles::init(int _rowCell, int _colCell, int _tileSize, float _threshold)
+{
+    free(change);
+    free(tileMax);
+    free(rects);
+
+    rowCell = _rowCell;
+    colCell = _colCell;
+    tileSize = _tileSize;
+    rowTile = (rowCell+tileSize-1)/tileSize;
+    colTile = (colCell+tileSize-1)/tileSize;
+    totTile = rowTile*colTile;
+    threshold = _threshold;
+
+    change = (float *)malloc(sizeof(float)*totTile);
+    tileMax = (float *)malloc(sizeof(float)*totTile);
+    rects = (DirtyRect *)malloc(sizeof(DirtyRect)*totTile);
+    numRects = 0;
+
+    markAll();
+}
+
+void DirtyTiles::markAll()
+{
+    for(int t=0; t<totTile; t++) change[t] = FLT_MAX;
+}
+
+void DirtyTiles::track(const float *now, const float *before)
+{
+    for(int t=0; t<totTile; t++) tileMax[t] = 0.0f;
+
+    for(int j=0; j<colCell; j++)
+    {
+        int ty = j/tileSize;
+        for(int tx=0; tx<rowTile; tx++)
+        {
+            //tiles that are already dirty need no more reads
+            if(change[tIdx(tx, ty)] > threshold) continue;
+
+            int i0 = tx*tileSize;
+            int i1 = i0+tileSize < rowCell ? i0+tileSize : rowCell;
+            float m = tileMax[tIdx(tx, ty)];
+            for(int i=i0; i<i1; i++)
+            {
+                float delta = before ? now[j*rowCell+i]-before[j*rowCell+i] : now[j*rowCell+i];
+                if(delta < 0.0f) delta = -delta;
+                if(delta > m) m = delta;
+            }
+            tileMax[tIdx(tx, ty)] = m;
+        }
+    }
+
+    //the sum of per step maxima bounds how far a tile drifted from what is displayed
+    for(int t=0; t<totTile; t++)
+    {
+        if(change[t] < FLT_MAX) change[t] += tileMax[t];
+    }
+}
+
+void DirtyTiles::addRect(int tx0, int tx1, int ty)
+{
+    //a cell touches the pixels left and right of it, and boundary cells copy their
+    //neighbours after the change was tracked, so grow the cell range by one on each side
+    DirtyRect rect;
+    rect.x0 = tx0*tileSize-2;
+    rect.x1 = (tx1+1)*tileSize;
+    rect.y0 = ty*tileSize-2;
+    rect.y1 = (ty+1)*tileSize;
+
+    if(rect.x0 < 0) rect.x0 = 0;
+    if(rect.y0 < 0) rect.y0 = 0;
+    if(rect.x1 > rowCell-2) rect.x1 = rowCell-2;
+    if(rect.y1 > colCell-2) rect.y1 = colCell-2;
+
+    //extend a rectangle from the tile row below when it spans the same columns
+    for(int k=0; k<numRects; k++)
+    {
+        if(rects[k].y1 < rect.y0-1) continue;
+        if(rects[k].x0 == rect.x0 && rects[k].x1 == rect.x1)
+        {
+            rects[k].y1 = rect.y1;
+            return;
+        }
+    }
+
+    rects[numRects++] = rect;
+}
+
+int DirtyTiles::collect()
+{
+    numRects = 0;
+
+    for(int ty=0; ty<colTile; ty++)
+    {
+        int start = -1;
+        for(int tx=0; tx<=rowTile; tx++)
+        {
+            int dirty = tx < rowTile && change[tIdx(tx, ty)] > threshold;
+            if(dirty && start < 0) start = tx;
+            if(!dirty && start >= 0)
+            {
+                addRect(start, tx-1, ty);
+                start = -1;
+            }
+            if(dirty) change[tIdx(tx, ty)] = 0.0f;
+        }
+    }
+
+    return numRects;
+}
@@ -0,0 +1,77 @@
+/** File:    DirtyTiles.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __DIRTYTILES_H__
+#define __DIRTYTILES_H__
+
+//rectangle of image pixels, bounds inclusive
+struct DirtyRect
+{
+    int x0;
+    int y0;
+    int x1;
+    int y1;
+};
+
+//tracks which tiles of a cell field changed since the display last caught up
+//the display image has one pixel per interior vertex, (rowCell-1)x(colCell-1),
+//pixel (x, y) sitting between cells x..x+1 and y..y+1 as in vertexDensityToRGBA()
+class DirtyTiles
+{
+public:
+    DirtyTiles();
+    ~DirtyTiles();
+    void init(int _rowCell, int _colCell, int _tileSize, float _threshold);
+    void markAll();
+
+    //adds the largest |now-before| of every tile to its pending change
+    //with before==NULL the values of now are the change themselves (added sources)
+    void track(const float *now, const float *before);
+
+    //turns tiles whose pending change passed the threshold into image rectangles
+    //and clears them, returns the number of rectangles
+    int collect();
+
+    //getter
+    int getNumRects(){ return numRects; }
+    DirtyRect getRect(int k){ return rects[k]; }
+    int getTileSize(){ return tileSize; }
+
+private:
+    int tIdx(int tx, int ty){ return ty*rowTile+tx; }
+    void addRect(int tx0, int tx1, int ty);
+
+private:
+    int rowCell;
+    int colCell;
+    int tileSize;
+    int rowTile;
+    int colTile;
+    int totTile;
+    float threshold;
+
+    float *change;
+    float *tileMax;
+    DirtyRect *rects;
+    int numRects;
+};
+
+#endif
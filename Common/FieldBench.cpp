@@ -0,0 +1,148 @@
+/** File:    FieldBench.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+//compression ratio and throughput of FieldCodec on the fields of checkpoints
+//  fieldbench [-rel bound] [-abs bound] [-threads n] [-tile n] checkpoint.sfc ...
+//without a bound the relative bounds 1e-2, 1e-3 and 1e-4 are measured
+
+#include "FieldCodec.h"
+#include "Checkpoint.h"
+#include "ThreadPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <stddef.h>
+#include <math.h>
+#include <chrono>
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void bench(FieldCodec *codec, ThreadPool *pool, const char *name, const float *field, int width, int height,
+                  double bound, int mode)
+{
+    uint64_t rawBytes = (uint64_t)width*height*sizeof(float);
+    float *result = (float *)malloc(rawBytes);
+
+    //repeat until each direction ran for a while, small fields finish in microseconds
+    uint64_t bytes = 0;
+    int runs = 0;
+    double start = now();
+    do
+    {
+        bytes = codec->compress(field, width, height, bound, mode, pool);
+        runs++;
+    }while(now()-start < 0.2);
+    double compressTime = (now()-start)/runs;
+
+    unsigned char *packed = (unsigned char *)malloc(bytes);
+    memcpy(packed, codec->getData(), bytes);
+    double absBound;
+    memcpy(&absBound, packed+offsetof(FieldCodecHeader, bound), sizeof(double));
+
+    runs = 0;
+    int ok = 1;
+    start = now();
+    do
+    {
+        ok = codec->decompress(packed, bytes, result, width, height, pool) && ok;
+        runs++;
+    }while(now()-start < 0.2);
+    double decompressTime = (now()-start)/runs;
+
+    double maxError = 0.0;
+    for(int k=0; k<width*height; k++)
+    {
+        if(!isfinite(field[k])) continue;
+        double error = fabs((double)field[k]-result[k]);
+        if(error > maxError) maxError = error;
+    }
+
+    printf("%-5s %5dx%-5d %-3s %8.0e %9.3e %8.2f %9.3f %9.3f %9.3e %s\n", name, width, height,
+           mode == FIELD_REL ? "rel" : "abs", bound, absBound, (double)rawBytes/bytes,
+           rawBytes/compressTime/1e9, rawBytes/decompressTime/1e9, maxError,
+           ok && maxError <= absBound ? "ok" : "FAILED");
+
+    free(packed);
+    free(result);
+}
+
+int main(int argc, char **argv)
+{
+    double bounds[8];
+    int modes[8];
+    int numBounds = 0;
+    int numThreads = 0;
+    int tileSize = 64;
+
+    int arg = 1;
+    for(; arg<argc && argv[arg][0] == '-'; arg+=2)
+    {
+        if(arg+1 >= argc) break;
+        if(strcmp(argv[arg], "-threads") == 0) numThreads = atoi(argv[arg+1]);
+        else if(strcmp(argv[arg], "-tile") == 0) tileSize = atoi(argv[arg+1]);
+        else if(numBounds < 8 && (strcmp(argv[arg], "-rel") == 0 || strcmp(argv[arg], "-abs") == 0))
+        {
+            modes[numBounds] = strcmp(argv[arg], "-rel") == 0 ? FIELD_REL : FIELD_ABS;
+            bounds[numBounds++] = atof(argv[arg+1]);
+        }
+    }
+    if(arg >= argc)
+    {
+        fprintf(stderr, "usage: %s [-rel bound] [-abs bound] [-threads n] [-tile n] checkpoint.sfc ...\n", argv[0]);
+        return 1;
+    }
+    if(numBounds == 0)
+    {
+        double rel[3] = {1e-2, 1e-3, 1e-4};
+        for(; numBounds<3; numBounds++)
+        {
+            bounds[numBounds] = rel[numBounds];
+            modes[numBounds] = FIELD_REL;
+        }
+    }
+
+    ThreadPool pool;
+    pool.init(numThreads);
+    FieldCodec codec;
+    codec.setTileSize(tileSize);
+    printf("%d threads, %dx%d tiles\n", pool.getNumThreads(), tileSize, tileSize);
+
+    for(; arg<argc; arg++)
+    {
+        CheckpointReader reader;
+        if(!reader.open(argv[arg], NULL)) continue;
+
+        printf("\n%s (%s)\n", argv[arg], reader.getSolver());
+        printf("%-5s %11s %-3s %8s %9s %8s %9s %9s %9s\n", "field", "size", "", "bound", "absolute", "ratio",
+               "comp GB/s", "dec GB/s", "max error");
+        for(int k=0; k<reader.getNumFields(); k++)
+        {
+            int width, height;
+            const char *name = reader.getFieldName(k, &width, &height);
+            const float *field = reader.getField(name, width, height);
+            for(int b=0; b<numBounds; b++) bench(&codec, &pool, name, field, width, height, bounds[b], modes[b]);
+        }
+    }
+    return 0;
+}
@@ -0,0 +1,523 @@
+/** File:    FieldCodec.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "FieldCodec.h"
+#include "ThreadPool.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#define FIELD_MAGIC "SFZ"
+//steps of up to 2^MAX_CLASS are coded, the class after that marks a raw value
+#define MAX_CLASS 23
+#define NUM_CONTEXTS 4
+#define PROB_BITS 11
+#define MOVE_BITS 5
+#define TOP (1u<<24)
+
+//adaptive probabilities of the step coder, one set per context
+//the context is how large the step to the left was
+struct StepModel
+{
+    uint16_t zero[NUM_CONTEXTS];
+    uint16_t sign[NUM_CONTEXTS];
+    uint16_t cls[NUM_CONTEXTS][MAX_CLASS+1];
+};
+
+static void initModel(StepModel *model)
+{
+    uint16_t *prob = (uint16_t *)model;
+    for(size_t k=0; k<sizeof(StepModel)/sizeof(uint16_t); k++) prob[k] = 1<<(PROB_BITS-1);
+}
+
+static int stepContext(int cls)
+{
+    if(cls < 0) return 0;
+    if(cls == 0) return 1;
+    if(cls <= 2) return 2;
+    return 3;
+}
+
+//binary range coder after the one in LZMA
+struct RangeEncoder
+{
+    uint64_t low;
+    uint32_t range;
+    unsigned char cache;
+    uint64_t cacheSize;
+    FieldTile *out;
+};
+
+static void putByte(FieldTile *out, unsigned char byte)
+{
+    if(out->size == out->capacity)
+    {
+        out->capacity = out->capacity ? out->capacity*2 : 4096;
+        out->data = (unsigned char *)realloc(out->data, out->capacity);
+    }
+    out->data[out->size++] = byte;
+}
+
+static void shiftLow(RangeEncoder *rc)
+{
+    if((uint32_t)rc->low < 0xFF000000u || (rc->low>>32) != 0)
+    {
+        unsigned char carry = rc->low>>32;
+        unsigned char temp = rc->cache;
+        do
+        {
+            putByte(rc->out, temp+carry);
+            temp = 0xFF;
+        }while(--rc->cacheSize != 0);
+        rc->cache = (rc->low>>24) & 0xFF;
+    }
+    rc->cacheSize++;
+    rc->low = (rc->low & 0x00FFFFFFu)<<8;
+}
+
+static void initEncoder(RangeEncoder *rc, FieldTile *out)
+{
+    rc->low = 0;
+    rc->range = 0xFFFFFFFFu;
+    rc->cache = 0;
+    rc->cacheSize = 1;
+    rc->out = out;
+    out->size = 0;
+}
+
+static void flushEncoder(RangeEncoder *rc)
+{
+    for(int k=0; k<5; k++) shiftLow(rc);
+}
+
+static void encodeBit(RangeEncoder *rc, uint16_t *prob, int bit)
+{
+    uint32_t bound = (rc->range>>PROB_BITS)*(*prob);
+    if(bit == 0)
+    {
+        rc->range = bound;
+        *prob += ((1<<PROB_BITS)-*prob)>>MOVE_BITS;
+    }
+    else
+    {
+        rc->low += bound;
+        rc->range -= bound;
+        *prob -= *prob>>MOVE_BITS;
+    }
+    while(rc->range < TOP)
+    {
+        rc->range <<= 8;
+        shiftLow(rc);
+    }
+}
+
+static void encodeDirect(RangeEncoder *rc, uint32_t value, int numBits)
+{
+    for(int k=numBits-1; k>=0; k--)
+    {
+        rc->range >>= 1;
+        if((value>>k) & 1) rc->low += rc->range;
+        while(rc->range < TOP)
+        {
+            rc->range <<= 8;
+            shiftLow(rc);
+        }
+    }
+}
+
+struct RangeDecoder
+{
+    const unsigned char *ptr;
+    const unsigned char *end;
+    uint32_t code;
+    uint32_t range;
+    //bytes asked for past end, read as 0
+    uint32_t overrun;
+};
+
+static unsigned char getByte(RangeDecoder *rc)
+{
+    if(rc->ptr < rc->end) return *rc->ptr++;
+    rc->overrun++;
+    return 0;
+}
+
+static void initDecoder(RangeDecoder *rc, const unsigned char *src, uint64_t bytes)
+{
+    rc->ptr = src;
+    rc->end = src+bytes;
+    rc->code = 0;
+    rc->range = 0xFFFFFFFFu;
+    rc->overrun = 0;
+    for(int k=0; k<5; k++) rc->code = (rc->code<<8) | getByte(rc);
+}
+
+static int decodeBit(RangeDecoder *rc, uint16_t *prob)
+{
+    uint32_t bound = (rc->range>>PROB_BITS)*(*prob);
+    int bit;
+    if(rc->code < bound)
+    {
+        rc->range = bound;
+        *prob += ((1<<PROB_BITS)-*prob)>>MOVE_BITS;
+        bit = 0;
+    }
+    else
+    {
+        rc->code -= bound;
+        rc->range -= bound;
+        *prob -= *prob>>MOVE_BITS;
+        bit = 1;
+    }
+    while(rc->range < TOP)
+    {
+        rc->range <<= 8;
+        rc->code = (rc->code<<8) | getByte(rc);
+    }
+    return bit;
+}
+
+static uint32_t decodeDirect(RangeDecoder *rc, int numBits)
+{
+    uint32_t value = 0;
+    for(int k=0; k<numBits; k++)
+    {
+        rc->range >>= 1;
+        int bit = rc->code >= rc->range;
+        if(bit) rc->code -= rc->range;
+        value = (value<<1) | bit;
+        while(rc->range < TOP)
+        {
+            rc->range <<= 8;
+            rc->code = (rc->code<<8) | getByte(rc);
+        }
+    }
+    return value;
+}
+
+//Lorenzo predictor on the reconstructed values of the tile
+static float predict(const float *value, int stride, int i, int j)
+{
+    if(i > 0 && j > 0) return value[-1]+value[-stride]-value[-stride-1];
+    if(i > 0) return value[-1];
+    if(j > 0) return value[-stride];
+    return 0.0f;
+}
+
+//encoder and decoder must round the same way
+static float reconstruct(float prediction, int step, double stepSize)
+{
+    return (float)(prediction+step*stepSize);
+}
+
+FieldCodec::FieldCodec()
+{
+    tileSize = 64;
+    tilesX = 0;
+    numTiles = 0;
+    width = 0;
+    height = 0;
+    bound = 0.0;
+    src = NULL;
+    recon = NULL;
+    reconSize = 0;
+    tiles = NULL;
+    tilesAlloc = 0;
+    data = NULL;
+    dataCapacity = 0;
+    packed = NULL;
+    sizes = NULL;
+    offsets = NULL;
+    offsetsAlloc = 0;
+    dest = NULL;
+    failed = 0;
+}
+
+FieldCodec::~FieldCodec()
+{
+    for(int t=0; t<tilesAlloc; t++) free(tiles[t].data);
+    free(tiles);
+    free(recon);
+    free(data);
+    free(offsets);
+}
+
+void FieldCodec::tileRect(int t, int *x0, int *y0, int *x1, int *y1)
+{
+    *x0 = (t%tilesX)*tileSize;
+    *y0 = (t/tilesX)*tileSize;
+    *x1 = *x0+tileSize < width ? *x0+tileSize : width;
+    *y1 = *y0+tileSize < height ? *y0+tileSize : height;
+}
+
+void FieldCodec::compressTiles(void *arg, int begin, int end)
+{
+    FieldCodec *codec = (FieldCodec *)arg;
+    int width = codec->width;
+    double stepSize = 2.0*codec->bound;
+    double invStep = stepSize > 0.0 ? 1.0/stepSize : 0.0;
+
+    for(int t=begin; t<end; t++)
+    {
+        int x0, y0, x1, y1;
+        codec->tileRect(t, &x0, &y0, &x1, &y1);
+
+        StepModel model;
+        initModel(&model);
+        RangeEncoder rc;
+        initEncoder(&rc, &codec->tiles[t]);
+
+        for(int j=y0; j<y1; j++)
+        {
+            int ctx = 0;
+            for(int i=x0; i<x1; i++)
+            {
+                float *value = &codec->recon[j*width+i];
+                float original = codec->src[j*width+i];
+                float prediction = predict(value, width, i-x0, j-y0);
+
+                //the step, or MAX_CLASS+1 when the value has to be stored raw
+                double steps = (original-(double)prediction)*invStep;
+                int cls = MAX_CLASS+1;
+                int step = 0;
+                if(fabs(steps) < (double)(1<<MAX_CLASS))
+                {
+                    step = (int)(steps < 0.0 ? steps-0.5 : steps+0.5);
+                    float result = reconstruct(prediction, step, stepSize);
+                    if(fabs((double)original-result) <= codec->bound)
+                    {
+                        *value = result;
+                        cls = -1;
+                        if(step != 0)
+                        {
+                            cls = 31-__builtin_clz(abs(step));
+                        }
+                    }
+                }
+
+                encodeBit(&rc, &model.zero[ctx], cls >= 0);
+                if(cls >= 0)
+                {
+                    encodeBit(&rc, &model.sign[ctx], step < 0);
+                    for(int k=0; k<cls && k<=MAX_CLASS; k++) encodeBit(&rc, &model.cls[ctx][k], 1);
+                    if(cls <= MAX_CLASS)
+                    {
+                        encodeBit(&rc, &model.cls[ctx][cls], 0);
+                        encodeDirect(&rc, abs(step), cls);
+                    }
+                    else
+                    {
+                        uint32_t bits;
+                        memcpy(&bits, &original, sizeof(uint32_t));
+                        encodeDirect(&rc, bits, 32);
+                        *value = original;
+                    }
+                }
+                ctx = stepContext(cls);
+            }
+        }
+        flushEncoder(&rc);
+    }
+}
+
+uint64_t FieldCodec::compress(const float *field, int _width, int _height, double _bound, int mode, ThreadPool *pool)
+{
+    width = _width;
+    height = _height;
+    tilesX = (width+tileSize-1)/tileSize;
+    numTiles = tilesX*((height+tileSize-1)/tileSize);
+    src = field;
+
+    bound = _bound;
+    if(mode == FIELD_REL)
+    {
+        float minValue = INFINITY;
+        float maxValue = -INFINITY;
+        for(int k=0; k<width*height; k++)
+        {
+            if(!isfinite(field[k])) continue;
+            if(field[k] < minValue) minValue = field[k];
+            if(field[k] > maxValue) maxValue = field[k];
+        }
+        bound = maxValue > minValue ? _bound*((double)maxValue-minValue) : _bound;
+    }
+
+    if((uint64_t)width*height > reconSize)
+    {
+        free(recon);
+        reconSize = (uint64_t)width*height;
+        recon = (float *)malloc(reconSize*sizeof(float));
+    }
+    if(numTiles > tilesAlloc)
+    {
+        tiles = (FieldTile *)realloc(tiles, numTiles*sizeof(FieldTile));
+        memset(tiles+tilesAlloc, 0, (numTiles-tilesAlloc)*sizeof(FieldTile));
+        tilesAlloc = numTiles;
+    }
+
+    if(pool) pool->run(compressTiles, this, numTiles, 1);
+    else compressTiles(this, 0, numTiles);
+
+    uint64_t bytes = sizeof(FieldCodecHeader)+numTiles*sizeof(uint32_t);
+    for(int t=0; t<numTiles; t++) bytes += tiles[t].size;
+    if(bytes > dataCapacity)
+    {
+        free(data);
+        dataCapacity = bytes;
+        data = (unsigned char *)malloc(dataCapacity);
+    }
+
+    FieldCodecHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, FIELD_MAGIC, 4);
+    header.width = width;
+    header.height = height;
+    header.tileSize = tileSize;
+    header.numTiles = numTiles;
+    header.bound = bound;
+    memcpy(data, &header, sizeof(header));
+
+    uint32_t *tileBytes = (uint32_t *)(data+sizeof(FieldCodecHeader));
+    unsigned char *ptr = (unsigned char *)(tileBytes+numTiles);
+    for(int t=0; t<numTiles; t++)
+    {
+        tileBytes[t] = tiles[t].size;
+        memcpy(ptr, tiles[t].data, tiles[t].size);
+        ptr += tiles[t].size;
+    }
+    return bytes;
+}
+
+void FieldCodec::decompressTiles(void *arg, int begin, int end)
+{
+    FieldCodec *codec = (FieldCodec *)arg;
+    int width = codec->width;
+    double stepSize = 2.0*codec->bound;
+
+    for(int t=begin; t<end; t++)
+    {
+        int x0, y0, x1, y1;
+        codec->tileRect(t, &x0, &y0, &x1, &y1);
+
+        StepModel model;
+        initModel(&model);
+        RangeDecoder rc;
+        initDecoder(&rc, codec->packed+codec->offsets[t], codec->sizes[t]);
+
+        for(int j=y0; j<y1; j++)
+        {
+            int ctx = 0;
+            for(int i=x0; i<x1; i++)
+            {
+                float *value = &codec->dest[j*width+i];
+                float prediction = predict(value, width, i-x0, j-y0);
+
+                int cls = -1;
+                int step = 0;
+                if(decodeBit(&rc, &model.zero[ctx]))
+                {
+                    int negative = decodeBit(&rc, &model.sign[ctx]);
+                    cls = 0;
+                    while(cls <= MAX_CLASS && decodeBit(&rc, &model.cls[ctx][cls])) cls++;
+                    if(cls <= MAX_CLASS)
+                    {
+                        step = (1<<cls) | decodeDirect(&rc, cls);
+                        if(negative) step = -step;
+                    }
+                }
+
+                if(cls <= MAX_CLASS) *value = reconstruct(prediction, step, stepSize);
+                else
+                {
+                    uint32_t bits = decodeDirect(&rc, 32);
+                    memcpy(value, &bits, sizeof(uint32_t));
+                }
+                ctx = stepContext(cls);
+            }
+        }
+        //the encoder flushes every byte the decoder looks ahead at, so a whole
+        //tile is never read past its end; one that is was cut short
+        if(rc.overrun > 0) codec->failed = 1;
+    }
+}
+
+int FieldCodec::decompress(const unsigned char *src, uint64_t bytes, float *field, int _width, int _height, ThreadPool *pool)
+{
+    FieldCodecHeader header;
+    if(bytes < sizeof(header))
+    {
+        fprintf(stderr, "compressed field is truncated\n");
+        return 0;
+    }
+    memcpy(&header, src, sizeof(header));
+
+    if(memcmp(header.magic, FIELD_MAGIC, 4) != 0 || header.tileSize == 0)
+    {
+        fprintf(stderr, "not a compressed field\n");
+        return 0;
+    }
+    if(header.width != (uint32_t)_width || header.height != (uint32_t)_height)
+    {
+        fprintf(stderr, "compressed field is %ux%u, expected %dx%d\n", header.width, header.height, _width, _height);
+        return 0;
+    }
+
+    width = _width;
+    height = _height;
+    tileSize = header.tileSize;
+    tilesX = (width+tileSize-1)/tileSize;
+    numTiles = tilesX*((height+tileSize-1)/tileSize);
+    bound = header.bound;
+    if((uint32_t)numTiles != header.numTiles || bytes < sizeof(header)+numTiles*sizeof(uint32_t))
+    {
+        fprintf(stderr, "compressed field is truncated\n");
+        return 0;
+    }
+
+    if(numTiles > offsetsAlloc)
+    {
+        free(offsets);
+        offsetsAlloc = numTiles;
+        offsets = (uint64_t *)malloc(offsetsAlloc*sizeof(uint64_t));
+    }
+    sizes = (const uint32_t *)(src+sizeof(header));
+    packed = (const unsigned char *)(sizes+numTiles);
+    uint64_t offset = 0;
+    for(int t=0; t<numTiles; t++)
+    {
+        offsets[t] = offset;
+        offset += sizes[t];
+    }
+    if(sizeof(header)+numTiles*sizeof(uint32_t)+offset > bytes)
+    {
+        fprintf(stderr, "compressed field is truncated\n");
+        return 0;
+    }
+
+    dest = field;
+    failed = 0;
+    if(pool) pool->run(decompressTiles, this, numTiles, 1);
+    else decompressTiles(this, 0, numTiles);
+
+    if(failed) fprintf(stderr, "compressed field is corrupt\n");
+    return !failed;
+}
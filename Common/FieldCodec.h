@@ -0,0 +1,105 @@
+/** File:    FieldCodec.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __FIELDCODEC_H__
+#define __FIELDCODEC_H__
+
+#include <stdint.h>
+#include <atomic>
+
+class ThreadPool;
+
+//error bounded lossy compression of a float field
+//each tile predicts every value from its reconstructed left, lower and lower
+//left neighbours, quantizes the error into steps of twice the bound and codes
+//the steps with an adaptive binary range coder. values that cannot be
+//predicted within the bound (or are not finite) are stored as is, so every
+//decoded value is within the bound of the original
+//  header | compressed size of every tile | tiles
+//tiles are independent, so both directions run in parallel over them
+#define FIELD_ABS 0
+#define FIELD_REL 1
+
+struct FieldCodecHeader
+{
+    char magic[4];
+    uint32_t width;
+    uint32_t height;
+    uint32_t tileSize;
+    uint32_t numTiles;
+    uint32_t reserved;
+    double bound;
+};
+
+struct FieldTile
+{
+    unsigned char *data;
+    uint64_t size;
+    uint64_t capacity;
+};
+
+class FieldCodec
+{
+public:
+    FieldCodec();
+    ~FieldCodec();
+    void setTileSize(int _tileSize){ tileSize = _tileSize < 8 ? 8 : _tileSize; }
+
+    //bound is absolute, or relative to the value range of the field with FIELD_REL
+    //returns the compressed size, the data stays valid until the next call
+    uint64_t compress(const float *field, int width, int height, double bound, int mode, ThreadPool *pool);
+    const unsigned char* getData(){ return data; }
+
+    //returns 1 on success
+    int decompress(const unsigned char *src, uint64_t bytes, float *field, int width, int height, ThreadPool *pool);
+
+private:
+    static void compressTiles(void *arg, int begin, int end);
+    static void decompressTiles(void *arg, int begin, int end);
+    void tileRect(int t, int *x0, int *y0, int *x1, int *y1);
+
+private:
+    int tileSize;
+    int tilesX;
+    int numTiles;
+    int width;
+    int height;
+    double bound;
+
+    //compress
+    const float *src;
+    float *recon;
+    uint64_t reconSize;
+    FieldTile *tiles;
+    int tilesAlloc;
+    unsigned char *data;
+    uint64_t dataCapacity;
+
+    //decompress
+    const unsigned char *packed;
+    const uint32_t *sizes;
+    uint64_t *offsets;
+    int offsetsAlloc;
+    float *dest;
+    std::atomic<int> failed;
+};
+
+#endif
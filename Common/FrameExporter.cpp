@@ -0,0 +1,153 @@
+/** File:    FrameExporter.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "FrameExporter.h"
+#include "util.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+
+FrameExporter::FrameExporter()
+{
+    running = 0;
+    stopping = 0;
+    pattern[0] = 0;
+    width = 0;
+    height = 0;
+    dropFrames = 0;
+    compression = 1;
+    submitted = 0;
+    written = 0;
+    dropped = 0;
+    failed = 0;
+}
+
+FrameExporter::~FrameExporter()
+{
+    stop();
+}
+
+void FrameExporter::start(const char *_pattern, int _width, int _height, int numWriters, int numBuffers, int _dropFrames)
+{
+    stop();
+
+    strncpy(pattern, _pattern, sizeof(pattern)-1);
+    pattern[sizeof(pattern)-1] = 0;
+    width = _width;
+    height = _height;
+    dropFrames = _dropFrames;
+    submitted = 0;
+    written = 0;
+    dropped = 0;
+    failed = 0;
+
+    if(numWriters < 1) numWriters = 1;
+    if(numBuffers < numWriters+1) numBuffers = numWriters+1;
+
+    for(int i=0; i<numBuffers; i++)
+    {
+        unsigned char *pixels = (unsigned char *)malloc(sizeof(unsigned char)*width*height*4);
+        buffers.push_back(pixels);
+        freeList.push_back(pixels);
+    }
+
+    stopping = 0;
+    running = 1;
+    for(int i=0; i<numWriters; i++) writers.push_back(std::thread(writerMain, this));
+}
+
+void FrameExporter::stop()
+{
+    if(!running) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        stopping = 1;
+    }
+    queueCond.notify_all();
+
+    for(size_t i=0; i<writers.size(); i++) writers[i].join();
+    writers.clear();
+
+    for(size_t i=0; i<buffers.size(); i++) free(buffers[i]);
+    buffers.clear();
+    freeList.clear();
+    running = 0;
+
+    printf("export: %d frames written, %d dropped, %d failed\n", written, dropped, failed);
+}
+
+unsigned char* FrameExporter::acquire()
+{
+    if(!running) return NULL;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    if(freeList.empty())
+    {
+        if(dropFrames)
+        {
+            dropped++;
+            return NULL;
+        }
+        while(freeList.empty()) freeCond.wait(lock);
+    }
+
+    unsigned char *pixels = freeList.back();
+    freeList.pop_back();
+    return pixels;
+}
+
+void FrameExporter::submit(unsigned char *pixels)
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        Frame frame;
+        frame.pixels = pixels;
+        frame.index = submitted++;
+        queue.push_back(frame);
+    }
+    queueCond.notify_one();
+}
+
+void FrameExporter::writerMain(FrameExporter *exporter)
+{
+    char filename[512];
+    std::unique_lock<std::mutex> lock(exporter->mutex);
+
+    while(1)
+    {
+        while(exporter->queue.empty() && !exporter->stopping) exporter->queueCond.wait(lock);
+        if(exporter->queue.empty()) return;
+
+        Frame frame = exporter->queue.front();
+        exporter->queue.pop_front();
+        lock.unlock();
+
+        snprintf(filename, sizeof(filename), exporter->pattern, frame.index);
+        int ok = write_png(filename, frame.pixels, exporter->width, exporter->height, true, exporter->compression);
+
+        lock.lock();
+        if(ok) exporter->written++;
+        else exporter->failed++;
+        exporter->freeList.push_back(frame.pixels);
+        exporter->freeCond.notify_one();
+    }
+}
@@ -0,0 +1,90 @@
+/** File:    FrameExporter.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __FRAMEEXPORTER_H__
+#define __FRAMEEXPORTER_H__
+
+#include <vector>
+#include <deque>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+
+//writes RGBA8 frames to numbered PNG files on a pool of encoder threads
+//the simulation side fills a recycled buffer from acquire() in place and hands
+//it back with submit(), so frames are never copied on the calling thread
+class FrameExporter
+{
+public:
+    FrameExporter();
+    ~FrameExporter();
+
+    //pattern is a printf format for the frame number, e.g. "frame_%05d.png"
+    //with dropFrames acquire() gives up instead of waiting when every buffer is queued
+    void start(const char *_pattern, int _width, int _height, int numWriters, int numBuffers, int _dropFrames);
+    //writes out everything queued, then frees the buffers
+    void stop();
+    int isRunning(){ return running; }
+
+    unsigned char* acquire();
+    void submit(unsigned char *pixels);
+
+    //getter
+    int getWidth(){ return width; }
+    int getHeight(){ return height; }
+    int getSubmitted(){ return submitted; }
+    int getWritten(){ return written; }
+    int getDropped(){ return dropped; }
+    int getFailed(){ return failed; }
+
+private:
+    struct Frame
+    {
+        unsigned char *pixels;
+        int index;
+    };
+
+    static void writerMain(FrameExporter *exporter);
+
+private:
+    int running;
+    int stopping;
+    char pattern[256];
+    int width;
+    int height;
+    int dropFrames;
+    int compression;
+
+    int submitted;
+    int written;
+    int dropped;
+    int failed;
+
+    std::mutex mutex;
+    std::condition_variable freeCond;
+    std::condition_variable queueCond;
+    std::vector<unsigned char*> buffers;
+    std::vector<unsigned char*> freeList;
+    std::deque<Frame> queue;
+    std::vector<std::thread> writers;
+};
+
+#endif
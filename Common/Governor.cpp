@@ -0,0 +1,162 @@
+/** File:    Governor.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Governor.h"
+#include <stdio.h>
+
+typedef std::chrono::steady_clock Clock;
+
+Governor::Governor()
+{
+    on = 0;
+    budget = 0.0;
+    minIterations = 1;
+    maxIterations = 1;
+    maxThreads = 1;
+    hasOptional = 0;
+    resizeHook = NULL;
+    resizeArg = NULL;
+    settings.iterations = 1;
+    settings.optional = 1;
+    settings.threads = 1;
+    average = 0.0;
+    steps = 0;
+    atFloor = 0;
+    optionalOn = 0.0;
+    optionalCost = 0.0;
+    costPending = 0;
+}
+
+void Governor::start(double _budget, int _minIterations, int _maxIterations, int threads, int _maxThreads, int _hasOptional)
+{
+    on = _budget > 0.0;
+    budget = _budget;
+    maxIterations = _maxIterations > 1 ? _maxIterations : 1;
+    minIterations = _minIterations < 1 ? 1 : (_minIterations > maxIterations ? maxIterations : _minIterations);
+    maxThreads = _maxThreads > threads ? _maxThreads : threads;
+    hasOptional = _hasOptional;
+
+    //full quality until the steps say otherwise
+    settings.iterations = maxIterations;
+    settings.optional = 1;
+    settings.threads = threads;
+    average = 0.0;
+    steps = 0;
+    atFloor = 0;
+    optionalCost = 0.0;
+    costPending = 0;
+}
+
+void Governor::begin()
+{
+    if(on) stepStart = Clock::now();
+}
+
+int Governor::end()
+{
+    if(!on) return 0;
+
+    double ms = std::chrono::duration<double, std::milli>(Clock::now()-stepStart).count();
+    average = steps == 0 ? ms : average+GOVERNOR_SMOOTHING*(ms-average);
+    steps++;
+    if(steps < GOVERNOR_SETTLE) return 0;
+
+    if(costPending)
+    {
+        optionalCost = optionalOn > average ? optionalOn-average : 0.0;
+        costPending = 0;
+    }
+    if(average > budget) return degrade();
+    if(average < GOVERNOR_HEADROOM*budget) return restore();
+    return 0;
+}
+
+int Governor::degrade()
+{
+    if(settings.threads < maxThreads)
+    {
+        settings.threads++;
+        printf("governor: %.2f ms a step over %.2f ms, %d relaxation threads\n", average, budget, settings.threads);
+    }
+    else if(hasOptional && settings.optional)
+    {
+        settings.optional = 0;
+        optionalOn = average;
+        costPending = 1;
+        printf("governor: %.2f ms a step over %.2f ms, optional stages off\n", average, budget);
+    }
+    else if(settings.iterations > minIterations)
+    {
+        //the solves cost about in proportion to their sweeps, so a step far over
+        //the budget loses more than one notch at once
+        int iterations = (int)(settings.iterations*budget/average);
+        if(iterations > settings.iterations-GOVERNOR_SWEEPS) iterations = settings.iterations-GOVERNOR_SWEEPS;
+        if(iterations < minIterations) iterations = minIterations;
+        settings.iterations = iterations;
+        printf("governor: %.2f ms a step over %.2f ms, %d sweeps a solve\n", average, budget, settings.iterations);
+    }
+    else
+    {
+        //fewer cells are all that is left
+        if(resizeHook && resizeHook(resizeArg, 1))
+        {
+            printf("governor: %.2f ms a step over %.2f ms at the least effort allowed, coarser grid\n", average, budget);
+        }
+        else if(!atFloor) printf("governor: %.2f ms a step over %.2f ms at the least effort allowed\n", average, budget);
+        atFloor = 1;
+        steps = 0;
+        return 0;
+    }
+
+    //the average starts over on the new settings
+    steps = 0;
+    return 1;
+}
+
+int Governor::restore()
+{
+    atFloor = 0;
+    if(settings.iterations < maxIterations)
+    {
+        int iterations = settings.iterations+GOVERNOR_SWEEPS;
+        if(iterations > maxIterations) iterations = maxIterations;
+        //only if the step would still fit
+        if(average*iterations/settings.iterations > GOVERNOR_HEADROOM*budget) return 0;
+        settings.iterations = iterations;
+        printf("governor: %.2f ms a step under %.2f ms, %d sweeps a solve\n", average, budget, settings.iterations);
+    }
+    else if(hasOptional && !settings.optional)
+    {
+        if(average+optionalCost > GOVERNOR_HEADROOM*budget) return 0;
+        settings.optional = 1;
+        printf("governor: %.2f ms a step under %.2f ms, optional stages on\n", average, budget);
+    }
+    else if(resizeHook && average*GOVERNOR_GRID_COST < GOVERNOR_HEADROOM*budget && resizeHook(resizeArg, 0))
+    {
+        printf("governor: %.2f ms a step under %.2f ms, finer grid\n", average, budget);
+        steps = 0;
+        return 0;
+    }
+    else return 0;
+
+    steps = 0;
+    return 1;
+}
@@ -0,0 +1,100 @@
+/** File:    Governor.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __GOVERNOR_H__
+#define __GOVERNOR_H__
+
+#include <chrono>
+
+//steps timed before the governor judges the settings it last picked
+#define GOVERNOR_SETTLE 15
+//weight of the newest step in the running average
+#define GOVERNOR_SMOOTHING 0.2
+//a step must fit in this share of the budget with the effort taken back
+#define GOVERNOR_HEADROOM 0.8
+//sweeps taken away or given back at a time
+#define GOVERNOR_SWEEPS 2
+//a grid twice as fine costs about this many times as much a step
+#define GOVERNOR_GRID_COST 4.0
+
+//the effort a solver step may spend
+struct GovernorSettings
+{
+    int iterations;     //Gauss-Seidel sweeps per diffusion and pressure solve
+    int optional;       //1 runs the stages the picture can do without
+    int threads;        //relaxation threads
+};
+
+//frame deadline governor: keeps the solver within a time budget a step by
+//trading accuracy for time, so a slow machine holds its frame rate. when the
+//steps run over the budget it adds relaxation threads first, then drops the
+//optional stages, then relaxation sweeps down to a floor; when they run well
+//under it gives the sweeps and the optional stages back. the threads it
+//added stay, taking them back would only put the step over the budget again.
+//past the least effort, and with room for a grid twice as fine at full
+//effort, it asks a resize hook for a coarser or finer grid
+class Governor
+{
+public:
+    Governor();
+
+    //budget ms a step; iterations run between minIterations and maxIterations,
+    //threads from threads up to maxThreads; hasOptional 0 if the solver has no
+    //optional stages
+    void start(double _budget, int _minIterations, int _maxIterations, int threads, int _maxThreads, int _hasOptional);
+    int isOn(){ return on; }
+
+    //around every solver step; end() returns 1 when the settings changed
+    void begin();
+    int end();
+    GovernorSettings getSettings(){ return settings; }
+
+    //down 1 asks for a coarser grid, 0 for a finer one; the hook returns 1 if
+    //it will resize, 0 if the grid cannot go that way
+    typedef int (*ResizeHook)(void *arg, int down);
+    void setResizeHook(ResizeHook hook, void *arg){ resizeHook = hook; resizeArg = arg; }
+
+private:
+    int degrade();
+    int restore();
+
+private:
+    int on;
+    double budget;
+    int minIterations;
+    int maxIterations;
+    int maxThreads;
+    int hasOptional;
+    GovernorSettings settings;
+    ResizeHook resizeHook;
+    void *resizeArg;
+
+    double average;
+    int steps;
+    int atFloor;
+    //what the optional stages add to a step, measured once they are dropped
+    double optionalOn;
+    double optionalCost;
+    int costPending;
+    std::chrono::steady_clock::time_point stepStart;
+};
+
+#endif
@@ -0,0 +1,369 @@
+/** File:    InputLog.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "InputLog.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <chrono>
+#include <thread>
+
+#define BYTE_ORDER_MARK 0x01020304u
+
+InputEvent inputEvent(int type, int i, int j, float x, float y, uint32_t time)
+{
+    InputEvent event;
+    event.type = type;
+    event.i = i;
+    event.j = j;
+    event.x = x;
+    event.y = y;
+    event.time = time;
+    return event;
+}
+
+InputLogWriter::InputLogWriter()
+{
+    file = NULL;
+    lastTime = 0;
+    numSteps = 0;
+}
+
+InputLogWriter::~InputLogWriter()
+{
+    if(file) close();
+}
+
+int InputLogWriter::open(const char *path, const char *solver, int width, int height, RelaxConfig relax)
+{
+    if(file) close();
+
+    file = fopen(path, "wb");
+    if(!file)
+    {
+        perror(path);
+        return 0;
+    }
+
+    InputLogHeader header;
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, INPUTLOG_MAGIC, 8);
+    header.version = INPUTLOG_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    strncpy(header.solver, solver, INPUTLOG_NAME-1);
+    header.width = width;
+    header.height = height;
+    header.relaxScheme = relax.scheme;
+    header.relaxThreads = relax.threads;
+    header.relaxBandRows = relax.bandRows;
+    if(fwrite(&header, sizeof(header), 1, file) != 1)
+    {
+        perror(path);
+        fclose(file);
+        file = NULL;
+        return 0;
+    }
+
+    lastTime = 0;
+    numSteps = 0;
+    return 1;
+}
+
+int InputLogWriter::close()
+{
+    if(!file) return 0;
+
+    long bytes = ftell(file);
+    int ok = fclose(file) == 0;
+    file = NULL;
+
+    if(!ok) perror("input log");
+    else printf("logged %d steps of input in %ld bytes\n", numSteps, bytes);
+    return ok;
+}
+
+void InputLogWriter::put(int type)
+{
+    if(file) fputc(type, file);
+}
+
+void InputLogWriter::putVarint(uint32_t value)
+{
+    while(value >= 0x80)
+    {
+        fputc((value & 0x7F) | 0x80, file);
+        value >>= 7;
+    }
+    fputc(value, file);
+}
+
+void InputLogWriter::putFloat(float value)
+{
+    fwrite(&value, sizeof(float), 1, file);
+}
+
+void InputLogWriter::velocity(int i, int j, float x, float y)
+{
+    if(!file) return;
+
+    put(INPUT_VELOCITY);
+    putVarint(i);
+    putVarint(j);
+    putFloat(x);
+    putFloat(y);
+}
+
+void InputLogWriter::density(int i, int j, float value)
+{
+    if(!file) return;
+
+    put(INPUT_DENSITY);
+    putVarint(i);
+    putVarint(j);
+    putFloat(value);
+}
+
+void InputLogWriter::effort(int iterations, int optional)
+{
+    if(!file) return;
+
+    put(INPUT_EFFORT);
+    putVarint(iterations);
+    putVarint(optional);
+}
+
+void InputLogWriter::write(const InputEvent *event)
+{
+    switch(event->type)
+    {
+        case INPUT_VELOCITY:
+            velocity(event->i, event->j, event->x, event->y);
+            break;
+        case INPUT_DENSITY:
+            density(event->i, event->j, event->x);
+            break;
+        case INPUT_STEP:
+            step(event->time);
+            break;
+        case INPUT_EFFORT:
+            effort(event->i, event->j);
+            break;
+        default:
+            put(event->type);
+            break;
+    }
+}
+
+void InputLogWriter::step(uint32_t time)
+{
+    if(!file) return;
+
+    //times only grow, so the deltas stay a byte or two
+    if(time < lastTime) time = lastTime;
+    put(INPUT_STEP);
+    putVarint(time-lastTime);
+    lastTime = time;
+    numSteps++;
+}
+
+InputLogReader::InputLogReader()
+{
+    map = NULL;
+    mapSize = 0;
+    pos = 0;
+    time = 0;
+    relax.scheme = RELAX_COLUMNS;
+    relax.threads = 1;
+    relax.bandRows = 16;
+}
+
+InputLogReader::~InputLogReader()
+{
+    close();
+}
+
+int InputLogReader::open(const char *path, const char *solver, int width, int height)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        perror(path);
+        return 0;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(InputLogHeader))
+    {
+        fprintf(stderr, "%s: not an input log\n", path);
+        ::close(fd);
+        return 0;
+    }
+
+    void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    ::close(fd);
+    if(ptr == MAP_FAILED)
+    {
+        perror(path);
+        return 0;
+    }
+    map = (unsigned char *)ptr;
+    mapSize = st.st_size;
+
+    InputLogHeader *header = (InputLogHeader *)map;
+    const char *error = NULL;
+    if(memcmp(header->magic, INPUTLOG_MAGIC, 8) != 0) error = "not an input log";
+    else if(header->version != INPUTLOG_VERSION) error = "unsupported input log version";
+    else if(header->byteOrder != BYTE_ORDER_MARK) error = "input log written with another byte order";
+    else if(strncmp(header->solver, solver, INPUTLOG_NAME) != 0) error = "input log of another solver";
+    else if(header->width != (uint32_t)width || header->height != (uint32_t)height) error = "input log of another grid size";
+
+    if(error)
+    {
+        fprintf(stderr, "%s: %s\n", path, error);
+        close();
+        return 0;
+    }
+
+    relax.scheme = header->relaxScheme;
+    relax.threads = header->relaxThreads;
+    relax.bandRows = header->relaxBandRows;
+
+    madvise(map, mapSize, MADV_SEQUENTIAL);
+    rewind();
+    return 1;
+}
+
+void InputLogReader::close()
+{
+    if(map) munmap(map, mapSize);
+    map = NULL;
+    mapSize = 0;
+    pos = 0;
+    time = 0;
+}
+
+void InputLogReader::rewind()
+{
+    pos = sizeof(InputLogHeader);
+    time = 0;
+}
+
+int InputLogReader::getVarint(uint32_t *value)
+{
+    *value = 0;
+    for(int shift=0; shift<35 && pos<mapSize; shift+=7)
+    {
+        unsigned char byte = map[pos++];
+        *value |= (uint32_t)(byte & 0x7F)<<shift;
+        if(!(byte & 0x80)) return 1;
+    }
+    return 0;
+}
+
+int InputLogReader::getFloat(float *value)
+{
+    if(pos+sizeof(float) > mapSize) return 0;
+
+    memcpy(value, map+pos, sizeof(float));
+    pos += sizeof(float);
+    return 1;
+}
+
+int InputLogReader::next(InputEvent *event)
+{
+    if(!map || pos >= mapSize) return 0;
+
+    memset(event, 0, sizeof(InputEvent));
+    event->type = map[pos++];
+
+    //a log cut short by a crash ends at its last complete event
+    uint32_t i, j, delta;
+    switch(event->type)
+    {
+        case INPUT_VELOCITY:
+            if(!getVarint(&i) || !getVarint(&j) || !getFloat(&event->x) || !getFloat(&event->y)) return 0;
+            event->i = i;
+            event->j = j;
+            break;
+        case INPUT_DENSITY:
+            if(!getVarint(&i) || !getVarint(&j) || !getFloat(&event->x)) return 0;
+            event->i = i;
+            event->j = j;
+            break;
+        case INPUT_STEP:
+            if(!getVarint(&delta)) return 0;
+            time += delta;
+            break;
+        case INPUT_EFFORT:
+            if(!getVarint(&i) || !getVarint(&j)) return 0;
+            event->i = i;
+            event->j = j;
+            break;
+        case INPUT_CLEAN:
+        case INPUT_SOURCE:
+        case INPUT_RESET:
+        case INPUT_START:
+        case INPUT_STOP:
+            break;
+        default:
+            fprintf(stderr, "input log: unknown event %d\n", event->type);
+            pos = mapSize;
+            return 0;
+    }
+    event->time = time;
+    return 1;
+}
+
+int replayInput(InputLogReader *reader, ApplyInput apply, void *arg, int realtime, double *seconds)
+{
+    std::chrono::steady_clock::time_point start = std::chrono::steady_clock::now();
+    int steps = 0;
+
+    InputEvent event;
+    while(reader->next(&event))
+    {
+        if(realtime && event.type == INPUT_STEP)
+        {
+            std::this_thread::sleep_until(start+std::chrono::milliseconds(event.time));
+        }
+        apply(arg, &event);
+        if(event.type == INPUT_STEP) steps++;
+    }
+
+    *seconds = std::chrono::duration<double>(std::chrono::steady_clock::now()-start).count();
+    return steps;
+}
+
+uint64_t hashField(const float *field, int count, uint64_t hash)
+{
+    const unsigned char *bytes = (const unsigned char *)field;
+    for(uint64_t k=0; k<(uint64_t)count*sizeof(float); k++)
+    {
+        hash ^= bytes[k];
+        hash *= 0x100000001b3ull;
+    }
+    return hash;
+}
@@ -0,0 +1,152 @@
+/** File:    InputLog.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __INPUTLOG_H__
+#define __INPUTLOG_H__
+
+#include "Relax.h"
+#include <stdint.h>
+#include <stdio.h>
+
+//log of everything the viewer feeds a solver, in the order it happens
+//  header | events
+//an event is a type byte followed by its arguments: grid positions and times
+//as LEB128 varints, values as raw floats. replaying the events calls the
+//solver exactly as the viewer did, with the relaxation the header names, so a
+//replay on the same build reproduces the fields bit for bit
+#define INPUTLOG_MAGIC "SFINP\r\n"
+#define INPUTLOG_VERSION 2
+#define INPUTLOG_NAME 16
+
+//event types
+#define INPUT_CLEAN 0       //cleanBuffer()
+#define INPUT_VELOCITY 1    //velocity source (i, j, x, y)
+#define INPUT_DENSITY 2     //density source (i, j, x)
+#define INPUT_SOURCE 3      //addSource()
+#define INPUT_STEP 4        //one simulation step, time in ms since the log started
+#define INPUT_RESET 5
+#define INPUT_START 6
+#define INPUT_STOP 7
+#define INPUT_EFFORT 8      //sweeps per solve i and optional stages j from the next step on
+
+struct InputLogHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    char solver[INPUTLOG_NAME];
+    uint32_t width;
+    uint32_t height;
+    //RelaxConfig of the solver, the schemes give different numbers
+    uint32_t relaxScheme;
+    uint32_t relaxThreads;
+    uint32_t relaxBandRows;
+};
+
+struct InputEvent
+{
+    int type;
+    int i;
+    int j;
+    float x;
+    float y;
+    uint32_t time;
+};
+
+//an event with the arguments its type does not use left 0
+InputEvent inputEvent(int type, int i = 0, int j = 0, float x = 0.0f, float y = 0.0f, uint32_t time = 0);
+
+class InputLogWriter
+{
+public:
+    InputLogWriter();
+    ~InputLogWriter();
+
+    //width and height of the solver grid, replays need the same, and the relaxation
+    //the solver runs, replays run it too; returns 1 on success
+    int open(const char *path, const char *solver, int width, int height, RelaxConfig relax);
+    int isOpen(){ return file != NULL; }
+    int close();
+
+    //every call is ignored while no log is open
+    void clean(){ put(INPUT_CLEAN); }
+    void velocity(int i, int j, float x, float y);
+    void density(int i, int j, float value);
+    void source(){ put(INPUT_SOURCE); }
+    void step(uint32_t time);
+    void reset(){ put(INPUT_RESET); }
+    void start(){ put(INPUT_START); }
+    void stop(){ put(INPUT_STOP); }
+    void effort(int iterations, int optional);
+    //any of the above
+    void write(const InputEvent *event);
+
+private:
+    void put(int type);
+    void putVarint(uint32_t value);
+    void putFloat(float value);
+
+private:
+    FILE *file;
+    uint32_t lastTime;
+    int numSteps;
+};
+
+class InputLogReader
+{
+public:
+    InputLogReader();
+    ~InputLogReader();
+
+    //maps path and checks it was logged from the named solver and grid, returns 1 on success
+    int open(const char *path, const char *solver, int width, int height);
+    void close();
+    //back to the first event
+    void rewind();
+    //the relaxation the log was written with
+    RelaxConfig getRelaxConfig(){ return relax; }
+
+    //the next event, 0 at the end of the log
+    int next(InputEvent *event);
+
+private:
+    int getVarint(uint32_t *value);
+    int getFloat(float *value);
+
+private:
+    unsigned char *map;
+    uint64_t mapSize;
+    uint64_t pos;
+    uint32_t time;
+    RelaxConfig relax;
+};
+
+typedef void (*ApplyInput)(void *arg, const InputEvent *event);
+
+//feeds every event of reader to apply, as fast as it goes or at the pace the
+//steps were logged at, returns the number of steps and the time they took
+int replayInput(InputLogReader *reader, ApplyInput apply, void *arg, int realtime, double *seconds);
+
+//FNV-1a over the bytes of a field, chained through hash, to compare replays
+uint64_t hashField(const float *field, int count, uint64_t hash);
+#define FIELD_HASH_SEED 0xcbf29ce484222325ull
+
+#endif
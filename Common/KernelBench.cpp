@@ -0,0 +1,243 @@
+/** File:    KernelBench.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef _GNU_SOURCE
+#define _GNU_SOURCE
+#endif
+#include "KernelBench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <sched.h>
+#include <chrono>
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+KernelBench::KernelBench()
+{
+    numSizes = 0;
+    for(int size=64; size<=4096; size*=2) sizes[numSizes++] = size;
+    trials = 5;
+    warmup = 2;
+    minTime = 0.05;
+    cpu = -2;
+    filter = NULL;
+    jsonPath = NULL;
+    hasRelax = 0;
+    roofline = 0;
+    peaks.bandwidth = 0.0;
+    peaks.flops = 0.0;
+    csvPath = NULL;
+    csv = NULL;
+    solverName = "";
+}
+
+int KernelBench::parseArgs(int argc, char **argv)
+{
+    int ok = 1;
+    for(int arg=1; ok && arg<argc; arg++)
+    {
+        //the only option without a value
+        if(strcmp(argv[arg], "-roofline") == 0)
+        {
+            roofline = 1;
+            continue;
+        }
+        if(arg+1 >= argc)
+        {
+            ok = 0;
+            break;
+        }
+
+        const char *option = argv[arg];
+        const char *value = argv[++arg];
+        if(strcmp(option, "-sizes") == 0)
+        {
+            numSizes = 0;
+            for(char *item=strtok(argv[arg], ","); item && numSizes<BENCH_MAX_SIZES; item=strtok(NULL, ","))
+            {
+                if(atoi(item) >= 8) sizes[numSizes++] = atoi(item);
+            }
+        }
+        else if(strcmp(option, "-trials") == 0) trials = atoi(value) < 2 ? 2 : atoi(value);
+        else if(strcmp(option, "-warmup") == 0) warmup = atoi(value) < 1 ? 1 : atoi(value);
+        else if(strcmp(option, "-time") == 0) minTime = atof(value);
+        else if(strcmp(option, "-cpu") == 0) cpu = atoi(value);
+        else if(strcmp(option, "-kernel") == 0) filter = value;
+        else if(strcmp(option, "-json") == 0) jsonPath = value;
+        else if(strcmp(option, "-relax") == 0) ok = hasRelax = parseRelaxConfig(value, &relax);
+        else if(strcmp(option, "-csv") == 0) csvPath = value;
+        else ok = 0;
+    }
+
+    if(trials > BENCH_MAX_SAMPLES) trials = BENCH_MAX_SAMPLES;
+
+    if(!ok || numSizes == 0)
+    {
+        fprintf(stderr, "usage: %s [-sizes 64,128,...] [-trials n] [-warmup n] [-time seconds] [-cpu n] [-kernel name] [-json path]\n"
+                        "       [-relax scheme,threads,rows] [-roofline] [-csv path]\n", argv[0]);
+        return 0;
+    }
+    return 1;
+}
+
+int KernelBench::begin(const char *solver)
+{
+    //stay on the cpu we started on unless told otherwise, migrations show up as noise
+    if(cpu == -2) cpu = sched_getcpu();
+    if(cpu >= 0)
+    {
+        cpu_set_t set;
+        CPU_ZERO(&set);
+        CPU_SET(cpu, &set);
+        if(sched_setaffinity(0, sizeof(set), &set) != 0)
+        {
+            perror("sched_setaffinity");
+            cpu = -1;
+        }
+    }
+
+    if(cpu >= 0) printf("%s kernels, pinned to cpu %d, %d trials of %.0f ms", solver, cpu, trials, minTime*1000.0);
+    else printf("%s kernels, unpinned, %d trials of %.0f ms", solver, trials, minTime*1000.0);
+    if(hasRelax) printf(", %s relaxation on %d thread%s, %d rows per band", relaxSchemeName(relax.scheme), relax.threads,
+                        relax.threads > 1 ? "s" : "", relax.bandRows);
+    printf("\n");
+    solverName = solver;
+
+    if(roofline)
+    {
+        measurePeaks(&peaks, 5);
+        printf("roofline: %.2f GB/s stream triad, %.2f GFLOP/s multiply-add, ridge at %.2f flop/byte\n",
+               peaks.bandwidth, peaks.flops, peaks.flops/peaks.bandwidth);
+        printf("%-16s %9s %10s %8s %8s %9s %8s %9s %7s %-7s\n", "kernel", "size", "ns/cell", "stddev", "GB/s", "GFLOP/s",
+               "flop/B", "roof", "%roof", "bound");
+    }
+    else printf("%-16s %9s %10s %8s %10s %8s %9s\n", "kernel", "size", "ns/cell", "stddev", "min", "GB/s", "calls");
+
+    if(csvPath)
+    {
+        csv = fopen(csvPath, "w");
+        if(!csv)
+        {
+            perror(csvPath);
+            return 0;
+        }
+        fprintf(csv, "solver,kernel,size,ns_per_cell,stddev_pct,gbytes_per_s,gflops,flops_per_byte,"
+                     "peak_gbytes_per_s,peak_gflops,attainable_gflops,pct_of_roof,bound\n");
+    }
+
+    //the kernels run on this thread alone unless the relaxation brings its own
+    if(jsonPath) return report.open(jsonPath, "bench", solver, hasRelax ? relax.threads : 1, cpu);
+    return 1;
+}
+
+int KernelBench::end()
+{
+    int ok = 1;
+    if(csv)
+    {
+        ok = !ferror(csv);
+        ok = fclose(csv) == 0 && ok;
+        csv = NULL;
+        if(!ok) fprintf(stderr, "%s: write failed\n", csvPath);
+    }
+    if(report.isOpen() && !report.close())
+    {
+        fprintf(stderr, "%s: write failed\n", jsonPath);
+        ok = 0;
+    }
+    return ok;
+}
+
+int KernelBench::wants(const char *kernel)
+{
+    return !filter || strstr(kernel, filter) != NULL;
+}
+
+void KernelBench::run(const char *kernel, int size, double cells, double bytesPerCell, double flopsPerCell, BenchKernel func, void *arg)
+{
+    if(!wants(kernel)) return;
+
+    //the warmup also says how many calls make up a trial
+    double start = now();
+    for(int k=0; k<warmup; k++) func(arg);
+    double perCall = (now()-start)/warmup;
+    int calls = perCall > 0.0 ? (int)ceil(minTime/perCall) : 1;
+    if(calls < 1) calls = 1;
+
+    double sum = 0.0;
+    double sumSquares = 0.0;
+    double best = 1e30;
+    double samples[BENCH_MAX_SAMPLES];
+    for(int t=0; t<trials; t++)
+    {
+        start = now();
+        for(int k=0; k<calls; k++) func(arg);
+        double time = (now()-start)/calls;
+
+        samples[t] = time/cells*1e9;
+        sum += time;
+        sumSquares += time*time;
+        if(time < best) best = time;
+    }
+
+    double mean = sum/trials;
+    double variance = (sumSquares-sum*mean)/(trials-1);
+    double stddev = variance > 0.0 ? sqrt(variance) : 0.0;
+
+    double bandwidth = bytesPerCell*cells/mean/1e9;
+    double flops = flopsPerCell*cells/mean/1e9;
+    double intensity = bytesPerCell > 0.0 ? flopsPerCell/bytesPerCell : 0.0;
+    double attainable = rooflineAttainable(&peaks, intensity);
+    const char *bound = intensity < peaks.flops/peaks.bandwidth ? "memory" : "compute";
+
+    char sizeText[32];
+    snprintf(sizeText, sizeof(sizeText), "%dx%d", size, size);
+    if(roofline)
+    {
+        printf("%-16s %9s %10.3f %7.2f%% %8.2f %9.3f %8.3f %9.3f %6.1f%% %-7s\n", kernel, sizeText, mean/cells*1e9,
+               stddev/mean*100.0, bandwidth, flops, intensity, attainable, attainable > 0.0 ? flops/attainable*100.0 : 0.0, bound);
+    }
+    else
+    {
+        printf("%-16s %9s %10.3f %7.2f%% %10.3f %8.2f %4dx%-4d\n", kernel, sizeText, mean/cells*1e9, stddev/mean*100.0,
+               best/cells*1e9, bandwidth, trials, calls);
+    }
+    fflush(stdout);
+
+    //the roofline columns stay empty without -roofline
+    if(csv)
+    {
+        fprintf(csv, "%s,%s,%d,%.4f,%.3f,%.4f,%.4f,%.4f", solverName, kernel, size, mean/cells*1e9, stddev/mean*100.0,
+                bandwidth, flops, intensity);
+        if(roofline) fprintf(csv, ",%.3f,%.3f,%.4f,%.2f,%s\n", peaks.bandwidth, peaks.flops, attainable,
+                             attainable > 0.0 ? flops/attainable*100.0 : 0.0, bound);
+        else fprintf(csv, ",,,,,\n");
+    }
+
+    BenchResult result;
+    initBenchResult(&result, "kernel", kernel, size, "ns/cell", samples, trials);
+    report.add(&result);
+}
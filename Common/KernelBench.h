@@ -0,0 +1,86 @@
+/** File:    KernelBench.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __KERNELBENCH_H__
+#define __KERNELBENCH_H__
+
+//times solver kernels in isolation for the bench programs
+//every kernel is warmed up, then timed over several trials of enough calls to
+//last minTime each; the report gives the mean time per cell, the spread of
+//the trials and the bandwidth implied by the bytes a kernel has to move per cell.
+//with -roofline the machine's peaks are probed first and every kernel is placed
+//on the roofline by the flops it does per byte it moves
+#include "BenchReport.h"
+#include "Relax.h"
+#include "Roofline.h"
+#include <stdio.h>
+
+typedef void (*BenchKernel)(void *arg);
+
+#define BENCH_MAX_SIZES 16
+
+class KernelBench
+{
+public:
+    KernelBench();
+
+    //  -sizes 64,128,...  -trials n  -warmup n  -time seconds  -cpu n (-1 leaves the thread unpinned)
+    //  -kernel name       only kernels whose name contains name
+    //  -json path         also writes the results as a BenchReport
+    //  -relax scheme[,threads[,bandRows]]  relaxation the solver is set to, see Relax.h
+    //  -roofline          probes the peak bandwidth and flop rate, reports each kernel against them
+    //  -csv path          also writes the table as CSV
+    //returns 0 and prints the usage on a bad argument
+    int parseArgs(int argc, char **argv);
+    //pins the calling thread, prints the table header and opens the report, returns 1 on success
+    int begin(const char *solver);
+    //closes the reports, returns 1 if they were written
+    int end();
+
+    int getNumSizes(){ return numSizes; }
+    int getSize(int k){ return sizes[k]; }
+    int wants(const char *kernel);
+    //the relaxation asked for, 0 to leave the solver's own
+    int getRelax(RelaxConfig *config){ *config = relax; return hasRelax; }
+
+    //cells the kernel updates per call, the bytes it reads and writes and the flops it does per cell
+    void run(const char *kernel, int size, double cells, double bytesPerCell, double flopsPerCell, BenchKernel func, void *arg);
+
+private:
+    int sizes[BENCH_MAX_SIZES];
+    int numSizes;
+    int trials;
+    int warmup;
+    double minTime;
+    int cpu;
+    const char *filter;
+    const char *jsonPath;
+    BenchReport report;
+    RelaxConfig relax;
+    int hasRelax;
+    int roofline;
+    RooflinePeaks peaks;
+    const char *csvPath;
+    FILE *csv;
+    const char *solverName;
+};
+
+#endif
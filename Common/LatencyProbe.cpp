@@ -0,0 +1,145 @@
+/** File:    LatencyProbe.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "LatencyProbe.h"
+#include <algorithm>
+#include <chrono>
+#include <stdio.h>
+
+static double getSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+LatencyProbe::LatencyProbe()
+{
+    on = 0;
+    numFrames = 0;
+    batch = 1;
+    consumeTime = 0.0;
+    stepTime = 0.0;
+}
+
+void LatencyProbe::input()
+{
+    if(!on) return;
+
+    PendingInput event;
+    event.time = getSeconds();
+    event.batch = batch;
+    pending.push_back(event);
+}
+
+void LatencyProbe::consumed()
+{
+    consumed(batch, getSeconds());
+}
+
+void LatencyProbe::consumed(uint32_t lastBatch, double time)
+{
+    if(!on) return;
+
+    //a frame that consumes input before the last one was presented takes over its events
+    size_t kept = 0;
+    for(size_t k=0; k<pending.size(); k++)
+    {
+        if(pending[k].batch <= lastBatch)
+        {
+            inFlight.push_back(pending[k].time);
+            consumeTime = time;
+            stepTime = 0.0;
+        }
+        else pending[kept++] = pending[k];
+    }
+    pending.resize(kept);
+}
+
+void LatencyProbe::stepped()
+{
+    stepped(getSeconds());
+}
+
+void LatencyProbe::stepped(double time)
+{
+    if(!on || inFlight.empty()) return;
+    stepTime = time;
+}
+
+void LatencyProbe::presented()
+{
+    if(!on || inFlight.empty()) return;
+
+    double now = getSeconds();
+    //no step ran in between, e.g. while paused
+    double step = stepTime > 0.0 ? stepTime : consumeTime;
+    for(size_t k=0; k<inFlight.size(); k++)
+    {
+        LatencySample sample;
+        sample.queue = (float)((consumeTime-inFlight[k])*1000.0);
+        sample.simulate = (float)((step-consumeTime)*1000.0);
+        sample.present = (float)((now-step)*1000.0);
+        sample.total = (float)((now-inFlight[k])*1000.0);
+        samples.push_back(sample);
+    }
+    inFlight.clear();
+    numFrames++;
+}
+
+static void printRow(const char *name, std::vector<float> &values)
+{
+    std::sort(values.begin(), values.end());
+
+    size_t n = values.size();
+    double sum = 0.0;
+    for(size_t k=0; k<n; k++) sum += values[k];
+
+    printf("%-10s %8.2f %8.2f %8.2f %8.2f %8.2f %8.2f\n", name, values[0], values[n/2], values[n*9/10],
+           values[n*99/100], values[n-1], sum/n);
+}
+
+int LatencyProbe::print()
+{
+    if(samples.empty())
+    {
+        if(on) printf("latency: no input reached the screen\n");
+        return 0;
+    }
+
+    std::vector<float> queue;
+    std::vector<float> simulate;
+    std::vector<float> present;
+    std::vector<float> total;
+    for(size_t k=0; k<samples.size(); k++)
+    {
+        queue.push_back(samples[k].queue);
+        simulate.push_back(samples[k].simulate);
+        present.push_back(samples[k].present);
+        total.push_back(samples[k].total);
+    }
+
+    printf("latency: %d input events in %d frames, ms from event to present\n", (int)samples.size(), numFrames);
+    printf("%-10s %8s %8s %8s %8s %8s %8s\n", "", "min", "p50", "p90", "p99", "max", "mean");
+    printRow("queue", queue);
+    printRow("simulate", simulate);
+    printRow("present", present);
+    printRow("total", total);
+    return 1;
+}
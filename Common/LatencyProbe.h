@@ -0,0 +1,86 @@
+/** File:    LatencyProbe.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __LATENCYPROBE_H__
+#define __LATENCYPROBE_H__
+
+#include <stdint.h>
+#include <vector>
+
+//input-to-photon latency of an interactive viewer. every input event is
+//stamped when it arrives and followed through the frame that consumes it:
+//  queue     event until addSource hands it to the solver
+//  simulate  addSource until the simulation step is done
+//  present   step until the swapped frame has been drawn
+//present ends when glFinish returns after the swap, the display adds up to
+//one refresh of scanout on top that no timer in the program can see
+struct LatencySample
+{
+    float queue;
+    float simulate;
+    float present;
+    float total;
+};
+
+struct PendingInput
+{
+    double time;
+    uint32_t batch;
+};
+
+class LatencyProbe
+{
+public:
+    LatencyProbe();
+
+    void start(){ on = 1; }
+    int isOn(){ return on; }
+
+    //every call is ignored until start()
+    void input();
+    void consumed();
+    void stepped();
+    void presented();
+
+    //with the solver on another thread, input goes out in numbered batches and
+    //the frames that come back say which batch they include and when it was
+    //applied and stepped
+    uint32_t nextBatch(){ return batch++; }
+    void consumed(uint32_t lastBatch, double time);
+    void stepped(double time);
+
+    //percentiles of every part in ms, returns 0 if no event made it to the screen
+    int print();
+
+private:
+    int on;
+    int numFrames;
+    uint32_t batch;
+    //events no frame has consumed yet
+    std::vector<PendingInput> pending;
+    //events of the frame in progress
+    std::vector<double> inFlight;
+    double consumeTime;
+    double stepTime;
+    std::vector<LatencySample> samples;
+};
+
+#endif
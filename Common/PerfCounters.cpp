@@ -0,0 +1,336 @@
+/** File:    PerfCounters.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "PerfCounters.h"
+#include "Tracer.h"
+#include <chrono>
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <errno.h>
+#include <unistd.h>
+#include <sys/ioctl.h>
+#include <sys/syscall.h>
+#include <linux/perf_event.h>
+
+static const char *eventNames[PERF_EVENTS] =
+{
+    "cycles", "instructions", "L1d misses", "LLC misses", "dTLB misses", "branch misses", "task clock"
+};
+
+static uint64_t cacheMiss(int cache)
+{
+    return (uint64_t)cache | ((uint64_t)PERF_COUNT_HW_CACHE_OP_READ<<8) | ((uint64_t)PERF_COUNT_HW_CACHE_RESULT_MISS<<16);
+}
+
+static void getEvent(int event, perf_event_attr *attr)
+{
+    switch(event)
+    {
+        case PERF_CYCLES: attr->type = PERF_TYPE_HARDWARE; attr->config = PERF_COUNT_HW_CPU_CYCLES; break;
+        case PERF_INSTRUCTIONS: attr->type = PERF_TYPE_HARDWARE; attr->config = PERF_COUNT_HW_INSTRUCTIONS; break;
+        case PERF_L1D_MISSES: attr->type = PERF_TYPE_HW_CACHE; attr->config = cacheMiss(PERF_COUNT_HW_CACHE_L1D); break;
+        case PERF_LLC_MISSES: attr->type = PERF_TYPE_HW_CACHE; attr->config = cacheMiss(PERF_COUNT_HW_CACHE_LL); break;
+        case PERF_DTLB_MISSES: attr->type = PERF_TYPE_HW_CACHE; attr->config = cacheMiss(PERF_COUNT_HW_CACHE_DTLB); break;
+        case PERF_BRANCH_MISSES: attr->type = PERF_TYPE_HARDWARE; attr->config = PERF_COUNT_HW_BRANCH_MISSES; break;
+        default: attr->type = PERF_TYPE_SOFTWARE; attr->config = PERF_COUNT_SW_TASK_CLOCK; break;
+    }
+}
+
+PerfCounters::PerfCounters()
+{
+    leader = -1;
+    numOpen = 0;
+    for(int e=0; e<PERF_EVENTS; e++)
+    {
+        fds[e] = -1;
+        slot[e] = -1;
+    }
+    problem[0] = 0;
+}
+
+PerfCounters::~PerfCounters()
+{
+    close();
+}
+
+int PerfCounters::open()
+{
+    close();
+
+    int firstErrno = 0;
+    for(int e=0; e<PERF_EVENTS; e++)
+    {
+        perf_event_attr attr;
+        memset(&attr, 0, sizeof(attr));
+        attr.size = sizeof(attr);
+        getEvent(e, &attr);
+        attr.exclude_kernel = 1;
+        attr.exclude_hv = 1;
+        attr.read_format = PERF_FORMAT_GROUP | PERF_FORMAT_TOTAL_TIME_ENABLED | PERF_FORMAT_TOTAL_TIME_RUNNING;
+        //the group starts stopped and is enabled in one go below
+        attr.disabled = leader < 0;
+
+        //this thread, any cpu
+        int fd = (int)syscall(SYS_perf_event_open, &attr, 0, -1, leader, 0);
+        if(fd < 0)
+        {
+            if(e < PERF_TASK_CLOCK && firstErrno == 0) firstErrno = errno;
+            continue;
+        }
+        if(leader < 0) leader = fd;
+        fds[e] = fd;
+        slot[e] = numOpen++;
+    }
+
+    if(firstErrno != 0)
+    {
+        FILE *file = fopen("/proc/sys/kernel/perf_event_paranoid", "r");
+        int paranoid = 0;
+        if(file)
+        {
+            if(fscanf(file, "%d", &paranoid) != 1) paranoid = 0;
+            fclose(file);
+        }
+        snprintf(problem, sizeof(problem), "%s, perf_event_paranoid is %d", strerror(firstErrno), paranoid);
+    }
+
+    if(leader >= 0)
+    {
+        ioctl(leader, PERF_EVENT_IOC_RESET, PERF_IOC_FLAG_GROUP);
+        ioctl(leader, PERF_EVENT_IOC_ENABLE, PERF_IOC_FLAG_GROUP);
+    }
+    return numOpen;
+}
+
+void PerfCounters::close()
+{
+    for(int e=0; e<PERF_EVENTS; e++)
+    {
+        if(fds[e] >= 0) ::close(fds[e]);
+        fds[e] = -1;
+        slot[e] = -1;
+    }
+    leader = -1;
+    numOpen = 0;
+}
+
+void PerfCounters::read(uint64_t values[PERF_EVENTS])
+{
+    //nr, time enabled, time running, one value per counter in the order they were opened
+    uint64_t data[3+PERF_EVENTS];
+    for(int e=0; e<PERF_EVENTS; e++) values[e] = 0;
+    if(leader < 0 || ::read(leader, data, sizeof(data)) < (ssize_t)(3*sizeof(uint64_t))) return;
+
+    double scale = data[2] > 0 && data[2] < data[1] ? (double)data[1]/data[2] : 1.0;
+    for(int e=0; e<PERF_EVENTS; e++)
+    {
+        if(slot[e] >= 0 && slot[e] < (int)data[0]) values[e] = (uint64_t)(data[3+slot[e]]*scale);
+    }
+}
+
+//stage accounting, driven by the tracer hook
+struct StageTotals
+{
+    const char *name;
+    uint64_t calls;
+    //summed over the calls, the grid may have changed size in between
+    uint64_t cells;
+    uint64_t sums[PERF_EVENTS];
+};
+
+struct StageWindow
+{
+    int numStages;
+    StageTotals stages[STAGE_MAX];
+};
+
+#define STAGE_DEPTH 32
+
+static PerfCounters counters;
+static int countersCells;
+static int countersRunning = 0;
+//since the start and since the current overlay window began
+static StageWindow total;
+static StageWindow window;
+//what the overlay shows, the last complete window
+static char lines[STAGE_MAX+2][STAGE_LINE];
+static int numLines;
+static double windowStart;
+
+static int depth;
+static uint64_t beginValues[STAGE_DEPTH][PERF_EVENTS];
+
+static double getSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static StageTotals* findStage(StageWindow *stages, const char *name)
+{
+    //names are literals, the same one may have an address per object file
+    for(int k=0; k<stages->numStages; k++)
+    {
+        if(stages->stages[k].name == name || strcmp(stages->stages[k].name, name) == 0) return &stages->stages[k];
+    }
+    if(stages->numStages == STAGE_MAX) return NULL;
+
+    StageTotals *stage = &stages->stages[stages->numStages++];
+    memset(stage, 0, sizeof(StageTotals));
+    stage->name = name;
+    return stage;
+}
+
+static void addStage(StageWindow *stages, const char *name, const uint64_t *delta)
+{
+    StageTotals *stage = findStage(stages, name);
+    if(!stage) return;
+    stage->calls++;
+    stage->cells += countersCells;
+    for(int e=0; e<PERF_EVENTS; e++) stage->sums[e] += delta[e];
+}
+
+static void onStage(const char *name, char phase)
+{
+    if(phase == 'B')
+    {
+        if(depth < STAGE_DEPTH) counters.read(beginValues[depth]);
+        depth++;
+        return;
+    }
+
+    if(depth == 0) return;
+    depth--;
+    if(depth >= STAGE_DEPTH) return;
+
+    uint64_t values[PERF_EVENTS];
+    counters.read(values);
+    for(int e=0; e<PERF_EVENTS; e++) values[e] -= beginValues[depth][e];
+    addStage(&total, name, values);
+    addStage(&window, name, values);
+}
+
+//a number per cell and call, or a dash for a missing counter
+static void formatPerCell(char *text, int size, const StageTotals *stage, int event)
+{
+    if(!counters.has(event)) snprintf(text, size, "%9s", "-");
+    else snprintf(text, size, "%9.3f", (double)stage->sums[event]/stage->cells);
+}
+
+static void formatStage(char *text, int size, const StageTotals *stage)
+{
+    char ms[16];
+    char ipc[16];
+    char perCell[4][16];
+
+    if(counters.has(PERF_TASK_CLOCK)) snprintf(ms, sizeof(ms), "%8.3f", stage->sums[PERF_TASK_CLOCK]/1e6/stage->calls);
+    else snprintf(ms, sizeof(ms), "%8s", "-");
+    if(counters.has(PERF_CYCLES) && counters.has(PERF_INSTRUCTIONS) && stage->sums[PERF_CYCLES] > 0)
+        snprintf(ipc, sizeof(ipc), "%6.2f", (double)stage->sums[PERF_INSTRUCTIONS]/stage->sums[PERF_CYCLES]);
+    else snprintf(ipc, sizeof(ipc), "%6s", "-");
+    formatPerCell(perCell[0], sizeof(perCell[0]), stage, PERF_L1D_MISSES);
+    formatPerCell(perCell[1], sizeof(perCell[1]), stage, PERF_LLC_MISSES);
+    formatPerCell(perCell[2], sizeof(perCell[2]), stage, PERF_DTLB_MISSES);
+    formatPerCell(perCell[3], sizeof(perCell[3]), stage, PERF_BRANCH_MISSES);
+
+    snprintf(text, size, "%-16.16s %8llu %s %s %s %s %s %s", stage->name, (unsigned long long)stage->calls,
+             ms, ipc, perCell[0], perCell[1], perCell[2], perCell[3]);
+}
+
+static void formatHeader(char *text, int size)
+{
+    snprintf(text, size, "%-16s %8s %8s %6s %9s %9s %9s %9s", "stage", "calls", "ms/call", "IPC",
+             "L1d/cell", "LLC/cell", "dTLB/cell", "br/cell");
+}
+
+int countersStart(int cells)
+{
+    if(countersRunning) return 1;
+    if(counters.open() == 0)
+    {
+        printf("counters: none available (%s)\n", counters.getProblem());
+        return 0;
+    }
+
+    //say which columns will stay empty
+    if(counters.getProblem()[0])
+    {
+        printf("counters: no");
+        for(int e=0; e<PERF_EVENTS; e++) if(!counters.has(e)) printf(" [%s]", eventNames[e]);
+        printf(" (%s), shown as -\n", counters.getProblem());
+    }
+
+    countersCells = cells > 0 ? cells : 1;
+    countersRunning = 1;
+    total.numStages = 0;
+    window.numStages = 0;
+    numLines = 0;
+    depth = 0;
+    windowStart = getSeconds();
+
+    traceSetHook(onStage);
+    atexit(countersPrint);
+    return 1;
+}
+
+int countersOn()
+{
+    return countersRunning;
+}
+
+void countersSetCells(int cells)
+{
+    countersCells = cells > 0 ? cells : 1;
+}
+
+void countersFrame()
+{
+    if(!countersRunning) return;
+
+    double now = getSeconds();
+    if(now-windowStart < 1.0) return;
+    windowStart = now;
+
+    numLines = 0;
+    formatHeader(lines[numLines++], STAGE_LINE);
+    for(int k=0; k<window.numStages; k++) formatStage(lines[numLines++], STAGE_LINE, &window.stages[k]);
+    window.numStages = 0;
+}
+
+const char* countersLine(int k)
+{
+    return k < numLines ? lines[k] : NULL;
+}
+
+void countersPrint()
+{
+    if(!countersRunning || total.numStages == 0) return;
+
+    char text[STAGE_LINE];
+    printf("counters per call, misses per grid cell\n");
+    formatHeader(text, sizeof(text));
+    printf("%s\n", text);
+    for(int k=0; k<total.numStages; k++)
+    {
+        formatStage(text, sizeof(text), &total.stages[k]);
+        printf("%s\n", text);
+    }
+}
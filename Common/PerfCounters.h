@@ -0,0 +1,82 @@
+/** File:    PerfCounters.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __PERFCOUNTERS_H__
+#define __PERFCOUNTERS_H__
+
+#include <stdint.h>
+
+//hardware counters of the calling thread through perf_event_open, read as one
+//group so every counter covers the same instructions. counters the kernel or
+//the machine does not offer are left out, virtual machines often have none
+//of the hardware ones and only the task clock remains
+#define PERF_CYCLES 0
+#define PERF_INSTRUCTIONS 1
+#define PERF_L1D_MISSES 2       //L1 data cache read misses
+#define PERF_LLC_MISSES 3       //last level cache read misses
+#define PERF_DTLB_MISSES 4      //data TLB read misses
+#define PERF_BRANCH_MISSES 5
+#define PERF_TASK_CLOCK 6       //ns the thread ran, a software counter
+#define PERF_EVENTS 7
+
+class PerfCounters
+{
+public:
+    PerfCounters();
+    ~PerfCounters();
+
+    //returns the number of counters that could be opened, 0 if none
+    int open();
+    void close();
+    int has(int event){ return slot[event] >= 0; }
+    //why some hardware counters could not be opened, empty if all were
+    const char* getProblem(){ return problem; }
+
+    //current counts, scaled up if the kernel had to share the counters out;
+    //missing events read 0
+    void read(uint64_t values[PERF_EVENTS]);
+
+private:
+    int leader;
+    int numOpen;
+    int fds[PERF_EVENTS];
+    int slot[PERF_EVENTS];
+    char problem[128];
+};
+
+//counters around every traced stage (see Tracer.h) of the calling thread,
+//nested stages count toward the enclosing ones as well. totals go to stdout
+//at exit, a view of the last second feeds the overlay of the viewers
+#define STAGE_MAX 32
+#define STAGE_LINE 160
+
+//cells of the grid, for misses per cell; returns 0 if no counter at all is there
+int countersStart(int cells);
+int countersOn();
+//the cells of the grid the stages run on from now on, after it changed size
+void countersSetCells(int cells);
+//once per frame, starts a new overlay window every second
+void countersFrame();
+//line k of the overlay, NULL past the last one
+const char* countersLine(int k);
+void countersPrint();
+
+#endif
@@ -0,0 +1,455 @@
+/** File:    Recording.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Recording.h"
+#include <stdlib.h>
+#include <string.h>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+#include <zlib.h>
+
+#define RECORDING_MAX_FIELDS 16
+#define BYTE_ORDER_MARK 0x01020304u
+
+//float bits as unsigned integers in the same order as the floats, so close
+//floats map to close integers
+static uint32_t toOrdered(uint32_t bits)
+{
+    return (bits & 0x80000000u) ? ~bits : (bits | 0x80000000u);
+}
+
+static uint32_t fromOrdered(uint32_t ordered)
+{
+    return (ordered & 0x80000000u) ? (ordered & 0x7FFFFFFFu) : ~ordered;
+}
+
+//small differences of either sign become small unsigned values
+static uint32_t zigzag(uint32_t diff)
+{
+    return (diff<<1) ^ (uint32_t)((int32_t)diff>>31);
+}
+
+static uint32_t unzigzag(uint32_t value)
+{
+    return (value>>1) ^ (0u-(value&1));
+}
+
+//byte b of every value goes to plane b, so the zero high bytes of a small xor line up
+static void splitPlanes(const uint32_t *bits, unsigned char *planes, int count)
+{
+    for(int i=0; i<count; i++)
+    {
+        planes[i] = bits[i];
+        planes[count+i] = bits[i]>>8;
+        planes[2*count+i] = bits[i]>>16;
+        planes[3*count+i] = bits[i]>>24;
+    }
+}
+
+static void joinPlanes(const unsigned char *planes, uint32_t *bits, int count)
+{
+    for(int i=0; i<count; i++)
+    {
+        bits[i] = (uint32_t)planes[i] | (uint32_t)planes[count+i]<<8 |
+                  (uint32_t)planes[2*count+i]<<16 | (uint32_t)planes[3*count+i]<<24;
+    }
+}
+
+RecordingWriter::RecordingWriter()
+{
+    file = NULL;
+    pos = 0;
+    memset(&header, 0, sizeof(header));
+    fields = (RecordingField *)calloc(RECORDING_MAX_FIELDS, sizeof(RecordingField));
+    prev = (uint32_t **)calloc(RECORDING_MAX_FIELDS, sizeof(uint32_t *));
+    bits = NULL;
+    planes = NULL;
+    packed = NULL;
+    packedSize = 0;
+    index = NULL;
+    indexSize = 0;
+    rawBytes = 0;
+}
+
+RecordingWriter::~RecordingWriter()
+{
+    if(file) close();
+    for(int k=0; k<RECORDING_MAX_FIELDS; k++) free(prev[k]);
+    free(prev);
+    free(fields);
+    free(bits);
+    free(planes);
+    free(packed);
+    free(index);
+}
+
+int RecordingWriter::open(const char *path, const char *solver, int keyInterval, int mantissaBits)
+{
+    if(file) close();
+
+    file = fopen(path, "wb");
+    if(!file)
+    {
+        perror(path);
+        return 0;
+    }
+
+    memset(&header, 0, sizeof(header));
+    memcpy(header.magic, RECORDING_MAGIC, 8);
+    header.version = RECORDING_VERSION;
+    header.byteOrder = BYTE_ORDER_MARK;
+    strncpy(header.solver, solver, RECORDING_NAME-1);
+    header.keyInterval = keyInterval < 1 ? 1 : keyInterval;
+    header.mantissaBits = mantissaBits < 1 ? 1 : (mantissaBits > 23 ? 23 : mantissaBits);
+    pos = 0;
+    rawBytes = 0;
+    return 1;
+}
+
+void RecordingWriter::addField(const char *name, int width, int height)
+{
+    if(!file || header.numFrames > 0 || header.numFields == RECORDING_MAX_FIELDS) return;
+
+    RecordingField *field = &fields[header.numFields];
+    memset(field, 0, sizeof(RecordingField));
+    strncpy(field->name, name, RECORDING_NAME-1);
+    field->width = width;
+    field->height = height;
+
+    free(prev[header.numFields]);
+    prev[header.numFields] = (uint32_t *)calloc((size_t)width*height, sizeof(uint32_t));
+    header.numFields++;
+}
+
+int RecordingWriter::writeFrame(const float *const *data)
+{
+    if(!file) return 0;
+
+    if(header.numFrames == 0)
+    {
+        uint64_t maxCount = 0;
+        for(uint32_t k=0; k<header.numFields; k++)
+        {
+            uint64_t count = (uint64_t)fields[k].width*fields[k].height;
+            if(count > maxCount) maxCount = count;
+        }
+        free(bits);
+        free(planes);
+        free(packed);
+        bits = (uint32_t *)malloc(maxCount*sizeof(uint32_t));
+        planes = (unsigned char *)malloc(maxCount*sizeof(uint32_t));
+        packedSize = compressBound(maxCount*sizeof(uint32_t));
+        packed = (unsigned char *)malloc(packedSize);
+
+        //the header is rewritten by close() once the index is known
+        if(fwrite(&header, sizeof(header), 1, file) != 1 ||
+           fwrite(fields, sizeof(RecordingField), header.numFields, file) != header.numFields) return 0;
+        pos = sizeof(header)+header.numFields*sizeof(RecordingField);
+    }
+
+    int key = header.numFrames % header.keyInterval == 0;
+    int shift = 23-header.mantissaBits;
+
+    for(uint32_t k=0; k<header.numFields; k++)
+    {
+        int count = fields[k].width*fields[k].height;
+        uint32_t *last = prev[k];
+        uint32_t left = 0;
+        for(int i=0; i<count; i++)
+        {
+            uint32_t value;
+            memcpy(&value, &data[k][i], sizeof(uint32_t));
+            value = toOrdered(value)>>shift;
+            //key frames predict from the cell to the left, the others from the previous frame
+            bits[i] = zigzag(value-(key ? left : last[i]));
+            left = value;
+            last[i] = value;
+        }
+        splitPlanes(bits, planes, count);
+
+        uLongf bytes = packedSize;
+        uLong rawSize = (uLong)count*sizeof(uint32_t);
+        RecordingEntry entry;
+        entry.offset = pos;
+        entry.flags = key ? RECORDING_KEY : 0;
+        if(compress2(packed, &bytes, planes, rawSize, 1) == Z_OK && bytes < rawSize)
+        {
+            entry.flags |= RECORDING_DEFLATE;
+            entry.bytes = bytes;
+            if(fwrite(packed, 1, bytes, file) != bytes) return 0;
+        }
+        else
+        {
+            entry.bytes = rawSize;
+            if(fwrite(planes, 1, rawSize, file) != rawSize) return 0;
+        }
+        pos += entry.bytes;
+        rawBytes += rawSize;
+
+        uint64_t numEntries = (uint64_t)header.numFrames*header.numFields+k;
+        if(numEntries == indexSize)
+        {
+            indexSize = indexSize ? indexSize*2 : 1024;
+            index = (RecordingEntry *)realloc(index, indexSize*sizeof(RecordingEntry));
+        }
+        index[numEntries] = entry;
+    }
+
+    header.numFrames++;
+    return 1;
+}
+
+int RecordingWriter::close()
+{
+    if(!file) return 0;
+
+    int ok = 1;
+    if(header.numFrames == 0)
+    {
+        ok = fwrite(&header, sizeof(header), 1, file) == 1 &&
+             fwrite(fields, sizeof(RecordingField), header.numFields, file) == header.numFields;
+        pos = sizeof(header)+header.numFields*sizeof(RecordingField);
+    }
+
+    //the index is read in place, so it starts on an 8 byte boundary
+    uint64_t zero = 0;
+    uint64_t pad = (8-pos%8)%8;
+    ok = ok && fwrite(&zero, 1, pad, file) == pad;
+    pos += pad;
+
+    uint64_t numEntries = (uint64_t)header.numFrames*header.numFields;
+    header.indexOffset = pos;
+    ok = ok && fwrite(index, sizeof(RecordingEntry), numEntries, file) == numEntries;
+    ok = ok && fseek(file, 0, SEEK_SET) == 0;
+    ok = ok && fwrite(&header, sizeof(header), 1, file) == 1;
+    ok = (fclose(file) == 0) && ok;
+    file = NULL;
+
+    if(!ok) perror("recording");
+    else printf("recorded %u frames, %.1f MB for %.1f MB of fields\n", header.numFrames,
+                (pos+numEntries*sizeof(RecordingEntry))/1048576.0, rawBytes/1048576.0);
+
+    header.numFields = 0;
+    header.numFrames = 0;
+    return ok;
+}
+
+RecordingReader::RecordingReader()
+{
+    map = NULL;
+    mapSize = 0;
+    header = NULL;
+    fields = NULL;
+    index = NULL;
+    cur = (uint32_t **)calloc(RECORDING_MAX_FIELDS, sizeof(uint32_t *));
+    out = (float **)calloc(RECORDING_MAX_FIELDS, sizeof(float *));
+    curFrame = (int *)calloc(RECORDING_MAX_FIELDS, sizeof(int));
+    planes = NULL;
+    delta = NULL;
+}
+
+RecordingReader::~RecordingReader()
+{
+    close();
+    free(cur);
+    free(out);
+    free(curFrame);
+}
+
+int RecordingReader::open(const char *path, const char *solver)
+{
+    close();
+
+    int fd = ::open(path, O_RDONLY);
+    if(fd < 0)
+    {
+        perror(path);
+        return 0;
+    }
+
+    struct stat st;
+    if(fstat(fd, &st) != 0 || (uint64_t)st.st_size < sizeof(RecordingHeader))
+    {
+        fprintf(stderr, "%s: not a recording\n", path);
+        ::close(fd);
+        return 0;
+    }
+
+    void *ptr = mmap(NULL, st.st_size, PROT_READ, MAP_SHARED, fd, 0);
+    ::close(fd);
+    if(ptr == MAP_FAILED)
+    {
+        perror(path);
+        return 0;
+    }
+    map = (unsigned char *)ptr;
+    mapSize = st.st_size;
+    header = (RecordingHeader *)map;
+    fields = (RecordingField *)(map+sizeof(RecordingHeader));
+
+    const char *error = NULL;
+    if(memcmp(header->magic, RECORDING_MAGIC, 8) != 0) error = "not a recording";
+    else if(header->version != RECORDING_VERSION) error = "unsupported recording version";
+    else if(header->byteOrder != BYTE_ORDER_MARK) error = "recording written with another byte order";
+    else if(strncmp(header->solver, solver, RECORDING_NAME) != 0) error = "recording of another solver";
+    else if(header->numFields > RECORDING_MAX_FIELDS || header->keyInterval == 0) error = "corrupt recording";
+    else if(header->indexOffset == 0) error = "recording was not closed";
+    else if(header->indexOffset+(uint64_t)header->numFrames*header->numFields*sizeof(RecordingEntry) > mapSize) error = "truncated recording";
+
+    uint64_t maxCount = 0;
+    if(!error)
+    {
+        index = (RecordingEntry *)(map+header->indexOffset);
+        for(uint32_t k=0; k<header->numFields; k++)
+        {
+            uint64_t count = (uint64_t)fields[k].width*fields[k].height;
+            if(count > maxCount) maxCount = count;
+        }
+        for(uint64_t e=0; !error && e<(uint64_t)header->numFrames*header->numFields; e++)
+        {
+            if(index[e].offset+index[e].bytes > header->indexOffset) error = "corrupt recording index";
+        }
+    }
+
+    if(error)
+    {
+        fprintf(stderr, "%s: %s\n", path, error);
+        close();
+        return 0;
+    }
+
+    for(uint32_t k=0; k<header->numFields; k++)
+    {
+        cur[k] = (uint32_t *)malloc((size_t)fields[k].width*fields[k].height*sizeof(uint32_t));
+        out[k] = (float *)malloc((size_t)fields[k].width*fields[k].height*sizeof(float));
+        curFrame[k] = -1;
+    }
+    planes = (unsigned char *)malloc(maxCount*sizeof(uint32_t));
+    delta = (uint32_t *)malloc(maxCount*sizeof(uint32_t));
+    return 1;
+}
+
+void RecordingReader::close()
+{
+    if(map) munmap(map, mapSize);
+    for(int k=0; k<RECORDING_MAX_FIELDS; k++)
+    {
+        free(cur[k]);
+        free(out[k]);
+        cur[k] = NULL;
+        out[k] = NULL;
+    }
+    free(planes);
+    free(delta);
+    map = NULL;
+    mapSize = 0;
+    header = NULL;
+    fields = NULL;
+    index = NULL;
+    planes = NULL;
+    delta = NULL;
+}
+
+int RecordingReader::findField(const char *name, int width, int height)
+{
+    if(!header) return -1;
+
+    for(uint32_t k=0; k<header->numFields; k++)
+    {
+        if(strncmp(fields[k].name, name, RECORDING_NAME) != 0) continue;
+        if(fields[k].width != (uint32_t)width || fields[k].height != (uint32_t)height) return -1;
+        return k;
+    }
+    return -1;
+}
+
+int RecordingReader::decode(RecordingEntry *entry, uint32_t *dest, int count)
+{
+    const unsigned char *src = map+entry->offset;
+    uLongf bytes = (uLongf)count*sizeof(uint32_t);
+
+    if(entry->flags & RECORDING_DEFLATE)
+    {
+        if(uncompress(planes, &bytes, src, entry->bytes) != Z_OK || bytes != (uLongf)count*sizeof(uint32_t)) return 0;
+        src = planes;
+    }
+    else if(entry->bytes != bytes) return 0;
+
+    joinPlanes(src, dest, count);
+    return 1;
+}
+
+const float* RecordingReader::readFrame(int frame, int field)
+{
+    if(!header || frame < 0 || frame >= (int)header->numFrames || field < 0 || field >= (int)header->numFields) return NULL;
+    if(curFrame[field] == frame) return out[field];
+
+    int count = fields[field].width*fields[field].height;
+    int key = frame-frame%header->keyInterval;
+    int from = curFrame[field]+1;
+    uint32_t *value = cur[field];
+
+    //moving forward inside the chunk only applies the new deltas
+    if(curFrame[field] < key || curFrame[field] > frame)
+    {
+        curFrame[field] = -1;
+        if(!decode(&index[(uint64_t)key*header->numFields+field], value, count)) return NULL;
+
+        uint32_t left = 0;
+        for(int i=0; i<count; i++)
+        {
+            value[i] = left+unzigzag(value[i]);
+            left = value[i];
+        }
+        from = key+1;
+    }
+
+    for(int f=from; f<=frame; f++)
+    {
+        if(!decode(&index[(uint64_t)f*header->numFields+field], delta, count))
+        {
+            curFrame[field] = -1;
+            return NULL;
+        }
+        for(int i=0; i<count; i++) value[i] += unzigzag(delta[i]);
+    }
+
+    int shift = 23-header->mantissaBits;
+    for(int i=0; i<count; i++)
+    {
+        uint32_t bits = fromOrdered(value[i]<<shift);
+        memcpy(&out[field][i], &bits, sizeof(uint32_t));
+    }
+
+    curFrame[field] = frame;
+    return out[field];
+}
+
+int RecordingReader::readField(int frame, const char *name, float *dest, int width, int height)
+{
+    const float *data = readFrame(frame, findField(name, width, height));
+    if(!data) return 0;
+
+    memcpy(dest, data, sizeof(float)*width*height);
+    return 1;
+}
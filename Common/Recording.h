@@ -0,0 +1,143 @@
+/** File:    Recording.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __RECORDING_H__
+#define __RECORDING_H__
+
+#include <stdint.h>
+#include <stdio.h>
+
+//streaming recording of solver fields, native byte order
+//  header | field table | frame data ... | frame index
+//frames are grouped in chunks of keyInterval frames. floats keep mantissaBits
+//bits of mantissa (23 is lossless) and are stored as order preserving integers:
+//the first frame of a chunk as the difference to the cell on the left, the
+//others as the difference to the same cell in the previous frame. the small
+//differences are split into byte planes and deflated.
+//the index holds one entry per frame and field, so a reader seeks to any frame
+//by decoding at most keyInterval entries of the fields it asks for
+#define RECORDING_MAGIC "SFREC\r\n"
+#define RECORDING_VERSION 1
+#define RECORDING_NAME 16
+
+//entry flags
+#define RECORDING_KEY 1
+#define RECORDING_DEFLATE 2
+
+struct RecordingHeader
+{
+    char magic[8];
+    uint32_t version;
+    uint32_t byteOrder;
+    char solver[RECORDING_NAME];
+    uint32_t numFields;
+    uint32_t keyInterval;
+    uint32_t mantissaBits;
+    uint32_t numFrames;
+    uint64_t indexOffset;
+};
+
+struct RecordingField
+{
+    char name[RECORDING_NAME];
+    uint32_t width;
+    uint32_t height;
+};
+
+struct RecordingEntry
+{
+    uint64_t offset;
+    uint32_t bytes;
+    uint32_t flags;
+};
+
+class RecordingWriter
+{
+public:
+    RecordingWriter();
+    ~RecordingWriter();
+
+    //returns 1 on success, fields are added before the first frame
+    int open(const char *path, const char *solver, int keyInterval, int mantissaBits);
+    void addField(const char *name, int width, int height);
+    //one array per field, in the order they were added
+    int writeFrame(const float *const *data);
+    //appends the index, the file is unreadable until then
+    int close();
+
+    int getNumFrames(){ return header.numFrames; }
+
+private:
+    FILE *file;
+    uint64_t pos;
+    RecordingHeader header;
+    RecordingField *fields;
+
+    //previous frame per field, as ordered integers
+    uint32_t **prev;
+    uint32_t *bits;
+    unsigned char *planes;
+    unsigned char *packed;
+    uint64_t packedSize;
+
+    RecordingEntry *index;
+    uint64_t indexSize;
+    uint64_t rawBytes;
+};
+
+class RecordingReader
+{
+public:
+    RecordingReader();
+    ~RecordingReader();
+
+    //maps path and checks it was written by the named solver, returns 1 on success
+    int open(const char *path, const char *solver);
+    void close();
+
+    int getNumFrames(){ return header ? header->numFrames : 0; }
+    int getNumFields(){ return header ? header->numFields : 0; }
+    //field number, -1 when missing or of another size
+    int findField(const char *name, int width, int height);
+
+    //the field as of frame, valid until the next call for that field
+    const float* readFrame(int frame, int field);
+    int readField(int frame, const char *name, float *dest, int width, int height);
+
+private:
+    int decode(RecordingEntry *entry, uint32_t *dest, int count);
+
+private:
+    unsigned char *map;
+    uint64_t mapSize;
+    RecordingHeader *header;
+    RecordingField *fields;
+    RecordingEntry *index;
+
+    //last decoded frame per field, as ordered integers and as floats
+    uint32_t **cur;
+    float **out;
+    int *curFrame;
+    unsigned char *planes;
+    uint32_t *delta;
+};
+
+#endif
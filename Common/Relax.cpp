@@ -0,0 +1,126 @@
+/** File:    Relax.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Relax.h"
+#include <stdio.h>
+#include <string.h>
+
+static const char *schemeNames[RELAX_SCHEMES] = {"columns", "rows", "redblack"};
+
+const char* relaxSchemeName(int scheme)
+{
+    return scheme >= 0 && scheme < RELAX_SCHEMES ? schemeNames[scheme] : "unknown";
+}
+
+int relaxSchemeByName(const char *name)
+{
+    for(int scheme=0; scheme<RELAX_SCHEMES; scheme++)
+    {
+        if(strcmp(name, schemeNames[scheme]) == 0) return scheme;
+    }
+    return RELAX_SCHEMES;
+}
+
+int parseRelaxConfig(const char *text, RelaxConfig *config)
+{
+    char name[32];
+    config->threads = 1;
+    config->bandRows = 16;
+    if(sscanf(text, "%31[^,],%d,%d", name, &config->threads, &config->bandRows) < 1) return 0;
+    config->scheme = relaxSchemeByName(name);
+    return config->scheme < RELAX_SCHEMES && config->threads >= 1 && config->bandRows >= 1;
+}
+
+Relax::Relax()
+{
+    config.scheme = RELAX_COLUMNS;
+    config.threads = 1;
+    config.bandRows = 16;
+}
+
+void Relax::setConfig(RelaxConfig _config)
+{
+    if(_config.scheme < 0 || _config.scheme >= RELAX_SCHEMES) _config.scheme = RELAX_COLUMNS;
+    if(_config.threads < 1 || _config.scheme != RELAX_REDBLACK) _config.threads = 1;
+    if(_config.bandRows < 1) _config.bandRows = 1;
+    if(_config.threads != pool.getNumThreads()) pool.init(_config.threads);
+    config = _config;
+}
+
+//rows begin..end-1 counted from j0, the cells of curColor only
+void Relax::redBlackRows(void *arg, int begin, int end)
+{
+    Relax *relax = (Relax *)arg;
+    float *x = relax->curX;
+    const float *b = relax->curB;
+    int stride = relax->curStride;
+    float a = relax->curA;
+    float c = relax->curC;
+
+    for(int j=relax->curJ0+begin; j<relax->curJ0+end; j++)
+    {
+        int i = relax->curI0+((relax->curI0+j+relax->curColor)&1);
+        for(; i<=relax->curI1; i+=2)
+        {
+            int index = j*stride+i;
+            x[index] = (b[index]+a*(x[index-1]+x[index+1]+x[index-stride]+x[index+stride]))/c;
+        }
+    }
+}
+
+void Relax::sweep(float *x, const float *b, int stride, int i0, int i1, int j0, int j1, float a, float c)
+{
+    if(config.scheme == RELAX_COLUMNS)
+    {
+        for(int i=i0; i<=i1; i++)
+        {
+            for(int j=j0; j<=j1; j++)
+            {
+                int index = j*stride+i;
+                x[index] = (b[index]+a*(x[index-1]+x[index+1]+x[index-stride]+x[index+stride]))/c;
+            }
+        }
+    }
+    else if(config.scheme == RELAX_ROWS)
+    {
+        for(int j=j0; j<=j1; j++)
+        {
+            for(int i=i0; i<=i1; i++)
+            {
+                int index = j*stride+i;
+                x[index] = (b[index]+a*(x[index-1]+x[index+1]+x[index-stride]+x[index+stride]))/c;
+            }
+        }
+    }
+    else
+    {
+        curX = x;
+        curB = b;
+        curStride = stride;
+        curI0 = i0;
+        curI1 = i1;
+        curJ0 = j0;
+        curJ1 = j1;
+        curA = a;
+        curC = c;
+        for(curColor=0; curColor<2; curColor++) pool.run(redBlackRows, this, j1-j0+1, config.bandRows);
+    }
+}
@@ -0,0 +1,83 @@
+/** File:    Relax.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __RELAX_H__
+#define __RELAX_H__
+
+#include "ThreadPool.h"
+
+//the Gauss-Seidel relaxation every solver iterates for diffusion and pressure,
+//  x(i, j) = (b(i, j) + a*(x(i-1, j)+x(i+1, j)+x(i, j-1)+x(i, j+1)))/c
+//over the cells i0..i1 x j0..j1 of arrays with rows of stride floats.
+//the schemes converge alike; they differ in the order they walk memory and
+//in how much of a sweep can run in parallel
+#define RELAX_COLUMNS 0     //column by column, the order the solvers were written in
+#define RELAX_ROWS 1        //row by row, along memory
+#define RELAX_REDBLACK 2    //all red cells then all black ones, bands of rows in parallel
+#define RELAX_SCHEMES 3
+
+struct RelaxConfig
+{
+    int scheme;
+    //threads and rows per task, red-black only
+    int threads;
+    int bandRows;
+};
+
+const char* relaxSchemeName(int scheme);
+//RELAX_SCHEMES if name is none of them
+int relaxSchemeByName(const char *name);
+//"scheme[,threads[,bandRows]]", returns 0 if it is not one
+int parseRelaxConfig(const char *text, RelaxConfig *config);
+
+class Relax
+{
+public:
+    Relax();
+
+    //starts the threads the config asks for
+    void setConfig(RelaxConfig _config);
+    RelaxConfig getConfig(){ return config; }
+
+    //one sweep over all the cells
+    void sweep(float *x, const float *b, int stride, int i0, int i1, int j0, int j1, float a, float c);
+
+private:
+    static void redBlackRows(void *arg, int begin, int end);
+
+private:
+    RelaxConfig config;
+    ThreadPool pool;
+
+    //sweep in progress, for the pool tasks
+    float *curX;
+    const float *curB;
+    int curStride;
+    int curI0;
+    int curI1;
+    int curJ0;
+    int curJ1;
+    float curA;
+    float curC;
+    int curColor;
+};
+
+#endif
@@ -0,0 +1,93 @@
+/** File:    Resample.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Resample.h"
+#include <math.h>
+
+static float sampleBilinear(const float *src, FieldGrid grid, float x, float y)
+{
+    //x, y in samples of src
+    if(x < 0.0f) x = 0.0f;
+    if(x > grid.width-1.0f) x = grid.width-1.0f;
+    if(y < 0.0f) y = 0.0f;
+    if(y > grid.height-1.0f) y = grid.height-1.0f;
+
+    int i0 = (int)x;
+    int j0 = (int)y;
+    int i1 = i0+1 < grid.width ? i0+1 : i0;
+    int j1 = j0+1 < grid.height ? j0+1 : j0;
+    float wR = x-i0;
+    float wT = y-j0;
+
+    return (1.0f-wT)*((1.0f-wR)*src[j0*grid.width+i0]+wR*src[j0*grid.width+i1])+
+           wT*((1.0f-wR)*src[j1*grid.width+i0]+wR*src[j1*grid.width+i1]);
+}
+
+//first and one past the last src sample whose position lies in [lo, hi)
+static void footprint(float lo, float hi, float off, int count, int *begin, int *end)
+{
+    *begin = (int)ceilf(lo-off);
+    *end = (int)ceilf(hi-off);
+    if(*begin < 0) *begin = 0;
+    if(*end > count) *end = count;
+}
+
+void resampleField(float *dst, FieldGrid dstGrid, const float *src, FieldGrid srcGrid, int filter, float scale, float shift)
+{
+    //src cells per dst cell
+    float ratioX = (float)srcGrid.cellsX/dstGrid.cellsX;
+    float ratioY = (float)srcGrid.cellsY/dstGrid.cellsY;
+    int box = filter == RESAMPLE_CONSERVATIVE && ratioX > 1.0f && ratioY > 1.0f;
+
+    for(int j=0; j<dstGrid.height; j++)
+    {
+        float y = (j+dstGrid.offY)*ratioY;
+        for(int i=0; i<dstGrid.width; i++)
+        {
+            float x = (i+dstGrid.offX)*ratioX;
+            float value;
+
+            int i0 = 0;
+            int i1 = 0;
+            int j0 = 0;
+            int j1 = 0;
+            if(box)
+            {
+                footprint(x-0.5f*ratioX, x+0.5f*ratioX, srcGrid.offX, srcGrid.width, &i0, &i1);
+                footprint(y-0.5f*ratioY, y+0.5f*ratioY, srcGrid.offY, srcGrid.height, &j0, &j1);
+            }
+
+            //a sample at the edge may have nothing under it, it is interpolated instead
+            if(i0 < i1 && j0 < j1)
+            {
+                float sum = 0.0f;
+                for(int sj=j0; sj<j1; sj++)
+                {
+                    for(int si=i0; si<i1; si++) sum += src[sj*srcGrid.width+si];
+                }
+                value = sum/((i1-i0)*(j1-j0));
+            }
+            else value = sampleBilinear(src, srcGrid, x-srcGrid.offX, y-srcGrid.offY);
+
+            dst[j*dstGrid.width+i] = scale*value+shift;
+        }
+    }
+}
@@ -0,0 +1,46 @@
+/** File:    Resample.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __RESAMPLE_H__
+#define __RESAMPLE_H__
+
+//how the samples of a field sit in its domain: sample (i, j), at index j*width+i,
+//is at (i+offX, j+offY) cells from the corner of a domain cellsX x cellsY cells
+struct FieldGrid
+{
+    int width;
+    int height;
+    float offX;
+    float offY;
+    int cellsX;
+    int cellsY;
+};
+
+#define RESAMPLE_BILINEAR 0
+//the mean of the samples under each new one where the grid shrinks both ways, so
+//the field keeps its average; bilinear where it grows
+#define RESAMPLE_CONSERVATIVE 1
+
+//dst = scale*src+shift at every sample of dst, boundary ones included, which the
+//solver sets again after; src samples beyond its edges are clamped to them
+void resampleField(float *dst, FieldGrid dstGrid, const float *src, FieldGrid srcGrid, int filter, float scale, float shift);
+
+#endif
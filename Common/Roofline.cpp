@@ -0,0 +1,101 @@
+/** File:    Roofline.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Roofline.h"
+#include <stdlib.h>
+#include <chrono>
+
+//floats per triad array, 3 x 64 MB
+#define TRIAD_SIZE (16*1024*1024)
+//independent multiply-add chains, enough to hide the latency of the adds
+#define FLOP_CHAINS 64
+#define FLOP_ITERATIONS 2000000
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+static void triad(float *a, const float *b, const float *c, float s, int count)
+{
+    for(int i=0; i<count; i++) a[i] = b[i]+s*c[i];
+}
+
+//the chains stay bounded, x -> x*a+b converges to b/(1-a)
+static float flop_loop(float a, float b, int iterations)
+{
+    float x[FLOP_CHAINS];
+    for(int k=0; k<FLOP_CHAINS; k++) x[k] = k*0.001f;
+    for(int it=0; it<iterations; it++)
+    {
+        for(int k=0; k<FLOP_CHAINS; k++) x[k] = x[k]*a+b;
+    }
+    float sum = 0.0f;
+    for(int k=0; k<FLOP_CHAINS; k++) sum += x[k];
+    return sum;
+}
+
+void measurePeaks(RooflinePeaks *peaks, int trials)
+{
+    float *a = (float *)malloc(sizeof(float)*TRIAD_SIZE);
+    float *b = (float *)malloc(sizeof(float)*TRIAD_SIZE);
+    float *c = (float *)malloc(sizeof(float)*TRIAD_SIZE);
+    for(int i=0; i<TRIAD_SIZE; i++)
+    {
+        a[i] = 0.0f;
+        b[i] = 1.0f;
+        c[i] = 2.0f;
+    }
+
+    //STREAM counts 12 bytes per element; the write allocate of a is not counted
+    double best = 1e30;
+    for(int t=0; t<trials; t++)
+    {
+        double start = now();
+        triad(a, b, c, 0.5f+t, TRIAD_SIZE);
+        double time = now()-start;
+        if(time < best) best = time;
+    }
+    peaks->bandwidth = 12.0*TRIAD_SIZE/best/1e9;
+    free(a);
+    free(b);
+    free(c);
+
+    //a and b come from volatiles so the loop cannot be folded away
+    volatile float va = 0.999f;
+    volatile float vb = 0.001f;
+    volatile float sink = 0.0f;
+    best = 1e30;
+    for(int t=0; t<trials; t++)
+    {
+        double start = now();
+        sink = sink+flop_loop(va, vb, FLOP_ITERATIONS);
+        double time = now()-start;
+        if(time < best) best = time;
+    }
+    peaks->flops = 2.0*FLOP_CHAINS*FLOP_ITERATIONS/best/1e9;
+}
+
+double rooflineAttainable(const RooflinePeaks *peaks, double intensity)
+{
+    double memory = intensity*peaks->bandwidth;
+    return memory < peaks->flops ? memory : peaks->flops;
+}
@@ -0,0 +1,44 @@
+/** File:    Roofline.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __ROOFLINE_H__
+#define __ROOFLINE_H__
+
+//peak rates of one core, the roofs a kernel's performance is measured against:
+//a kernel doing F flops and moving B bytes per cell can reach at most
+//min(peakFlops, F/B*peakBandwidth). the bandwidth is the STREAM triad
+//a[i] = b[i]+s*c[i] over arrays far beyond the caches, the flop rate a
+//multiply-add loop on many independent registers; both are compiled with the
+//same flags as the kernels, so the roof is what this build can reach
+struct RooflinePeaks
+{
+    //GB/s and GFLOP/s
+    double bandwidth;
+    double flops;
+};
+
+//best of trials runs of each probe, takes about a second
+void measurePeaks(RooflinePeaks *peaks, int trials);
+
+//GFLOP/s a kernel of intensity flops per byte can reach
+double rooflineAttainable(const RooflinePeaks *peaks, double intensity);
+
+#endif
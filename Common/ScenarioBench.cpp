@@ -0,0 +1,347 @@
+/** File:    ScenarioBench.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ScenarioBench.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+#include <chrono>
+
+#define PI 3.14159265f
+
+static double now()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+//grid and time step of the run in progress, passed to the velocity functions
+struct ScenarioGrid
+{
+    int n;
+    float dt;
+    //cells per step for one unit of speed
+    float speed;
+};
+
+struct Scenario
+{
+    const char *name;
+    //fastest speed expected, sets the time step
+    float maxSpeed;
+    //box^2 per unit time
+    float visc;
+    float duration;
+    //initial velocity, NULL to start at rest
+    VelocityFunc init;
+    //velocity held on every step, NULL for none
+    VelocityFunc force;
+    int plume;
+    int taylorGreen;
+};
+
+static int taylor_green(void *arg, float x, float y, float *u, float *v)
+{
+    ScenarioGrid *grid = (ScenarioGrid *)arg;
+    float X = PI*x/grid->n;
+    float Y = PI*y/grid->n;
+    *u = sinf(X)*cosf(Y)*grid->speed;
+    *v = -cosf(X)*sinf(Y)*grid->speed;
+    return 1;
+}
+
+//Lamb-Oseen vortex of circulation gamma and core radius sigma, all in box units
+static void lamb_oseen(float x, float y, float cx, float cy, float gamma, float sigma, float *u, float *v)
+{
+    float dx = x-cx;
+    float dy = y-cy;
+    float r2 = dx*dx+dy*dy;
+    float s = r2 > 1e-12f ? (1.0f-expf(-r2/(sigma*sigma)))/r2 : 1.0f/(sigma*sigma);
+    *u -= gamma/(2.0f*PI)*dy*s;
+    *v += gamma/(2.0f*PI)*dx*s;
+}
+
+//peak speed of the pair is about 1 at core radius 0.05, it travels at about 0.5
+static int vortex_pair(void *arg, float x, float y, float *u, float *v)
+{
+    ScenarioGrid *grid = (ScenarioGrid *)arg;
+    float X = x/grid->n;
+    float Y = y/grid->n;
+    *u = 0.0f;
+    *v = 0.0f;
+    lamb_oseen(X, Y, 0.42f, 0.3f, 0.49f, 0.05f, u, v);
+    lamb_oseen(X, Y, 0.58f, 0.3f, -0.49f, 0.05f, u, v);
+    *u *= grid->speed;
+    *v *= grid->speed;
+    return 1;
+}
+
+//the top row of cells is dragged along at unit speed, the nearest the solvers
+//come to a moving wall
+static int lid(void *arg, float x, float y, float *u, float *v)
+{
+    ScenarioGrid *grid = (ScenarioGrid *)arg;
+    if(y <= grid->n-1.0f) return 0;
+    *u = grid->speed;
+    *v = 0.0f;
+    return 1;
+}
+
+static int in_inlet(int n, float x, float y)
+{
+    float X = x/n;
+    float Y = y/n;
+    return X >= 0.45f && X <= 0.55f && Y >= 0.05f && Y <= 0.1f;
+}
+
+static int inlet(void *arg, float x, float y, float *u, float *v)
+{
+    ScenarioGrid *grid = (ScenarioGrid *)arg;
+    if(!in_inlet(grid->n, x, y)) return 0;
+    *u = 0.0f;
+    *v = grid->speed;
+    return 1;
+}
+
+static const Scenario scenarios[] =
+{
+    {"plume", 1.0f, 0.0f, 1.0f, NULL, inlet, 1, 0},
+    {"vortexpair", 1.0f, 0.0f, 0.5f, vortex_pair, NULL, 0, 0},
+    {"taylorgreen", 1.0f, 0.01f, 1.0f, taylor_green, NULL, 0, 1},
+    {"lidbox", 1.0f, 0.01f, 2.0f, NULL, lid, 0, 0},
+};
+#define NUM_SCENARIOS (int)(sizeof(scenarios)/sizeof(scenarios[0]))
+
+//kinetic energy per unit area in box units
+static double kinetic_energy(ScenarioSolver *solver, ScenarioGrid *grid)
+{
+    double sum = 0.0;
+    for(int j=0; j<grid->n; j++)
+    {
+        for(int i=0; i<grid->n; i++)
+        {
+            float u;
+            float v;
+            solver->getVelocity(i, j, &u, &v);
+            sum += (double)u*u+(double)v*v;
+        }
+    }
+    return 0.5*sum/((double)grid->n*grid->n*grid->speed*grid->speed);
+}
+
+//prints value in a column of width, or a dash where it does not apply
+static void print_column(double value, const char *format, int width)
+{
+    char text[32];
+    if(isnan(value)) snprintf(text, sizeof(text), "-");
+    else snprintf(text, sizeof(text), format, value);
+    printf(" %*s", width, text);
+}
+
+ScenarioBench::ScenarioBench()
+{
+    numSizes = 0;
+    for(int size=64; size<=256; size*=2) sizes[numSizes++] = size;
+    cfl = 1.0f;
+    filter = NULL;
+    jsonPath = NULL;
+    hasRelax = 0;
+}
+
+int ScenarioBench::parseArgs(int argc, char **argv)
+{
+    int ok = argc%2 == 1;
+    for(int arg=1; ok && arg<argc; arg+=2)
+    {
+        if(strcmp(argv[arg], "-sizes") == 0)
+        {
+            numSizes = 0;
+            for(char *item=strtok(argv[arg+1], ","); item && numSizes<SCENARIO_MAX_SIZES; item=strtok(NULL, ","))
+            {
+                if(atoi(item) >= 16) sizes[numSizes++] = atoi(item);
+            }
+        }
+        else if(strcmp(argv[arg], "-cfl") == 0) cfl = (float)atof(argv[arg+1]);
+        else if(strcmp(argv[arg], "-scenario") == 0) filter = argv[arg+1];
+        else if(strcmp(argv[arg], "-json") == 0) jsonPath = argv[arg+1];
+        else if(strcmp(argv[arg], "-relax") == 0) ok = hasRelax = parseRelaxConfig(argv[arg+1], &relax);
+        else ok = 0;
+    }
+
+    if(!ok || numSizes == 0 || cfl <= 0.0f)
+    {
+        fprintf(stderr, "usage: %s [-sizes 64,128,...] [-cfl cells] [-scenario name] [-json path] [-relax scheme,threads,rows]\n", argv[0]);
+        return 0;
+    }
+    return 1;
+}
+
+int ScenarioBench::begin(const char *solver)
+{
+    printf("%s scenarios, cfl %.2f", solver, cfl);
+    if(hasRelax) printf(", %s relaxation on %d thread%s, %d rows per band", relaxSchemeName(relax.scheme), relax.threads,
+                        relax.threads > 1 ? "s" : "", relax.bandRows);
+    printf("\n");
+    printf("%-12s %9s %6s %9s %9s %10s %9s %9s %9s\n", "scenario", "size", "steps", "ms/step", "Mcell/s",
+           "div rms", "energy", "L2 err", "mass");
+    fflush(stdout);
+
+    //the solvers step on this thread alone unless the relaxation brings its own
+    if(jsonPath) return report.open(jsonPath, "scenario", solver, hasRelax ? relax.threads : 1, -1);
+    return 1;
+}
+
+int ScenarioBench::end()
+{
+    if(!report.isOpen()) return 1;
+    int ok = report.close();
+    if(!ok) fprintf(stderr, "%s: write failed\n", jsonPath);
+    return ok;
+}
+
+void ScenarioBench::run(ScenarioSolver *solver)
+{
+    for(int s=0; s<NUM_SCENARIOS; s++)
+    {
+        const Scenario *scenario = &scenarios[s];
+        if(filter && !strstr(scenario->name, filter)) continue;
+
+        for(int k=0; k<numSizes; k++)
+        {
+            ScenarioGrid grid;
+            grid.n = sizes[k];
+            grid.dt = cfl/(scenario->maxSpeed*grid.n);
+            grid.speed = grid.dt*grid.n;
+            int n = grid.n;
+            int steps = (int)ceilf(scenario->duration/grid.dt-1e-3f);
+
+            solver->reset(n, scenario->visc*grid.dt*n*n);
+            if(hasRelax) solver->setRelax(relax);
+            if(scenario->init) solver->setVelocity(scenario->init, &grid);
+
+            //energy is measured against the field after the first projection,
+            //the sampled initial field is not divergence free on the solver's grid
+            double seconds = 0.0;
+            double batches[SCENARIO_BATCHES] = {0.0};
+            int batchSteps[SCENARIO_BATCHES] = {0};
+            double energyRef = 0.0;
+            double injected = 0.0;
+            for(int step=0; step<steps; step++)
+            {
+                if(scenario->force) solver->setVelocity(scenario->force, &grid);
+                if(scenario->plume)
+                {
+                    for(int j=0; j<n; j++)
+                    {
+                        for(int i=0; i<n; i++)
+                        {
+                            if(!in_inlet(n, i+0.5f, j+0.5f)) continue;
+                            solver->addDensity(i, j, grid.dt);
+                            injected += grid.dt;
+                        }
+                    }
+                }
+
+                double start = now();
+                solver->step();
+                double time = now()-start;
+                seconds += time;
+                batches[step*SCENARIO_BATCHES/steps] += time;
+                batchSteps[step*SCENARIO_BATCHES/steps]++;
+
+                if(step == 0) energyRef = kinetic_energy(solver, &grid);
+            }
+
+            double divergence = 0.0;
+            double mass = 0.0;
+            for(int j=0; j<n; j++)
+            {
+                for(int i=0; i<n; i++)
+                {
+                    double div = solver->getDivergence(i, j)/grid.dt;
+                    divergence += div*div;
+                    mass += solver->getDensity(i, j);
+                }
+            }
+            divergence = sqrt(divergence/((double)n*n));
+
+            //the vortex pair is inviscid and should keep its energy, the Taylor-Green
+            //vortex decays as exp(-2 visc pi^2 t) in velocity
+            double energy = NAN;
+            double l2 = NAN;
+            double time = steps*grid.dt;
+            if(scenario->init)
+            {
+                double decay = exp(-4.0*scenario->visc*PI*PI*(time-grid.dt));
+                energy = kinetic_energy(solver, &grid)/(energyRef*decay)-1.0;
+            }
+            if(scenario->taylorGreen)
+            {
+                double amplitude = exp(-2.0*scenario->visc*PI*PI*time);
+                double error = 0.0;
+                double norm = 0.0;
+                for(int j=0; j<n; j++)
+                {
+                    for(int i=0; i<n; i++)
+                    {
+                        float u;
+                        float v;
+                        float exactU;
+                        float exactV;
+                        solver->getVelocity(i, j, &u, &v);
+                        taylor_green(&grid, i+0.5f, j+0.5f, &exactU, &exactV);
+                        exactU *= amplitude;
+                        exactV *= amplitude;
+                        error += (u-exactU)*(u-exactU)+(v-exactV)*(v-exactV);
+                        norm += exactU*exactU+exactV*exactV;
+                    }
+                }
+                l2 = sqrt(error/norm);
+            }
+
+            char sizeText[32];
+            snprintf(sizeText, sizeof(sizeText), "%dx%d", n, n);
+            printf("%-12s %9s %6d %9.3f %9.2f %10.3e", scenario->name, sizeText, steps, seconds/steps*1e3,
+                   (double)n*n*steps/seconds/1e6, divergence);
+            print_column(energy*100.0, "%+.2f%%", 9);
+            print_column(l2*100.0, "%.2f%%", 9);
+            double massError = scenario->plume ? mass/injected-1.0 : NAN;
+            print_column(massError*100.0, "%+.2f%%", 9);
+            printf("\n");
+            fflush(stdout);
+
+            //ms per step of each batch, all batches cover the same steps on every run
+            int numBatches = 0;
+            double samples[SCENARIO_BATCHES];
+            for(int b=0; b<SCENARIO_BATCHES; b++)
+            {
+                if(batchSteps[b] > 0) samples[numBatches++] = batches[b]/batchSteps[b]*1e3;
+            }
+            BenchResult result;
+            initBenchResult(&result, "scenario", scenario->name, n, "ms/step", samples, numBatches);
+            result.divergence = divergence;
+            result.energy = energy;
+            result.l2 = l2;
+            result.mass = massError;
+            report.add(&result);
+        }
+    }
+}
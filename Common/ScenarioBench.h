@@ -0,0 +1,96 @@
+/** File:    ScenarioBench.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SCENARIOBENCH_H__
+#define __SCENARIOBENCH_H__
+
+//canonical headless runs that weigh a solver's speed against its accuracy
+//  plume        density and upward inflow from a patch at the bottom
+//  vortexpair   two counter-rotating Lamb-Oseen vortices propelling each other up
+//  taylorgreen  decaying Taylor-Green vortex, exact in a box with slip walls
+//  lidbox       lid-driven cavity at Re 100
+//every scenario lives in the unit box; the time step is picked so the fastest
+//expected speed covers cfl cells per step, so runs at different sizes cover the
+//same physical time. each run reports its throughput, the rms divergence left
+//after the step, the kinetic energy against the exact decay, the L2 error of
+//the velocity where the solution is analytic and the density lost or gained
+//where density is injected
+#include "BenchReport.h"
+#include "Relax.h"
+
+//x and y in cells from the bottom left corner of the box, u and v in cells
+//per step; returns 0 to leave the sample at (x, y) alone
+typedef int (*VelocityFunc)(void *arg, float x, float y, float *u, float *v);
+
+//a solver as the scenarios see it: n x n fluid cells of unit width inside walls,
+//cell (0, 0) at the bottom left, velocities in cells per step
+struct ScenarioSolver
+{
+    //fresh fluid at rest, velocity diffusing at visc cells^2 per step
+    void (*reset)(int n, float visc);
+    //relaxation of the diffusion and pressure solves
+    void (*setRelax)(RelaxConfig config);
+    //overwrites the velocity at every sample of the solver's own grid func accepts
+    void (*setVelocity)(VelocityFunc func, void *arg);
+    //density added on the next step
+    void (*addDensity)(int i, int j, float value);
+    //one step the way the viewer takes it
+    void (*step)();
+
+    //velocity at the center of cell (i, j), divergence in the solver's own stencil, density
+    void (*getVelocity)(int i, int j, float *u, float *v);
+    float (*getDivergence)(int i, int j);
+    float (*getDensity)(int i, int j);
+};
+
+#define SCENARIO_MAX_SIZES 16
+//the steps of a run are timed in this many batches, the samples of its report
+#define SCENARIO_BATCHES 8
+
+class ScenarioBench
+{
+public:
+    ScenarioBench();
+
+    //  -sizes 64,128,...  -cfl cells  -scenario name (only scenarios whose name contains name)
+    //  -json path         also writes the results as a BenchReport
+    //  -relax scheme[,threads[,bandRows]]  relaxation the solver is set to, see Relax.h
+    //returns 0 and prints the usage on a bad argument
+    int parseArgs(int argc, char **argv);
+    //prints the table header and opens the report, returns 1 on success
+    int begin(const char *solver);
+    //closes the report, returns 1 if it was written
+    int end();
+    //every scenario at every size, one row each
+    void run(ScenarioSolver *solver);
+
+private:
+    int sizes[SCENARIO_MAX_SIZES];
+    int numSizes;
+    float cfl;
+    const char *filter;
+    const char *jsonPath;
+    BenchReport report;
+    RelaxConfig relax;
+    int hasRelax;
+};
+
+#endif
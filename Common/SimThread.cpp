@@ -0,0 +1,227 @@
+/** File:    SimThread.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "SimThread.h"
+#include "Tracer.h"
+#include <chrono>
+#include <stdlib.h>
+#include <string.h>
+
+#define HANDOFF_FRESH 4
+
+static double getSeconds()
+{
+    return std::chrono::duration<double>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+InputQueue::InputQueue()
+{
+    head = 0;
+    tail = 0;
+}
+
+int InputQueue::push(const InputEvent *event)
+{
+    uint32_t t = tail.load(std::memory_order_relaxed);
+    if(t-head.load(std::memory_order_acquire) == INPUTQUEUE_SIZE) return 0;
+
+    events[t&(INPUTQUEUE_SIZE-1)] = *event;
+    tail.store(t+1, std::memory_order_release);
+    return 1;
+}
+
+int InputQueue::pop(InputEvent *event)
+{
+    uint32_t h = head.load(std::memory_order_relaxed);
+    if(h == tail.load(std::memory_order_acquire)) return 0;
+
+    *event = events[h&(INPUTQUEUE_SIZE-1)];
+    head.store(h+1, std::memory_order_release);
+    return 1;
+}
+
+FrameHandoff::FrameHandoff()
+{
+    memset(frames, 0, sizeof(frames));
+    back = 0;
+    middle = 1;
+    front = 2;
+}
+
+FrameHandoff::~FrameHandoff()
+{
+    for(int k=0; k<3; k++) free(frames[k].fields);
+}
+
+void FrameHandoff::init(int numFloats)
+{
+    for(int k=0; k<3; k++)
+    {
+        free(frames[k].fields);
+        memset(&frames[k], 0, sizeof(SimFrame));
+        frames[k].fields = (float *)calloc(numFloats, sizeof(float));
+    }
+    back = 0;
+    middle = 1;
+    front = 2;
+}
+
+void FrameHandoff::publish()
+{
+    back = middle.exchange(back|HANDOFF_FRESH, std::memory_order_acq_rel)&3;
+}
+
+const SimFrame* FrameHandoff::acquire()
+{
+    if(!(middle.load(std::memory_order_relaxed)&HANDOFF_FRESH)) return NULL;
+
+    front = middle.exchange(front, std::memory_order_acq_rel)&3;
+    return &frames[front];
+}
+
+SimThread::SimThread()
+{
+    running = 0;
+    apply = NULL;
+    step = NULL;
+    publish = NULL;
+    arg = NULL;
+    period = 0.0;
+    pauseRequest = 0;
+    paused = 0;
+    quit = 0;
+}
+
+SimThread::~SimThread()
+{
+    stop();
+}
+
+int SimThread::start(ApplyInput _apply, SimStep _step, SimPublish _publish, void *_arg, int numFloats, double _period)
+{
+    stop();
+
+    apply = _apply;
+    step = _step;
+    publish = _publish;
+    arg = _arg;
+    period = _period;
+    handoff.init(numFloats);
+
+    pauseRequest = 0;
+    paused = 0;
+    quit = 0;
+    running = 1;
+    thread = std::thread(threadMain, this);
+    return 1;
+}
+
+void SimThread::stop()
+{
+    if(!running) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = 1;
+    }
+    changed.notify_all();
+    thread.join();
+    running = 0;
+}
+
+void SimThread::pause()
+{
+    if(!running) return;
+
+    std::unique_lock<std::mutex> lock(mutex);
+    pauseRequest = 1;
+    changed.notify_all();
+    while(!paused) changed.wait(lock);
+}
+
+void SimThread::resume()
+{
+    if(!running) return;
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        pauseRequest = 0;
+    }
+    changed.notify_all();
+}
+
+void SimThread::threadMain(SimThread *sim)
+{
+    traceThreadName("simulation");
+    sim->loop();
+}
+
+void SimThread::loop()
+{
+    uint64_t numSteps = 0;
+    uint32_t batch = 0;
+    double consumeTime = 0.0;
+    std::chrono::steady_clock::time_point next = std::chrono::steady_clock::now();
+
+    while(1)
+    {
+        if(pauseRequest.load(std::memory_order_acquire))
+        {
+            std::unique_lock<std::mutex> lock(mutex);
+            paused = 1;
+            changed.notify_all();
+            while(pauseRequest && !quit) changed.wait(lock);
+            paused = 0;
+            if(quit) return;
+        }
+
+        InputEvent event;
+        while(queue.pop(&event))
+        {
+            apply(arg, &event);
+            if(event.type == INPUT_SOURCE)
+            {
+                batch = event.time;
+                consumeTime = getSeconds();
+            }
+        }
+
+        step(arg);
+        numSteps++;
+
+        SimFrame *frame = handoff.getBack();
+        publish(arg, frame->fields);
+        frame->step = numSteps;
+        frame->batch = batch;
+        frame->consumeTime = consumeTime;
+        frame->stepTime = getSeconds();
+        handoff.publish();
+
+        //a step that ran late starts the next period from now rather than catching up
+        std::chrono::steady_clock::time_point now = std::chrono::steady_clock::now();
+        next += std::chrono::duration_cast<std::chrono::steady_clock::duration>(std::chrono::duration<double>(period));
+        if(next < now) next = now;
+
+        std::unique_lock<std::mutex> lock(mutex);
+        changed.wait_until(lock, next, [this]{ return quit || pauseRequest.load(); });
+        if(quit) return;
+    }
+}
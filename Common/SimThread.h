@@ -0,0 +1,138 @@
+/** File:    SimThread.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SIMTHREAD_H__
+#define __SIMTHREAD_H__
+
+#include "InputLog.h"
+#include <stdint.h>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//input events from the GLUT callbacks to the simulation thread, one pushes
+//and the other pops, neither ever waits for the other
+#define INPUTQUEUE_SIZE 4096    //power of two
+
+class InputQueue
+{
+public:
+    InputQueue();
+
+    //returns 0 and drops the event if the queue is full
+    int push(const InputEvent *event);
+    //returns 0 if the queue is empty
+    int pop(InputEvent *event);
+
+private:
+    InputEvent events[INPUTQUEUE_SIZE];
+    std::atomic<uint32_t> head;     //next to pop, moved by the consumer
+    std::atomic<uint32_t> tail;     //next to push, moved by the producer
+};
+
+//a simulated frame handed to the renderer
+struct SimFrame
+{
+    uint64_t step;
+    //last INPUT_SOURCE applied before the step, the time field it carried
+    uint32_t batch;
+    double consumeTime;     //when it was applied, steady clock seconds
+    double stepTime;        //when the step was done
+    float *fields;
+};
+
+//triple buffer from the simulation to the renderer: the writer fills the back
+//frame and trades it for the middle one, the reader trades its front frame for
+//the middle one when that is newer. both sides only ever swap an index
+class FrameHandoff
+{
+public:
+    FrameHandoff();
+    ~FrameHandoff();
+    void init(int numFloats);
+
+    SimFrame* getBack(){ return &frames[back]; }
+    void publish();
+
+    //the newest frame if one came in since the last call, NULL otherwise
+    const SimFrame* acquire();
+
+private:
+    SimFrame frames[3];
+    int back;
+    int front;
+    //index of the middle frame, FRESH while the reader has not taken it
+    std::atomic<int> middle;
+};
+
+typedef void (*SimStep)(void *arg);
+typedef void (*SimPublish)(void *arg, float *fields);
+
+//steps a solver on a thread of its own, at most once per period, so the
+//renderer never waits on a step and the steps never wait on vsync. input is
+//applied between steps, and after every step publish copies the fields the
+//viewer draws into the next frame
+class SimThread
+{
+public:
+    SimThread();
+    ~SimThread();
+
+    //numFloats of fields per frame, returns 1 on success
+    int start(ApplyInput apply, SimStep step, SimPublish publish, void *arg, int numFloats, double period);
+    void stop();
+    int isRunning(){ return running; }
+
+    //GLUT thread side; send returns 0 if the event had to be dropped
+    int send(const InputEvent *event){ return queue.push(event); }
+    const SimFrame* acquire(){ return handoff.acquire(); }
+
+    //hold the thread between two steps so the caller may use the solver itself,
+    //both do nothing while the thread is not running
+    void pause();
+    void resume();
+
+private:
+    static void threadMain(SimThread *sim);
+    void loop();
+
+private:
+    int running;
+    ApplyInput apply;
+    SimStep step;
+    SimPublish publish;
+    void *arg;
+    double period;
+
+    InputQueue queue;
+    FrameHandoff handoff;
+    std::thread thread;
+
+    //pause and stop only, the steps themselves take no lock
+    std::mutex mutex;
+    std::condition_variable changed;
+    std::atomic<int> pauseRequest;
+    int paused;
+    int quit;
+};
+
+#endif
@@ -0,0 +1,157 @@
+/** File:    Snapshotter.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Snapshotter.h"
+#include <stdio.h>
+#include <stdlib.h>
+#include <string.h>
+#include <unistd.h>
+#include <sys/wait.h>
+#include <chrono>
+
+static double nowMs()
+{
+    return std::chrono::duration<double, std::milli>(std::chrono::steady_clock::now().time_since_epoch()).count();
+}
+
+Snapshotter::Snapshotter()
+{
+    mode = SNAPSHOT_FORK;
+    busy = 0;
+    path[0] = 0;
+    startTime = 0.0;
+    lastStall = 0.0;
+    lastDuration = 0.0;
+    child = -1;
+    writer = NULL;
+    buffer = NULL;
+    bufferBytes = 0;
+    written = 0;
+    writeResult = 0;
+}
+
+Snapshotter::~Snapshotter()
+{
+    wait();
+    free(buffer);
+}
+
+int Snapshotter::begin(FillCheckpoint fill, void *arg, const char *_path)
+{
+    poll();
+    if(busy) return 0;
+
+    strncpy(path, _path, sizeof(path)-1);
+    path[sizeof(path)-1] = 0;
+    startTime = nowMs();
+
+    if(mode == SNAPSHOT_FORK)
+    {
+        fflush(NULL);
+        child = fork();
+        if(child == 0)
+        {
+            //the child sees the fields as they were at fork() and never returns
+            CheckpointWriter childWriter;
+            fill(arg, &childWriter);
+            _exit(childWriter.write(path) ? 0 : 1);
+        }
+        if(child > 0)
+        {
+            busy = 1;
+            lastStall = nowMs()-startTime;
+            return 1;
+        }
+        perror("fork");
+    }
+
+    writer = new CheckpointWriter();
+    fill(arg, writer);
+
+    uint64_t bytes = writer->getFieldBytes();
+    if(bytes > bufferBytes)
+    {
+        free(buffer);
+        buffer = (float *)malloc(bytes);
+        bufferBytes = bytes;
+    }
+    writer->copyFields(buffer);
+
+    written = 0;
+    busy = 1;
+    writerThread = std::thread(writerMain, this);
+    lastStall = nowMs()-startTime;
+    return 1;
+}
+
+void Snapshotter::writerMain(Snapshotter *snapshotter)
+{
+    snapshotter->writeResult = snapshotter->writer->write(snapshotter->path);
+    snapshotter->written = 1;
+}
+
+void Snapshotter::finish(int ok)
+{
+    busy = 0;
+    lastDuration = nowMs()-startTime;
+    if(ok) printf("snapshot %s written in %.1f ms, simulation stalled %.3f ms\n", path, lastDuration, lastStall);
+    else fprintf(stderr, "snapshot %s failed\n", path);
+}
+
+int Snapshotter::poll()
+{
+    if(!busy) return 0;
+
+    if(child > 0)
+    {
+        int status;
+        if(waitpid(child, &status, WNOHANG) != child) return 0;
+        child = -1;
+        finish(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        return 1;
+    }
+
+    if(!written) return 0;
+    writerThread.join();
+    delete writer;
+    writer = NULL;
+    finish(writeResult);
+    return 1;
+}
+
+void Snapshotter::wait()
+{
+    if(!busy) return;
+
+    if(child > 0)
+    {
+        int status;
+        waitpid(child, &status, 0);
+        child = -1;
+        finish(WIFEXITED(status) && WEXITSTATUS(status) == 0);
+        return;
+    }
+
+    writerThread.join();
+    delete writer;
+    writer = NULL;
+    finish(writeResult);
+}
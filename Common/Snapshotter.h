@@ -0,0 +1,84 @@
+/** File:    Snapshotter.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __SNAPSHOTTER_H__
+#define __SNAPSHOTTER_H__
+
+#include "Checkpoint.h"
+#include <sys/types.h>
+#include <thread>
+#include <atomic>
+
+//writes checkpoints while the simulation keeps stepping
+//  SNAPSHOT_FORK: a forked child writes its copy-on-write view of the fields,
+//                 the caller only pays for fork() duplicating the page tables
+//  SNAPSHOT_COPY: the fields are copied into a staging buffer that a writer
+//                 thread saves, the caller pays for the memcpy
+//fork mode falls back to copy mode when fork() fails
+#define SNAPSHOT_FORK 0
+#define SNAPSHOT_COPY 1
+
+typedef void (*FillCheckpoint)(void *arg, CheckpointWriter *writer);
+
+class Snapshotter
+{
+public:
+    Snapshotter();
+    ~Snapshotter();
+    void setMode(int _mode){ mode = _mode; }
+    int getMode(){ return mode; }
+
+    //starts a snapshot of what fill adds to a writer, 0 while the previous one is unfinished
+    int begin(FillCheckpoint fill, void *arg, const char *_path);
+    //reaps a finished snapshot, returns 1 when one completed since the last call
+    int poll();
+    void wait();
+    int isBusy(){ return busy; }
+
+    //milliseconds the caller was blocked in begin(), and from begin() to completion
+    double getLastStall(){ return lastStall; }
+    double getLastDuration(){ return lastDuration; }
+
+private:
+    static void writerMain(Snapshotter *snapshotter);
+    void finish(int ok);
+
+private:
+    int mode;
+    int busy;
+    char path[1024];
+    double startTime;
+    double lastStall;
+    double lastDuration;
+
+    //fork mode
+    pid_t child;
+
+    //copy mode
+    CheckpointWriter *writer;
+    float *buffer;
+    uint64_t bufferBytes;
+    std::thread writerThread;
+    std::atomic<int> written;
+    int writeResult;
+};
+
+#endif
@@ -0,0 +1,91 @@
+/** File:    StepClock.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "StepClock.h"
+#include <thread>
+
+typedef std::chrono::steady_clock Clock;
+
+StepClock::StepClock()
+{
+    on = 0;
+    maxSteps = 1;
+    period = 1.0;
+    accumulator = 0.0;
+    framePeriod = 0.0;
+}
+
+void StepClock::start(double rate, int _maxSteps)
+{
+    on = rate > 0.0;
+    period = on ? 1.0/rate : 1.0;
+    maxSteps = _maxSteps > 0 ? _maxSteps : 1;
+    accumulator = 0.0;
+    last = Clock::now();
+}
+
+void StepClock::setFrameRate(double fps)
+{
+    framePeriod = fps > 0.0 ? 1.0/fps : 0.0;
+    nextFrame = Clock::now();
+}
+
+int StepClock::advance()
+{
+    if(!on) return 1;
+
+    Clock::time_point now = Clock::now();
+    accumulator += std::chrono::duration<double>(now-last).count();
+    last = now;
+
+    int steps = (int)(accumulator/period);
+    if(steps > maxSteps)
+    {
+        steps = maxSteps;
+        accumulator = 0.0;
+    }
+    else accumulator -= steps*period;
+    return steps;
+}
+
+float StepClock::getAlpha()
+{
+    if(!on) return 1.0f;
+
+    float alpha = (float)(accumulator/period);
+    return alpha < 1.0f ? alpha : 1.0f;
+}
+
+void StepClock::waitFrame()
+{
+    if(framePeriod <= 0.0) return;
+
+    //a frame that came late sets the pace from now rather than rushing to catch up
+    Clock::time_point now = Clock::now();
+    if(nextFrame > now) std::this_thread::sleep_until(nextFrame);
+    else nextFrame = now;
+    nextFrame += std::chrono::duration_cast<Clock::duration>(std::chrono::duration<double>(framePeriod));
+}
+
+void blendFields(float *out, const float *from, const float *to, float alpha, int count)
+{
+    for(int i=0; i<count; i++) out[i] = from[i]+alpha*(to[i]-from[i]);
+}
@@ -0,0 +1,63 @@
+/** File:    StepClock.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __STEPCLOCK_H__
+#define __STEPCLOCK_H__
+
+#include <chrono>
+
+//fixed timestep scheduling: real time accumulates and is paid out in whole
+//solver steps, so the simulation runs at the same speed however fast frames
+//are drawn. what is left over, less than a step, says how far to blend from
+//the state before the last step toward the state after it
+class StepClock
+{
+public:
+    StepClock();
+
+    //rate steps a second; a frame pays out at most maxSteps and forgets the
+    //rest of the time, so a slow machine runs slower instead of falling behind
+    void start(double rate, int maxSteps);
+    int isOn(){ return on; }
+    //fps frames a second at most, 0 for no cap
+    void setFrameRate(double fps);
+
+    //steps due since the last call
+    int advance();
+    //0..1, how far real time is past the last step paid out
+    float getAlpha();
+    //sleeps until the next frame is due instead of spinning
+    void waitFrame();
+
+private:
+    int on;
+    int maxSteps;
+    double period;
+    double accumulator;
+    std::chrono::steady_clock::time_point last;
+    double framePeriod;
+    std::chrono::steady_clock::time_point nextFrame;
+};
+
+//out = from+alpha*(to-from) over count floats
+void blendFields(float *out, const float *from, const float *to, float alpha, int count);
+
+#endif
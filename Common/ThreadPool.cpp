@@ -0,0 +1,122 @@
+/** File:    ThreadPool.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "ThreadPool.h"
+#include "Tracer.h"
+
+ThreadPool::ThreadPool()
+{
+    numThreads = 1;
+    generation = 0;
+    busy = 0;
+    quit = 0;
+    curTask = NULL;
+    curArg = NULL;
+    curCount = 0;
+    curGrain = 1;
+    next = 0;
+}
+
+ThreadPool::~ThreadPool()
+{
+    stopWorkers();
+}
+
+void ThreadPool::init(int _numThreads)
+{
+    stopWorkers();
+
+    numThreads = _numThreads;
+    if(numThreads <= 0) numThreads = (int)std::thread::hardware_concurrency();
+    if(numThreads <= 0) numThreads = 1;
+
+    quit = 0;
+    for(int i=1; i<numThreads; i++) workers.push_back(std::thread(workerMain, this, generation));
+}
+
+void ThreadPool::stopWorkers()
+{
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        quit = 1;
+    }
+    wake.notify_all();
+
+    for(size_t i=0; i<workers.size(); i++) workers[i].join();
+    workers.clear();
+}
+
+void ThreadPool::run(Task task, void *arg, int count, int grain)
+{
+    if(grain < 1) grain = 1;
+    if(workers.empty() || count <= grain)
+    {
+        if(count > 0) task(arg, 0, count);
+        return;
+    }
+
+    {
+        std::lock_guard<std::mutex> lock(mutex);
+        curTask = task;
+        curArg = arg;
+        curCount = count;
+        curGrain = grain;
+        next = 0;
+        busy = (int)workers.size();
+        generation++;
+    }
+    wake.notify_all();
+
+    work();
+
+    std::unique_lock<std::mutex> lock(mutex);
+    while(busy > 0) finished.wait(lock);
+}
+
+void ThreadPool::work()
+{
+    TraceScope scope("pool work");
+    int begin;
+    while((begin = next.fetch_add(curGrain)) < curCount)
+    {
+        int end = begin+curGrain < curCount ? begin+curGrain : curCount;
+        curTask(curArg, begin, end);
+    }
+}
+
+void ThreadPool::workerMain(ThreadPool *pool, int seen)
+{
+    std::unique_lock<std::mutex> lock(pool->mutex);
+
+    while(1)
+    {
+        while(pool->generation == seen && !pool->quit) pool->wake.wait(lock);
+        if(pool->quit) return;
+        seen = pool->generation;
+
+        lock.unlock();
+        traceThreadName("pool worker");
+        pool->work();
+        lock.lock();
+
+        if(--pool->busy == 0) pool->finished.notify_one();
+    }
+}
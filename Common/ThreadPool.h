@@ -0,0 +1,70 @@
+/** File:    ThreadPool.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __THREADPOOL_H__
+#define __THREADPOOL_H__
+
+#include <vector>
+#include <thread>
+#include <mutex>
+#include <condition_variable>
+#include <atomic>
+
+//fixed set of worker threads that split index ranges between them
+//run() is not reentrant, one pool serves one caller at a time
+class ThreadPool
+{
+public:
+    typedef void (*Task)(void *arg, int begin, int end);
+
+    ThreadPool();
+    ~ThreadPool();
+    //0 picks one thread per hardware thread, the caller counts as one of them
+    void init(int _numThreads);
+    int getNumThreads(){ return numThreads; }
+
+    //calls task on chunks of grain indices out of [0, count) and returns when all are done
+    void run(Task task, void *arg, int count, int grain);
+
+private:
+    static void workerMain(ThreadPool *pool, int seen);
+    void work();
+    void stopWorkers();
+
+private:
+    int numThreads;
+    std::vector<std::thread> workers;
+    std::mutex mutex;
+    std::condition_variable wake;
+    std::condition_variable finished;
+    int generation;
+    int busy;
+    int quit;
+
+    //current job
+    Task curTask;
+    void *curArg;
+    int curCount;
+    int curGrain;
+    std::atomic<int> next;
+};
+
+#endif
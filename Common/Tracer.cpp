@@ -0,0 +1,292 @@
+/** File:    Tracer.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "Tracer.h"
+#include <atomic>
+#include <errno.h>
+#include <stdio.h>
+#include <stdlib.h>
+#include <stdint.h>
+#include <string.h>
+#include <signal.h>
+#include <fcntl.h>
+#include <time.h>
+#include <unistd.h>
+#include <sys/syscall.h>
+
+struct TraceRecord
+{
+    const char *name;
+    uint64_t time;
+    char phase;
+};
+
+//ring of one thread; only its thread writes it, a flush reads every ring
+//up to the published head and drops what was overwritten meanwhile
+struct TraceRing
+{
+    TraceRecord *records;
+    std::atomic<uint64_t> head;
+    const char *threadName;
+    int tid;
+    TraceRing *next;
+};
+
+int traceOn = 0;
+
+static int traceRecording = 0;
+static TraceHook traceHook = NULL;
+static thread_local int traceHookThread = 0;
+static char tracePath[1024];
+static int traceCapacity;
+static std::atomic<TraceRing *> traceRings(NULL);
+static std::atomic<int> traceBusy(0);
+static thread_local TraceRing *traceRing = NULL;
+
+static uint64_t traceNow()
+{
+    timespec ts;
+    clock_gettime(CLOCK_MONOTONIC, &ts);
+    return (uint64_t)ts.tv_sec*1000000000ull+(uint64_t)ts.tv_nsec;
+}
+
+static TraceRing* getRing()
+{
+    if(traceRing) return traceRing;
+
+    TraceRecord *records = (TraceRecord *)malloc(sizeof(TraceRecord)*traceCapacity);
+    if(!records) return NULL;
+
+    TraceRing *ring = new TraceRing;
+    ring->records = records;
+    ring->head.store(0);
+    ring->threadName = NULL;
+    ring->tid = (int)syscall(SYS_gettid);
+
+    //rings are never freed, the events of threads that ended stay in the trace
+    ring->next = traceRings.load();
+    while(!traceRings.compare_exchange_weak(ring->next, ring));
+    traceRing = ring;
+    return ring;
+}
+
+void traceEvent(const char *name, char phase)
+{
+    if(traceHookThread) traceHook(name, phase);
+    if(!traceRecording) return;
+
+    TraceRing *ring = getRing();
+    if(!ring) return;
+
+    uint64_t head = ring->head.load(std::memory_order_relaxed);
+    TraceRecord *record = &ring->records[head%traceCapacity];
+    record->name = name;
+    record->time = traceNow();
+    record->phase = phase;
+    ring->head.store(head+1, std::memory_order_release);
+}
+
+void traceSetHook(TraceHook hook)
+{
+    traceHook = hook;
+    traceHookThread = hook != NULL;
+    traceOn = traceRecording || traceHookThread;
+}
+
+void traceThreadName(const char *name)
+{
+    if(!traceRecording) return;
+    TraceRing *ring = getRing();
+    if(ring) ring->threadName = name;
+}
+
+//the writer below runs inside signal handlers, so it formats by hand
+//and only calls open, write and close
+struct TraceOutput
+{
+    int fd;
+    int length;
+    int failed;
+    char buffer[4096];
+};
+
+static void flushOutput(TraceOutput *out)
+{
+    int done = 0;
+    while(done < out->length)
+    {
+        ssize_t n = write(out->fd, out->buffer+done, out->length-done);
+        if(n <= 0)
+        {
+            out->failed = 1;
+            break;
+        }
+        done += (int)n;
+    }
+    out->length = 0;
+}
+
+static void putText(TraceOutput *out, const char *text)
+{
+    for(; *text; text++)
+    {
+        if(out->length == (int)sizeof(out->buffer)) flushOutput(out);
+        out->buffer[out->length++] = *text;
+    }
+}
+
+static void putNumber(TraceOutput *out, uint64_t value, int minDigits)
+{
+    char digits[24];
+    int n = 0;
+    do
+    {
+        digits[n++] = (char)('0'+value%10);
+        value /= 10;
+    } while(value > 0 || n < minDigits);
+
+    char text[24];
+    for(int i=0; i<n; i++) text[i] = digits[n-1-i];
+    text[n] = 0;
+    putText(out, text);
+}
+
+static void putEventHead(TraceOutput *out, const char *name, const char *phase, int pid, int tid, int *first)
+{
+    putText(out, *first ? "\n" : ",\n");
+    *first = 0;
+    putText(out, "{\"name\":\"");
+    putText(out, name);
+    putText(out, "\",\"ph\":\"");
+    putText(out, phase);
+    putText(out, "\",\"pid\":");
+    putNumber(out, (uint64_t)pid, 1);
+    putText(out, ",\"tid\":");
+    putNumber(out, (uint64_t)tid, 1);
+}
+
+static void writeRing(TraceOutput *out, TraceRing *ring, int pid, int *first)
+{
+    if(ring->threadName)
+    {
+        putEventHead(out, "thread_name", "M", pid, ring->tid, first);
+        putText(out, ",\"args\":{\"name\":\"");
+        putText(out, ring->threadName);
+        putText(out, "\"}}");
+    }
+
+    uint64_t head = ring->head.load(std::memory_order_acquire);
+    uint64_t begin = head > (uint64_t)traceCapacity ? head-traceCapacity : 0;
+    for(uint64_t k=begin; k<head; k++)
+    {
+        TraceRecord record = ring->records[k%traceCapacity];
+        //the thread may have wrapped around onto this record while it was copied;
+        //at head-k == traceCapacity it is writing this slot for index head and has
+        //not published head+1 yet. the fence keeps the copy ahead of the check
+        std::atomic_thread_fence(std::memory_order_acquire);
+        if(ring->head.load(std::memory_order_relaxed)-k >= (uint64_t)traceCapacity) continue;
+
+        char phase[2] = {record.phase, 0};
+        putEventHead(out, record.name, phase, pid, ring->tid, first);
+        putText(out, ",\"ts\":");
+        putNumber(out, record.time/1000, 1);
+        putText(out, ".");
+        putNumber(out, record.time%1000, 3);
+        putText(out, "}");
+    }
+}
+
+int traceFlush()
+{
+    if(!traceRecording) return 0;
+    //a signal that arrives during a flush leaves the file to the flush under way
+    if(traceBusy.exchange(1)) return 0;
+
+    TraceOutput out;
+    out.fd = open(tracePath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    out.length = 0;
+    out.failed = out.fd < 0;
+    if(!out.failed)
+    {
+        int pid = (int)getpid();
+        int first = 1;
+        putText(&out, "{\"displayTimeUnit\":\"ms\",\"traceEvents\":[");
+        for(TraceRing *ring=traceRings.load(); ring; ring=ring->next) writeRing(&out, ring, pid, &first);
+        putText(&out, "\n]}\n");
+        flushOutput(&out);
+        if(close(out.fd) != 0) out.failed = 1;
+    }
+
+    traceBusy.store(0);
+    return !out.failed;
+}
+
+static void flushAtExit()
+{
+    if(traceRecording && !traceFlush()) perror("traceFlush");
+}
+
+static void flushOnSignal(int sig)
+{
+    int saved = errno;
+    traceFlush();
+    errno = saved;
+
+    //SIGUSR1 only takes a snapshot, the others go on to end the process
+    if(sig == SIGUSR1) return;
+    signal(sig, SIG_DFL);
+    raise(sig);
+}
+
+int traceStart(const char *path, int eventsPerThread)
+{
+    if(traceRecording) return 1;
+    if(strlen(path) >= sizeof(tracePath) || eventsPerThread <= 0)
+    {
+        printf("traceStart: bad path or size\n");
+        return 0;
+    }
+    strcpy(tracePath, path);
+    traceCapacity = eventsPerThread;
+
+    //checks the path now rather than when the trace is due
+    int fd = open(tracePath, O_WRONLY|O_CREAT|O_TRUNC, 0644);
+    if(fd < 0)
+    {
+        perror(path);
+        return 0;
+    }
+    close(fd);
+
+    traceRecording = 1;
+    traceOn = 1;
+    traceThreadName("main");
+    atexit(flushAtExit);
+
+    struct sigaction action;
+    memset(&action, 0, sizeof(action));
+    action.sa_handler = flushOnSignal;
+    sigemptyset(&action.sa_mask);
+    sigaction(SIGUSR1, &action, NULL);
+    sigaction(SIGINT, &action, NULL);
+    sigaction(SIGTERM, &action, NULL);
+    return 1;
+}
@@ -0,0 +1,64 @@
+/** File:    Tracer.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __TRACER_H__
+#define __TRACER_H__
+
+//timeline of frames and solver stages in the Chrome trace event format, for
+//chrome://tracing or ui.perfetto.dev. every thread appends begin and end
+//events to a ring of its own, so recording takes no lock; the rings are
+//written out as one JSON file at exit, on SIGINT or SIGTERM, and whenever
+//the process gets SIGUSR1, which leaves it running
+#define TRACE_EVENTS (1<<18)    //events kept per thread, older ones are overwritten
+
+//while neither tracing nor a hook is on a scope costs one test of this flag
+extern int traceOn;
+
+//installs the signal handlers and the exit hook, returns 1 on success
+int traceStart(const char *path, int eventsPerThread = TRACE_EVENTS);
+//writes everything recorded so far to the path given to traceStart, returns 1 on success
+int traceFlush();
+
+//hook called with every event of the thread that sets it, e.g. to read counters
+//around each stage; NULL removes it
+typedef void (*TraceHook)(const char *name, char phase);
+void traceSetHook(TraceHook hook);
+
+//name of the calling thread in the timeline, names must outlive the process
+void traceThreadName(const char *name);
+
+//names must be string literals, only their addresses are recorded
+void traceEvent(const char *name, char phase);
+inline void traceBegin(const char *name){ if(traceOn) traceEvent(name, 'B'); }
+inline void traceEnd(const char *name){ if(traceOn) traceEvent(name, 'E'); }
+
+//one slice from construction to the end of the enclosing block
+class TraceScope
+{
+public:
+    TraceScope(const char *_name){ name = _name; traceBegin(name); }
+    ~TraceScope(){ traceEnd(name); }
+
+private:
+    const char *name;
+};
+
+#endif
@@ -0,0 +1,359 @@
+#include <util.h>
+#include <png.h>
+#include <string>
+#include <string.h>
+#include <stdio.h>
+#include <list>
+#include <mutex>
+#include <fcntl.h>
+#include <unistd.h>
+#include <sys/mman.h>
+#include <sys/stat.h>
+
+namespace {
+
+struct PngCacheEntry
+{
+    std::string    key;
+    time_t         mtime_sec;
+    long           mtime_nsec;
+    off_t          file_size;
+    unsigned char* pixel_data;
+    size_t         width;
+    size_t         height;
+    size_t         size_buf;
+};
+
+std::mutex               png_cache_mutex;
+std::list<PngCacheEntry> png_cache; // most recently used first
+size_t                   png_cache_bytes    = 0;
+size_t                   png_cache_capacity = 256 * 1024 * 1024;
+
+void png_cache_evict(size_t capacity)
+{
+    while(png_cache_bytes > capacity && !png_cache.empty()) {
+        png_cache_bytes -= png_cache.back().size_buf;
+        delete[] png_cache.back().pixel_data;
+        png_cache.pop_back();
+    }
+}
+
+// the whole file is mapped, libpng reads from it through this
+struct PngMemoryReader
+{
+    const unsigned char* data;
+    size_t               size;
+    size_t               offset;
+};
+
+void png_read_memory(png_structp png_ptr, png_bytep out, png_size_t length)
+{
+    PngMemoryReader* reader = static_cast<PngMemoryReader*>(png_get_io_ptr(png_ptr));
+    if(reader->offset + length > reader->size) {
+        png_error(png_ptr, "read past end of file");
+    }
+    memcpy(out, reader->data + reader->offset, length);
+    reader->offset += length;
+}
+
+bool decode_png(const unsigned char* data,
+                size_t               size,
+                bool                 internal_format_rgba,
+                unsigned char**      pixel_data,
+                size_t*              width,
+                size_t*              height,
+                size_t*              size_buf)
+{
+    // test if png
+    if(size < 8 || png_sig_cmp(const_cast<png_bytep>(data), 0, 8)) {
+        return false;
+    }
+
+    // create png struct
+    png_structp png_ptr = png_create_read_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(!png_ptr) {
+        return false;
+    }
+
+    // create png info struct
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr) {
+        png_destroy_read_struct(&png_ptr, (png_infopp) NULL, (png_infopp) NULL);
+        return false;
+    }
+
+    // declared before setjmp so the error path sees their values
+    png_byte* volatile  image_data   = NULL;
+    png_bytep* volatile row_pointers = NULL;
+
+    // libpng longjmps here on errors, including truncated files
+    if(setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+        delete[] image_data;
+        delete[] row_pointers;
+        return false;
+    }
+
+    PngMemoryReader reader = {data, size, 8};
+    png_set_read_fn(png_ptr, &reader, png_read_memory);
+
+    // let libpng know you already read the first 8 bytes
+    png_set_sig_bytes(png_ptr, 8);
+
+    // read all the info up to the image data
+    png_read_info(png_ptr, info_ptr);
+
+    // variables to pass to get info
+    int bit_depth, color_type;
+    png_uint_32 twidth, theight;
+
+    // get info about png
+    png_get_IHDR(png_ptr, info_ptr, &twidth, &theight, &bit_depth, &color_type, NULL, NULL, NULL);
+
+    // let libpng produce 8 bit RGBA whatever the file holds
+    if(internal_format_rgba) {
+        if(color_type == PNG_COLOR_TYPE_PALETTE) {
+            png_set_palette_to_rgb(png_ptr);
+        }
+        if(color_type == PNG_COLOR_TYPE_GRAY && bit_depth < 8) {
+            png_set_expand_gray_1_2_4_to_8(png_ptr);
+        }
+        if(png_get_valid(png_ptr, info_ptr, PNG_INFO_tRNS)) {
+            png_set_tRNS_to_alpha(png_ptr);
+        }
+        if(bit_depth == 16) {
+            png_set_strip_16(png_ptr);
+        }
+        if(color_type == PNG_COLOR_TYPE_GRAY || color_type == PNG_COLOR_TYPE_GRAY_ALPHA) {
+            png_set_gray_to_rgb(png_ptr);
+        }
+        png_set_add_alpha(png_ptr, 0xFF, PNG_FILLER_AFTER);
+    }
+    png_set_interlace_handling(png_ptr);
+
+    // update the png info struct.
+    png_read_update_info(png_ptr, info_ptr);
+
+    // row size in bytes.
+    size_t rowbytes = png_get_rowbytes(png_ptr, info_ptr);
+
+    // allocate the image_data as a big block, to be given to opengl
+    image_data   = new png_byte[rowbytes * theight];
+    row_pointers = new png_bytep[theight];
+
+    // set the individual row_pointers to point at the correct offsets of image_data
+    for(int i = 0; i < static_cast<int>(theight); i++) {
+        row_pointers[theight - 1 - i] = image_data + i * rowbytes;
+    }
+
+    // read the png into image_data through row_pointers
+    png_read_image(png_ptr, row_pointers);
+
+    delete[] row_pointers;
+
+    // clean up memory and close stuff
+    png_destroy_read_struct(&png_ptr, &info_ptr, (png_infopp) NULL);
+
+    *pixel_data = image_data;
+    *width      = twidth;
+    *height     = theight;
+    *size_buf   = rowbytes * theight;
+
+    return true;
+}
+
+bool load_png(std::string png_filename,
+              bool        internal_format_rgba,
+              void**      pixel_data,
+              size_t*     width,
+              size_t*     height)
+{
+    if(!pixel_data || !width || !height) {
+        return false;
+    }
+
+    int fd = open(png_filename.c_str(), O_RDONLY);
+    if(fd < 0) {
+        return false;
+    }
+    struct stat st;
+    if(fstat(fd, &st) || st.st_size <= 0) {
+        close(fd);
+        return false;
+    }
+
+    std::string key = png_filename + (internal_format_rgba ? "#rgba" : "#raw");
+
+    // serve from the cache while the file is unchanged
+    {
+        std::lock_guard<std::mutex> lock(png_cache_mutex);
+        for(std::list<PngCacheEntry>::iterator it = png_cache.begin(); it != png_cache.end(); it++) {
+            if(it->key != key) {
+                continue;
+            }
+            if(it->mtime_sec == st.st_mtim.tv_sec && it->mtime_nsec == st.st_mtim.tv_nsec && it->file_size == st.st_size) {
+                png_cache.splice(png_cache.begin(), png_cache, it);
+                unsigned char* copy = new unsigned char[it->size_buf];
+                memcpy(copy, it->pixel_data, it->size_buf);
+                *pixel_data = copy;
+                *width      = it->width;
+                *height     = it->height;
+                close(fd);
+                return true;
+            }
+            png_cache_bytes -= it->size_buf;
+            delete[] it->pixel_data;
+            png_cache.erase(it);
+            break;
+        }
+    }
+
+    void* data = mmap(NULL, st.st_size, PROT_READ, MAP_PRIVATE, fd, 0);
+    close(fd);
+    if(data == MAP_FAILED) {
+        return false;
+    }
+    madvise(data, st.st_size, MADV_SEQUENTIAL);
+
+    unsigned char* image_data = NULL;
+    size_t size_buf = 0;
+    bool ok = decode_png(static_cast<const unsigned char*>(data), st.st_size, internal_format_rgba,
+                         &image_data, width, height, &size_buf);
+    munmap(data, st.st_size);
+    if(!ok) {
+        return false;
+    }
+    *pixel_data = image_data;
+
+    // keep a private copy, the caller owns and may free the returned one
+    std::lock_guard<std::mutex> lock(png_cache_mutex);
+    if(size_buf <= png_cache_capacity) {
+        PngCacheEntry entry;
+        entry.key        = key;
+        entry.mtime_sec  = st.st_mtim.tv_sec;
+        entry.mtime_nsec = st.st_mtim.tv_nsec;
+        entry.file_size  = st.st_size;
+        entry.pixel_data = new unsigned char[size_buf];
+        entry.width      = *width;
+        entry.height     = *height;
+        entry.size_buf   = size_buf;
+        memcpy(entry.pixel_data, image_data, size_buf);
+        png_cache.push_front(entry);
+        png_cache_bytes += size_buf;
+        png_cache_evict(png_cache_capacity);
+    }
+
+    return true;
+}
+
+}
+
+bool read_png(std::string png_filename,
+              void**      pixel_data,
+              size_t*     width,
+              size_t*     height,
+              bool        internal_format_rgba)
+{
+    return load_png(png_filename, internal_format_rgba, pixel_data, width, height);
+}
+
+bool read_png(std::string png_filename,
+              void**      pixel_data,
+              size_t*     width,
+              size_t*     height)
+{
+    return load_png(png_filename, false, pixel_data, width, height);
+}
+
+void png_cache_set_capacity(size_t capacity)
+{
+    std::lock_guard<std::mutex> lock(png_cache_mutex);
+    png_cache_capacity = capacity;
+    png_cache_evict(png_cache_capacity);
+}
+
+void png_cache_clear()
+{
+    std::lock_guard<std::mutex> lock(png_cache_mutex);
+    png_cache_evict(0);
+}
+
+bool write_png(std::string png_filename,
+               const void* pixel_data,
+               size_t      width,
+               size_t      height,
+               bool        internal_format_rgba,
+               int         compression_level)
+{
+    if(!pixel_data || !width || !height) {
+        return false;
+    }
+
+    // open file as binary
+    FILE* fp = fopen(png_filename.c_str(), "wb");
+    if(!fp) {
+        return false;
+    }
+
+    // create png struct
+    png_structp png_ptr = png_create_write_struct(PNG_LIBPNG_VER_STRING, NULL, NULL, NULL);
+    if(!png_ptr) {
+        fclose(fp);
+        return false;
+    }
+
+    // create png info struct
+    png_infop info_ptr = png_create_info_struct(png_ptr);
+    if(!info_ptr) {
+        png_destroy_write_struct(&png_ptr, (png_infopp) NULL);
+        fclose(fp);
+        return false;
+    }
+
+    // declared before setjmp so the error path sees its value
+    png_bytep* volatile row_pointers = NULL;
+
+    // libpng longjmps here on errors, e.g. a full disk
+    if(setjmp(png_jmpbuf(png_ptr))) {
+        png_destroy_write_struct(&png_ptr, &info_ptr);
+        delete[] row_pointers;
+        fclose(fp);
+        return false;
+    }
+
+    png_init_io(png_ptr, fp);
+
+    // low levels favour speed, the sub filter keeps most of the ratio for smooth images
+    png_set_compression_level(png_ptr, compression_level);
+    if(compression_level <= 3) {
+        png_set_filter(png_ptr, PNG_FILTER_TYPE_BASE, PNG_FILTER_SUB);
+    }
+
+    png_set_IHDR(png_ptr, info_ptr, width, height, 8,
+                 internal_format_rgba ? PNG_COLOR_TYPE_RGBA : PNG_COLOR_TYPE_RGB,
+                 PNG_INTERLACE_NONE, PNG_COMPRESSION_TYPE_DEFAULT, PNG_FILTER_TYPE_DEFAULT);
+    png_write_info(png_ptr, info_ptr);
+
+    // files store the top row first
+    size_t rowbytes = width * (internal_format_rgba ? 4 : 3);
+    row_pointers = new png_bytep[height];
+    for(int i = 0; i < static_cast<int>(height); i++) {
+        row_pointers[height - 1 - i] = const_cast<png_bytep>(static_cast<const png_byte*>(pixel_data)) + i * rowbytes;
+    }
+
+    png_write_image(png_ptr, row_pointers);
+    png_write_end(png_ptr, NULL);
+
+    delete[] row_pointers;
+    png_destroy_write_struct(&png_ptr, &info_ptr);
+
+    return fclose(fp) == 0;
+}
+
+bool write_png(std::string png_filename,
+               const void* pixel_data,
+               size_t      width,
+               size_t      height)
+{
+    return write_png(png_filename, pixel_data, width, height, true, 6);
+}
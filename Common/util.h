@@ -0,0 +1,34 @@
+#ifndef UTIL_H_
+#define UTIL_H_
+
+#include <string>
+
+// pixel data is allocated with new[] and owned by the caller, rows bottom to top
+bool read_png(std::string png_filename,
+              void**      pixel_data,
+              size_t*     width,
+              size_t*     height,
+              bool        internal_format_rgba);
+bool read_png(std::string png_filename,
+              void**      pixel_data,
+              size_t*     width,
+              size_t*     height);
+
+// rows bottom to top like read_png, 8 bit RGBA or RGB, compression level 0-9
+bool write_png(std::string png_filename,
+               const void* pixel_data,
+               size_t      width,
+               size_t      height,
+               bool        internal_format_rgba,
+               int         compression_level);
+bool write_png(std::string png_filename,
+               const void* pixel_data,
+               size_t      width,
+               size_t      height);
+
+// decoded images are cached by path and modification time, least recently used
+// images are dropped once the cache holds more than capacity bytes
+void png_cache_set_capacity(size_t capacity);
+void png_cache_clear();
+
+#endif
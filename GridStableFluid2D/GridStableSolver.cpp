@@ -20,6 +20,12 @@
  */
 
 #include "GridStableSolver.h"
+#include "ColorMap.h"
+#include "Checkpoint.h"
+#include "AutoTune.h"
+#include "Tracer.h"
+#include "Resample.h"
+#include "Courant.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
@@ -33,31 +39,39 @@ StableSolver::StableSolver()
 
 StableSolver::~StableSolver()
 {
-    free(vx);
-    free(vy);
-    free(vx0);
-    free(vy0);
-    free(d);
-    free(d0);
-    free(px);
-    free(py);
-    free(div);
-    free(p);
+    release();
+}
 
-    //vorticity confinement
-    free(vort);
-    free(absVort);
-    free(gradVortX);
-    free(gradVortY);
-    free(lenGrad);
-    free(vcfx);
-    free(vcfy);
+void StableSolver::init(int _rowSize, int _colSize)
+{
+    running = 1;
+    visc = 0.0f;
+    diff = 0.0f;
+    vorticity = 0.0f;
+    timeStep = 1.0f;
+    iterations = 20;
+    vortOn = 1;
+
+    //pipelined stepping
+    pipelined = 0;
+
+    //multi-rate stepping
+    velInterval = 1;
+    velBlend = 1;
+    velPhase = 0;
+
+    //adaptive stepping
+    adaptCFL = 0.0f;
+    adaptInterval = 1.0f;
+    velMax = 0.0f;
+
+    allocate(_rowSize, _colSize);
 }
 
-void StableSolver::init()
+void StableSolver::allocate(int _rowSize, int _colSize)
 {
-    rowSize = 128;
-    colSize = 128;
+    rowSize = _rowSize;
+    colSize = _colSize;
     totSize = rowSize*colSize;
     h = 1.0f;
     simSizeX = (float)rowSize;
@@ -67,12 +81,6 @@ void StableSolver::init()
     minY = 1.0f;
     maxY = colSize-1.0f;
 
-    running = 1;
-    visc = 0.0f;
-    diff = 0.0f;
-    vorticity = 0.0f;
-    timeStep = 1.0f;
-
     vx = (float *)malloc(sizeof(float)*totSize);
     vy = (float *)malloc(sizeof(float)*totSize);
     vx0 = (float *)malloc(sizeof(float)*totSize);
@@ -93,6 +101,16 @@ void StableSolver::init()
     vcfx = (float *)malloc(sizeof(float)*totSize);
     vcfy = (float *)malloc(sizeof(float)*totSize);
 
+    //pipelined stepping
+    pipeVX = (float *)malloc(sizeof(float)*totSize);
+    pipeVY = (float *)malloc(sizeof(float)*totSize);
+
+    //multi-rate stepping
+    multiVX0 = (float *)malloc(sizeof(float)*totSize);
+    multiVY0 = (float *)malloc(sizeof(float)*totSize);
+    multiVX = (float *)malloc(sizeof(float)*totSize);
+    multiVY = (float *)malloc(sizeof(float)*totSize);
+
     for(int i=0; i<rowSize; i++)
     {
         for(int j=0; j<colSize; j++)
@@ -101,6 +119,87 @@ void StableSolver::init()
             py[cIdx(i, j)] = (float)j+0.5f;
         }
     }
+
+    //changes below half a color level wait until they add up
+    dirty.init(rowSize, colSize, 16, 0.5f/255.0f);
+}
+
+void StableSolver::release()
+{
+    free(vx);
+    free(vy);
+    free(vx0);
+    free(vy0);
+    free(d);
+    free(d0);
+    free(px);
+    free(py);
+    free(div);
+    free(p);
+
+    //vorticity confinement
+    free(vort);
+    free(absVort);
+    free(gradVortX);
+    free(gradVortY);
+    free(lenGrad);
+    free(vcfx);
+    free(vcfy);
+
+    free(pipeVX);
+    free(pipeVY);
+
+    free(multiVX0);
+    free(multiVY0);
+    free(multiVX);
+    free(multiVY);
+}
+
+int StableSolver::resize(int newRowSize, int newColSize)
+{
+    if(newRowSize < 4 || newColSize < 4)
+    {
+        fprintf(stderr, "resize: a %dx%d grid is too small\n", newRowSize, newColSize);
+        return 0;
+    }
+    if(newRowSize == rowSize && newColSize == colSize) return 1;
+    TraceScope scope("resize");
+
+    //the fields that carry over, everything else is worked out again each step
+    int oldRowSize = rowSize;
+    int oldColSize = colSize;
+    float *oldVX = vx;
+    float *oldVY = vy;
+    float *oldD = d;
+    vx = NULL;
+    vy = NULL;
+    d = NULL;
+    release();
+    allocate(newRowSize, newColSize);
+
+    //every field sits on the cell centers; velocities are in cells a step, so
+    //they scale with the cells
+    FieldGrid oldGrid = {oldRowSize, oldColSize, 0.5f, 0.5f, oldRowSize, oldColSize};
+    FieldGrid newGrid = {rowSize, colSize, 0.5f, 0.5f, rowSize, colSize};
+    resampleField(vx, newGrid, oldVX, oldGrid, RESAMPLE_BILINEAR, (float)rowSize/oldRowSize, 0.0f);
+    resampleField(vy, newGrid, oldVY, oldGrid, RESAMPLE_BILINEAR, (float)colSize/oldColSize, 0.0f);
+    resampleField(d, newGrid, oldD, oldGrid, RESAMPLE_CONSERVATIVE, 1.0f, 0.0f);
+    free(oldVX);
+    free(oldVY);
+    free(oldD);
+
+    //interpolation leaves the velocity slightly divergent
+    setBoundary(vx, 1);
+    setBoundary(vy, 2);
+    setBoundary(d, 0);
+    projection();
+
+    cleanBuffer();
+    memcpy(pipeVX, vx, sizeof(float)*totSize);
+    memcpy(pipeVY, vy, sizeof(float)*totSize);
+    velPhase = 0;
+    dirty.markAll();
+    return 1;
 }
 
 void StableSolver::reset()
@@ -110,7 +209,12 @@ void StableSolver::reset()
         vx[i] = 0.0f;
         vy[i] = 0.0f;
         d[i] = 0.0f;
+        pipeVX[i] = 0.0f;
+        pipeVY[i] = 0.0f;
     }
+    velPhase = 0;
+    velMax = 0.0f;
+    dirty.markAll();
 }
 
 void StableSolver::cleanBuffer()
@@ -175,11 +279,12 @@ void StableSolver::setBoundary(float *value, int flag)
 
 void StableSolver::projection()
 {
+    TraceScope scope("projection");
     for(int i=1; i<=rowSize-2; i++)
     {
         for(int j=1; j<=colSize-2; j++)
         {
-            div[cIdx(i, j)] = 0.5f * (vx[cIdx(i+1, j)]-vx[cIdx(i-1, j)]+vy[cIdx(i, j+1)]-vy[cIdx(i, j-1)]);
+            div[cIdx(i, j)] = -0.5f * (vx[cIdx(i+1, j)]-vx[cIdx(i-1, j)]+vy[cIdx(i, j+1)]-vy[cIdx(i, j-1)]);
             p[cIdx(i, j)] = 0.0f;;
         }
     }
@@ -187,33 +292,33 @@ void StableSolver::projection()
     setBoundary(p, 0);
 
     //projection iteration
-    for(int k=0; k<20; k++)
+    for(int k=0; k<iterations; k++)
     {
-        for(int i=1; i<=rowSize-2; i++)
-        {
-            for(int j=1; j<=colSize-2; j++)
-            {
-                p[cIdx(i, j)] = (p[cIdx(i+1, j)]+p[cIdx(i-1, j)]+p[cIdx(i, j+1)]+p[cIdx(i, j-1)]-div[cIdx(i, j)])/4.0f;
-            }
-        }
+        relax.sweep(p, div, rowSize, 1, rowSize-2, 1, colSize-2, 1.0f, 4.0f);
         setBoundary(p, 0);
     }
 
-    //velocity minus grad of Pressure
-    for(int i=1; i<=rowSize-2; i++)
+    //velocity minus grad of Pressure, row by row so the fastest velocity is
+    //picked up while the row is still in cache; the walls only mirror the interior
+    float fastest = 0.0f;
+    for(int j=1; j<=colSize-2; j++)
     {
-        for(int j=1; j<=colSize-2; j++)
+        for(int i=1; i<=rowSize-2; i++)
         {
             vx[cIdx(i, j)] -= 0.5f*(p[cIdx(i+1, j)]-p[cIdx(i-1, j)]);
             vy[cIdx(i, j)] -= 0.5f*(p[cIdx(i, j+1)]-p[cIdx(i, j-1)]);
         }
+        fastest = maxMagnitude(vx+cIdx(1, j), rowSize-2, fastest);
+        fastest = maxMagnitude(vy+cIdx(1, j), rowSize-2, fastest);
     }
+    velMax = fastest;
     setBoundary(vx, 1);
     setBoundary(vy, 2);
 }
 
 void StableSolver::advection(float *value, float *value0, float *u, float *v, int flag)
 {
+    TraceScope scope("advection");
     float oldX;
     float oldY;
     int i0;
@@ -255,26 +360,24 @@ void StableSolver::advection(float *value, float *value0, float *u, float *v, in
     setBoundary(value, flag);
 }
 
-void StableSolver::diffusion(float *value, float *value0, float rate, int flag)
+void StableSolver::diffusion(float *value, float *value0, float rate, int flag, Relax *solve)
 {
+    TraceScope scope("diffusion");
+    if(solve == NULL) solve = &relax;
     for(int i=0; i<totSize; i++) value[i] = 0.0f;
     float a = rate*timeStep;
 
-    for(int k=0; k<20; k++)
+    for(int k=0; k<iterations; k++)
     {
-        for(int i=1; i<=rowSize-2; i++)
-        {
-            for(int j=1; j<=colSize-2; j++)
-            {
-                value[cIdx(i, j)] = (value0[cIdx(i, j)]+a*(value[cIdx(i+1, j)]+value[cIdx(i-1, j)]+value[cIdx(i, j+1)]+value[cIdx(i, j-1)])) / (4.0f*a+1.0f);
-            }
-        }
+        solve->sweep(value, value0, rowSize, 1, rowSize-2, 1, colSize-2, a, 4.0f*a+1.0f);
         setBoundary(value, flag);
     }
 }
 
 void StableSolver::vortConfinement()
 {
+    if(!vortOn) return;
+    TraceScope scope("vortConfinement");
     for(int i=1; i<=rowSize-2; i++)
     {
         for(int j=1; j<=colSize-2; j++)
@@ -313,8 +416,8 @@ void StableSolver::vortConfinement()
     {
         for(int j=1; j<=colSize-2; j++)
         {
-            vx[cIdx(i, j)] += vorticity * (vcfy[cIdx(i, j)] * vort[cIdx(i, j)]);
-            vy[cIdx(i, j)] += vorticity * (-vcfx[cIdx(i, j)] * vort[cIdx(i, j)]);
+            vx[cIdx(i, j)] += vorticity*timeStep * (vcfy[cIdx(i, j)] * vort[cIdx(i, j)]);
+            vy[cIdx(i, j)] += vorticity*timeStep * (-vcfx[cIdx(i, j)] * vort[cIdx(i, j)]);
         }
     }
 
@@ -324,17 +427,23 @@ void StableSolver::vortConfinement()
 
 void StableSolver::addSource()
 {
+    TraceScope scope("addSource");
     int index;
-    for(int i=1; i<=rowSize-2; i++)
+    float fastest = 0.0f;
+    for(int j=1; j<=colSize-2; j++)
     {
-        for(int j=1; j<=colSize-2; j++)
+        for(int i=1; i<=rowSize-2; i++)
         {
             index = cIdx(i, j);
             vx[index] += vx0[index];
             vy[index] += vy0[index];
             d[index] += d0[index];
         }
+        fastest = maxMagnitude(vx+cIdx(1, j), rowSize-2, fastest);
+        fastest = maxMagnitude(vy+cIdx(1, j), rowSize-2, fastest);
     }
+    velMax = fastest;
+    dirty.track(d0, NULL);
 
     setBoundary(vx, 1);
     setBoundary(vy, 2);
@@ -343,6 +452,7 @@ void StableSolver::addSource()
 
 void StableSolver::animVel()
 {
+    TraceScope scope("animVel");
     if(diff > 0.0f)
     {
         SWAP(vx0, vx);
@@ -363,11 +473,270 @@ void StableSolver::animVel()
 
 void StableSolver::animDen()
 {
+    transportDen(vx, vy, &relax);
+}
+
+void StableSolver::transportDen(float *u, float *v, Relax *solve)
+{
+    TraceScope scope("animDen");
     if(visc > 0.0f)
     {
         SWAP(d0, d);
-        diffusion(d, d0, visc, 0);
+        diffusion(d, d0, visc, 0, solve);
+        dirty.track(d, d0);
     }
     SWAP(d0, d);
-    advection(d, d0, vx, vy, 0);
+    advection(d, d0, u, v, 0);
+    dirty.track(d, d0);
+}
+
+void StableSolver::setPipelined(int on)
+{
+    if(on == pipelined) return;
+    pipelined = on;
+
+    //the red-black threads go half to each half of the step
+    RelaxConfig config = relax.getConfig();
+    RelaxConfig scalarConfig = config;
+    if(pipelined)
+    {
+        scalarConfig.threads = config.threads/2 > 0 ? config.threads/2 : 1;
+        config.threads = config.threads-scalarConfig.threads > 0 ? config.threads-scalarConfig.threads : 1;
+        pipeline.init(2);
+        memcpy(pipeVX, vx, sizeof(float)*totSize);
+        memcpy(pipeVY, vy, sizeof(float)*totSize);
+    }
+    else
+    {
+        config.threads += scalarRelax.getConfig().threads;
+        scalarConfig.threads = 1;
+    }
+    relax.setConfig(config);
+    scalarRelax.setConfig(scalarConfig);
+}
+
+//index 0 is the velocity half, 1 the density half
+void StableSolver::pipelineHalf(void *arg, int begin, int end)
+{
+    StableSolver *solver = (StableSolver *)arg;
+    for(int k=begin; k<end; k++)
+    {
+        if(k == 0)
+        {
+            solver->vortConfinement();
+            solver->animVel();
+        }
+        else solver->transportDen(solver->pipeVX, solver->pipeVY, &solver->scalarRelax);
+    }
+}
+
+void StableSolver::animPipelined()
+{
+    TraceScope scope("animPipelined");
+    pipeline.run(pipelineHalf, this, 2, 1);
+
+    //the density of the next step moves on the velocity just finished
+    memcpy(pipeVX, vx, sizeof(float)*totSize);
+    memcpy(pipeVY, vy, sizeof(float)*totSize);
+}
+
+void StableSolver::setVelInterval(int steps, int blend)
+{
+    velInterval = steps > 1 ? steps : 1;
+    velBlend = blend;
+    velPhase = 0;
+}
+
+void StableSolver::animMultiRate()
+{
+    TraceScope scope("animMultiRate");
+    if(velPhase == 0)
+    {
+        memcpy(multiVX0, vx, sizeof(float)*totSize);
+        memcpy(multiVY0, vy, sizeof(float)*totSize);
+
+        //one velocity step covers the whole interval
+        float step = timeStep;
+        timeStep = step*velInterval;
+        vortConfinement();
+        animVel();
+        timeStep = step;
+    }
+
+    if(velBlend)
+    {
+        //the velocity halfway through this step
+        float alpha = (velPhase+0.5f)/velInterval;
+        for(int i=0; i<totSize; i++)
+        {
+            multiVX[i] = multiVX0[i]+alpha*(vx[i]-multiVX0[i]);
+            multiVY[i] = multiVY0[i]+alpha*(vy[i]-multiVY0[i]);
+        }
+        transportDen(multiVX, multiVY, &relax);
+    }
+    else transportDen(vx, vy, &relax);
+
+    velPhase = (velPhase+1)%velInterval;
+}
+
+void StableSolver::setAdaptive(float cfl, float interval)
+{
+    adaptCFL = cfl > 0.0f ? cfl : 0.0f;
+    adaptInterval = interval > 0.0f ? interval : 1.0f;
+}
+
+void StableSolver::animAdaptive()
+{
+    TraceScope scope("animAdaptive");
+    float step = timeStep;
+    float remaining = adaptInterval;
+
+    //the substeps are worked out again after each one, the velocity they go by
+    //is the one the last projection left
+    for(int left=COURANT_MAX_SUBSTEPS; left>0; left--)
+    {
+        int steps = courantSteps(remaining, velMax, adaptCFL, left);
+        timeStep = remaining/steps;
+        vortConfinement();
+        animVel();
+        animDen();
+        if(steps == 1) break;
+        remaining -= timeStep;
+    }
+    timeStep = step;
+}
+
+void StableSolver::matchRelax(RelaxConfig config)
+{
+    RelaxConfig own = relax.getConfig();
+    own.scheme = config.scheme;
+    own.bandRows = config.bandRows;
+    relax.setConfig(own);
+
+    RelaxConfig scalar = scalarRelax.getConfig();
+    scalar.scheme = config.scheme;
+    scalar.bandRows = config.bandRows;
+    scalarRelax.setConfig(scalar);
+}
+
+void StableSolver::tuneRelax(const char *cachePath)
+{
+    RelaxConfig config;
+    autoTuneRelax("GridStable", rowSize, colSize, cachePath, AUTOTUNE_BUDGET, &config);
+    relax.setConfig(config);
+}
+
+void StableSolver::fillDensImage(unsigned char *pixels)
+{
+    vertexDensityToRGBA(d, rowSize, getImgWidth(), getImgHeight(), pixels, getImgWidth());
+}
+
+void StableSolver::fillDensImage(unsigned char *pixels, DirtyRect rect)
+{
+    vertexDensityToRGBA(d+cIdx(rect.x0, rect.y0), rowSize, rect.x1-rect.x0+1, rect.y1-rect.y0+1,
+                        pixels+(rect.y0*getImgWidth()+rect.x0)*4, getImgWidth());
+}
+
+void StableSolver::fillSpeedImage(unsigned char *pixels, float scale)
+{
+    vertexSpeedToRGBA(vx, vy, rowSize, getImgWidth(), getImgHeight(), scale, pixels, getImgWidth());
+}
+
+void StableSolver::saveFrame(float *frame)
+{
+    memcpy(frame, vx, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(frame, vy, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(frame, d, sizeof(float)*totSize);
+}
+
+void StableSolver::loadFrame(const float *frame)
+{
+    memcpy(vx, frame, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(vy, frame, sizeof(float)*totSize);
+    frame += totSize;
+    //only the tiles that differ from the last frame are uploaded again
+    dirty.track(frame, d);
+    memcpy(d, frame, sizeof(float)*totSize);
+}
+
+void StableSolver::fillCheckpoint(CheckpointWriter *writer)
+{
+    writer->setSolver("GridStable");
+    writer->addParam("rowSize", rowSize);
+    writer->addParam("colSize", colSize);
+    writer->addParam("timeStep", timeStep);
+    writer->addParam("visc", visc);
+    writer->addParam("diff", diff);
+    writer->addParam("vorticity", vorticity);
+    writer->addParam("relaxScheme", relax.getConfig().scheme);
+    writer->addParam("relaxBandRows", relax.getConfig().bandRows);
+    writer->addField("vx", vx, rowSize, colSize);
+    writer->addField("vy", vy, rowSize, colSize);
+    writer->addField("d", d, rowSize, colSize);
+}
+
+int StableSolver::saveCheckpoint(const char *path)
+{
+    CheckpointWriter writer;
+    fillCheckpoint(&writer);
+    return writer.write(path);
+}
+
+int StableSolver::loadCheckpoint(const char *path, int keepSize)
+{
+    CheckpointReader reader;
+    if(!reader.open(path, "GridStable")) return 0;
+
+    //the grid it was saved on, another run's or this one's before a resize
+    double value;
+    int newRowSize = reader.getParam("rowSize", &value) ? (int)value : rowSize;
+    int newColSize = reader.getParam("colSize", &value) ? (int)value : colSize;
+    if(keepSize && (newRowSize != rowSize || newColSize != colSize))
+    {
+        fprintf(stderr, "%s: checkpoint is %dx%d, the grid has to stay %dx%d\n", path, newRowSize, newColSize, rowSize, colSize);
+        return 0;
+    }
+
+    //nothing changes unless every field fits that grid
+    if(newRowSize < 4 || newColSize < 4 || !reader.getField("vx", newRowSize, newColSize) ||
+       !reader.getField("vy", newRowSize, newColSize) || !reader.getField("d", newRowSize, newColSize))
+    {
+        fprintf(stderr, "%s: checkpoint does not hold a %dx%d grid\n", path, newRowSize, newColSize);
+        return 0;
+    }
+    if(newRowSize != rowSize || newColSize != colSize)
+    {
+        release();
+        allocate(newRowSize, newColSize);
+        cleanBuffer();
+    }
+
+    if(reader.getParam("timeStep", &value)) timeStep = (float)value;
+    if(reader.getParam("visc", &value)) visc = (float)value;
+    if(reader.getParam("diff", &value)) diff = (float)value;
+    if(reader.getParam("vorticity", &value)) vorticity = (float)value;
+
+    //resumes with the relaxation it was saved with
+    double bandRows;
+    if(reader.getParam("relaxScheme", &value) && reader.getParam("relaxBandRows", &bandRows))
+    {
+        RelaxConfig config = relax.getConfig();
+        config.scheme = (int)value;
+        config.bandRows = (int)bandRows;
+        matchRelax(config);
+    }
+
+    reader.readField("vx", vx, rowSize, colSize);
+    reader.readField("vy", vy, rowSize, colSize);
+    reader.readField("d", d, rowSize, colSize);
+    memcpy(pipeVX, vx, sizeof(float)*totSize);
+    memcpy(pipeVY, vy, sizeof(float)*totSize);
+    velPhase = 0;
+    velMax = maxMagnitude(vy, totSize, maxMagnitude(vx, totSize, 0.0f));
+
+    dirty.markAll();
+    return 1;
 }
@@ -22,13 +22,21 @@
 #ifndef __GRIDSTABLESOLVER_H__
 #define __GRIDSTABLESOLVER_H__
 
+#include "DirtyTiles.h"
+#include "Relax.h"
+
+class CheckpointWriter;
+
 class StableSolver
 {
 public:
     StableSolver();
     ~StableSolver();
-    void init();
+    void init(int _rowSize, int _colSize);
     void reset();
+    //resamples the velocity and density onto a newRowSize x newColSize grid and projects
+    //again, the picture carries on at the new size; returns 1 on success
+    int resize(int newRowSize, int newColSize);
     void cleanBuffer();
     void start(){ running=1; }
     void stop(){ running=0; }
@@ -38,11 +46,51 @@ public:
     void setBoundary(float *value, int flag);
     void projection();
     void advection(float *value, float *value0, float *u, float *v, int flag);
-    void diffusion(float *value, float *value0, float rate, int flag);
+    //solve is the relaxation to iterate with, NULL for the solver's own
+    void diffusion(float *value, float *value0, float rate, int flag, Relax *solve=NULL);
     void vortConfinement();
     void addSource();
     void animVel();
     void animDen();
+    //pipelined stepping, the density of step n moves on pipeVX/pipeVY on its own
+    //threads while the velocity of step n+1 is computed, so it lags one step
+    //behind the velocity. set once the relaxation is configured, it splits
+    //the relaxation threads between the two halves
+    void setPipelined(int on);
+    int isPipelined(){ return pipelined; }
+    //vortConfinement+animVel next to animDen, what step_solver does in turn
+    void animPipelined();
+    //multi-rate stepping, the velocity moves every steps steps, a whole interval
+    //at a time, and the density every step on the velocity blended from the start
+    //to the end of the interval, or on the end velocity held if blend is 0
+    void setVelInterval(int steps, int blend);
+    int getVelInterval(){ return velInterval; }
+    //vortConfinement+animVel when an interval starts, animDen every step
+    void animMultiRate();
+    //adaptive stepping, every step covers interval units of time in as few substeps
+    //as keep the velocity under cfl cells a substep; cfl 0 steps timeStep as ever
+    void setAdaptive(float cfl, float interval);
+    float getCFL(){ return adaptCFL; }
+    //vortConfinement+animVel+animDen once per substep
+    void animAdaptive();
+    //relaxation of the diffusion and pressure solves
+    void setRelaxConfig(RelaxConfig config){ relax.setConfig(config); }
+    RelaxConfig getRelaxConfig(){ return relax.getConfig(); }
+    //the scheme and band rows of config on this solver's own threads; the scheme
+    //decides the numbers a step gives, the threads do not
+    void matchRelax(RelaxConfig config);
+    //sweeps per diffusion and pressure solve, 20 unless traded for time
+    void setIterations(int value){ iterations = value; }
+    //vortConfinement does nothing while off
+    void setVortConfinement(int on){ vortOn = on; }
+    //the fastest relaxation for this grid, timed once per machine and kept in cachePath
+    void tuneRelax(const char *cachePath);
+
+    //checkpoint, returns 1 on success; a checkpoint of another size brings its grid
+    //along unless keepSize is set
+    void fillCheckpoint(CheckpointWriter *writer);
+    int saveCheckpoint(const char *path);
+    int loadCheckpoint(const char *path, int keepSize=0);
 
     //getter
     int getRowSize(){ return rowSize; }
@@ -56,15 +104,36 @@ public:
     float* getD(){ return d; }
     float* getPX(){ return px; }
     float* getPY(){ return py; }
+    //the largest velocity component as of the last projection or addSource
+    float getVelMax(){ return velMax; }
     float getDens(int i, int j){ return (d[cIdx(i-1, j-1)]+d[cIdx(i, j-1)]+d[cIdx(i-1, j)]+d[cIdx(i, j)])/4.0f; }
 
+    //display, one RGBA8 pixel per grid vertex 1..rowSize-1 x 1..colSize-1
+    int getImgWidth(){ return rowSize-1; }
+    int getImgHeight(){ return colSize-1; }
+    void fillDensImage(unsigned char *pixels);
+    void fillDensImage(unsigned char *pixels, DirtyRect rect);
+    void fillSpeedImage(unsigned char *pixels, float scale);
+    DirtyTiles* getDirty(){ return &dirty; }
+    //the fields the viewer draws packed into one frame, so a copy of the solver
+    //can be drawn while the solver itself goes on stepping
+    int getFrameSize(){ return 3*totSize; }
+    void saveFrame(float *frame);
+    void loadFrame(const float *frame);
+
     //setter
     void setVX0(int i, int j, float value){ vx0[cIdx(i, j)]=value; }
     void setVY0(int i, int j, float value){ vy0[cIdx(i, j)]=value; }
     void setD0(int i, int j, float value){ d0[cIdx(i, j)]=value; }
+    //rate the velocity diffuses at, cells^2 per step
+    void setViscosity(float value){ diff=value; }
 
 private:
     int cIdx(int i, int j){ return j*rowSize+i; }
+    void allocate(int _rowSize, int _colSize);
+    void release();
+    void transportDen(float *u, float *v, Relax *solve);
+    static void pipelineHalf(void *arg, int begin, int end);
 
 private:
     int rowSize;
@@ -84,6 +153,8 @@ private:
     float diff;
     float vorticity;
     float timeStep;
+    int iterations;
+    int vortOn;
 
     float *vx;
     float *vy;
@@ -103,6 +174,31 @@ private:
     float *lenGrad;
     float *vcfx;
     float *vcfy;
+
+    //display regions changed by addSource/animDen
+    DirtyTiles dirty;
+    Relax relax;
+
+    //pipelined stepping
+    int pipelined;
+    float *pipeVX;
+    float *pipeVY;
+    ThreadPool pipeline;
+    Relax scalarRelax;
+
+    //multi-rate stepping
+    int velInterval;
+    int velBlend;
+    int velPhase;
+    float *multiVX0;
+    float *multiVY0;
+    float *multiVX;
+    float *multiVY;
+
+    //adaptive stepping
+    float adaptCFL;
+    float adaptInterval;
+    float velMax;
 };
 
 #endif
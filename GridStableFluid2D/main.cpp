@@ -21,8 +21,26 @@
 
 #include <GL/glut.h>
 #include "GridStableSolver.h"
+#include "FrameExporter.h"
+#include "Snapshotter.h"
+#include "Recording.h"
+#include "InputLog.h"
+#include "AutoTune.h"
+#include "Tracer.h"
+#include "PerfCounters.h"
+#include "LatencyProbe.h"
+#include "SimThread.h"
+#include "StepClock.h"
+#include "Governor.h"
+#include <stdlib.h>
+#include <string.h>
+#include <thread>
+#include <chrono>
 
 StableSolver *solver;
+//what the window shows: the solver itself, or with -threaded a copy of the last
+//frame the simulation thread handed off
+StableSolver *view;
 
 int disp_type=1;
 
@@ -35,18 +53,23 @@ int omy;
 int mx;
 int my;
 
+GLuint dens_tex;
+unsigned char *dens_pixels;
+
+GLuint overlay_list;
+
 void draw_velocity()
 {
-    float *px = solver->getPX();
-    float *py = solver->getPY();
-    float *vx = solver->getVX();
-    float *vy = solver->getVY();
+    float *px = view->getPX();
+    float *py = view->getPY();
+    float *vx = view->getVX();
+    float *vy = view->getVY();
 
     glColor3f(0.0f, 1.0f, 0.0f);
     glLineWidth(1.0f);
 
     glBegin(GL_LINES);
-        for(int i=0; i<solver->getTotSize(); i++)
+        for(int i=0; i<view->getTotSize(); i++)
         {
             glVertex2f(px[i], py[i]);
             glVertex2f(px[i]+vx[i]*10.0f, py[i]+vy[i]*10.0f);
@@ -54,47 +77,368 @@ void draw_velocity()
     glEnd ();
 }
 
+void init_density()
+{
+    int width = view->getImgWidth();
+    int height = view->getImgHeight();
+
+    dens_pixels = (unsigned char *)malloc(sizeof(unsigned char)*width*height*4);
+
+    glGenTextures(1, &dens_tex);
+    glBindTexture(GL_TEXTURE_2D, dens_tex);
+    glTexImage2D(GL_TEXTURE_2D, 0, GL_RGBA8, width, height, 0, GL_RGBA, GL_UNSIGNED_BYTE, NULL);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_S, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_WRAP_T, GL_CLAMP_TO_EDGE);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MAG_FILTER, GL_LINEAR);
+    glTexParameteri(GL_TEXTURE_2D, GL_TEXTURE_MIN_FILTER, GL_LINEAR);
+}
+
 void draw_density()
 {
-    float x;
-    float y;
-    float d00;
-    float d01;
-    float d10;
-    float d11;
+    int width = view->getImgWidth();
+    int height = view->getImgHeight();
 
-    int rowSize = solver->getRowSize();
-    int colSize = solver->getColSize();
+    glEnable(GL_TEXTURE_2D);
+    glBindTexture(GL_TEXTURE_2D, dens_tex);
+
+    //only the parts that changed since the last upload are converted and sent
+    DirtyTiles *dirty = view->getDirty();
+    int numRects = dirty->collect();
 
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, width);
+    for(int k=0; k<numRects; k++)
+    {
+        DirtyRect rect = dirty->getRect(k);
+        view->fillDensImage(dens_pixels, rect);
+
+        glPixelStorei(GL_UNPACK_SKIP_PIXELS, rect.x0);
+        glPixelStorei(GL_UNPACK_SKIP_ROWS, rect.y0);
+        glTexSubImage2D(GL_TEXTURE_2D, 0, rect.x0, rect.y0, rect.x1-rect.x0+1, rect.y1-rect.y0+1, GL_RGBA, GL_UNSIGNED_BYTE, dens_pixels);
+    }
+    glPixelStorei(GL_UNPACK_ROW_LENGTH, 0);
+    glPixelStorei(GL_UNPACK_SKIP_PIXELS, 0);
+    glPixelStorei(GL_UNPACK_SKIP_ROWS, 0);
+
+    //texel centers sit on the grid vertices 1..width, linear filtering shades between them
+    float s0 = 0.5f/width;
+    float s1 = 1.0f-s0;
+    float t0 = 0.5f/height;
+    float t1 = 1.0f-t0;
+
+    glColor3f(1.0f, 1.0f, 1.0f);
     glBegin(GL_QUADS);
-        for(int i=1; i<=rowSize-2; i++)
-        {
-            x = (float)i;
-            for(int j=1; j<=colSize-2; j++)
+        glTexCoord2f(s0, t0); glVertex2f(1.0f, 1.0f);
+        glTexCoord2f(s1, t0); glVertex2f((float)width, 1.0f);
+        glTexCoord2f(s1, t1); glVertex2f((float)width, (float)height);
+        glTexCoord2f(s0, t1); glVertex2f(1.0f, (float)height);
+    glEnd();
+    glDisable(GL_TEXTURE_2D);
+}
+
+void init_overlay()
+{
+    //the cell centers never move, record them once
+    overlay_list = glGenLists(1);
+    glNewList(overlay_list, GL_COMPILE);
+        glColor3f(1.0f, 0.0f, 0.0f);
+        glPointSize(1.0f);
+        glBegin(GL_POINTS);
+            for(int i=0; i<view->getTotSize(); i++)
             {
-                y = (float)j;
+                glVertex2f(view->getPX()[i], view->getPY()[i]);
+            }
+        glEnd();
+    glEndList();
+}
 
-                d00 = solver->getDens(i, j);
-                d01 = solver->getDens(i, j+1);
-                d10 = solver->getDens(i+1, j);
-                d11 = solver->getDens(i+1, j+1);
+//the density texture and the overlay follow the grid when it is resized
+int display_rows;
+int display_cols;
 
-                glColor3f(1.0f-d00, 1.0f, 1.0f-d00); glVertex2f(x, y);
-                glColor3f(1.0f-d10, 1.0f, 1.0f-d10); glVertex2f(x+1.0f, y);
-                glColor3f(1.0f-d11, 1.0f, 1.0f-d11); glVertex2f(x+1.0f, y+1.0f);
-                glColor3f(1.0f-d01, 1.0f, 1.0f-d01); glVertex2f(x, y+1.0f);
-            }
-        }
-    glEnd();
+void fit_display()
+{
+    if(display_rows == view->getRowSize() && display_cols == view->getColSize()) return;
+    if(display_rows != 0)
+    {
+        free(dens_pixels);
+        glDeleteTextures(1, &dens_tex);
+        glDeleteLists(overlay_list, 1);
+    }
+    init_density();
+    init_overlay();
+    view->getDirty()->markAll();
+    display_rows = view->getRowSize();
+    display_cols = view->getColSize();
 }
 
-void get_input()
+//'r' records the current view to numbered PNG files
+FrameExporter exporter;
+int record_type;
+
+void export_frame()
+{
+    if(!exporter.isRunning()) return;
+    TraceScope scope("export");
+
+    //the viewer would rather drop frames than stall while the writers catch up
+    unsigned char *pixels = exporter.acquire();
+    if(!pixels) return;
+
+    if(record_type == 0) view->fillDensImage(pixels);
+    if(record_type == 1) view->fillSpeedImage(pixels, 1.0f);
+    exporter.submit(pixels);
+}
+
+//'p' toggles periodic snapshots, written in the background while the simulation runs
+Snapshotter snapshotter;
+int snapshot_on;
+int snapshot_time;
+
+void fill_checkpoint(void *arg, CheckpointWriter *writer)
+{
+    ((StableSolver *)arg)->fillCheckpoint(writer);
+}
+
+//"-budget ms" holds the solver to ms a step, trading vorticity confinement and accuracy for time
+Governor governor;
+//the settings changed since the input log was last told of them
+int effort_changed = 0;
+
+//the effort the governor allows from the next step on
+void govern_solver()
+{
+    GovernorSettings settings = governor.getSettings();
+    effort_changed = 1;
+    solver->setIterations(settings.iterations);
+    solver->setVortConfinement(settings.optional);
+    RelaxConfig config = solver->getRelaxConfig();
+    if(config.threads != settings.threads)
+    {
+        config.threads = settings.threads;
+        solver->setRelaxConfig(config);
+    }
+}
+
+void step_solver()
+{
+    TraceScope scope("step");
+    governor.begin();
+    if(solver->isPipelined()) solver->animPipelined();
+    else if(solver->getVelInterval() > 1) solver->animMultiRate();
+    else if(solver->getCFL() > 0.0f) solver->animAdaptive();
+    else
+    {
+        solver->vortConfinement();
+        solver->animVel();
+        solver->animDen();
+    }
+    if(governor.end()) govern_solver();
+}
+
+//"-record file frames [-vel]" records a plume and "-save file frames" checkpoints one
+//without opening a window, "-play file" replays a recording; while paused ',' '.' step
+//and '<' '>' skip 100 frames
+RecordingReader player;
+int play_on;
+int play_frame;
+
+//a plume rising from the bottom stands in for the mouse when running without a window
+void plume_step()
 {
+    TraceScope scope("frame");
+    int rowSize = solver->getRowSize();
+
     solver->cleanBuffer();
+    solver->setD0(rowSize/2, 2, 10.0f);
+    solver->setVY0(rowSize/2, 2, 10.0f);
+    solver->addSource();
+    step_solver();
+}
 
-    //int totSize = solver->getTotSize();
+int record_headless(const char *path, int frames, int vel)
+{
+    int rowSize = solver->getRowSize();
+    int colSize = solver->getColSize();
+
+    RecordingWriter writer;
+    if(!writer.open(path, "GridStable", 30, 12)) return 1;
+    writer.addField("d", rowSize, colSize);
+    if(vel)
+    {
+        writer.addField("vx", rowSize, colSize);
+        writer.addField("vy", rowSize, colSize);
+    }
+    const float *fields[3] = {solver->getD(), solver->getVX(), solver->getVY()};
+
+    for(int k=0; k<frames; k++)
+    {
+        plume_step();
+        if(!writer.writeFrame(fields)) break;
+    }
+    return writer.close() ? 0 : 1;
+}
+
+int save_headless(const char *path, int frames)
+{
+    for(int k=0; k<frames; k++) plume_step();
+    return solver->saveCheckpoint(path) ? 0 : 1;
+}
+
+void play_step(int delta)
+{
     int rowSize = solver->getRowSize();
     int colSize = solver->getColSize();
+    int numFrames = player.getNumFrames();
+    if(numFrames == 0) return;
+
+    play_frame = ((play_frame+delta)%numFrames+numFrames)%numFrames;
+    player.readField(play_frame, "d", solver->getD(), rowSize, colSize);
+    player.readField(play_frame, "vx", solver->getVX(), rowSize, colSize);
+    player.readField(play_frame, "vy", solver->getVY(), rowSize, colSize);
+    solver->getDirty()->markAll();
+}
+
+//'i' logs the input from a cleared simulation to input.sfi and "-replay file [-realtime]"
+//feeds a log to the solver without a window, then prints a hash of the fields
+InputLogWriter input_log;
+std::chrono::steady_clock::time_point input_start;
+
+//milliseconds since the log was opened; the steady clock rather than GLUT, which
+//must not be called off the thread running glutMainLoop, as sim_step is
+int input_time()
+{
+    return (int)std::chrono::duration_cast<std::chrono::milliseconds>(std::chrono::steady_clock::now()-input_start).count();
+}
+
+//the effort the governor picked, if it changed; it holds from the next step on
+void log_effort()
+{
+    if(!effort_changed) return;
+
+    GovernorSettings settings = governor.getSettings();
+    input_log.effort(settings.iterations, settings.optional);
+    effort_changed = 0;
+}
+
+//the step just taken, then any effort for the steps after it, so a replay
+//changes the effort between the same two steps
+void log_step()
+{
+    input_log.step(input_time());
+    log_effort();
+}
+
+void apply_input(void *arg, const InputEvent *event)
+{
+    switch(event->type)
+    {
+        case INPUT_CLEAN:
+            solver->cleanBuffer();
+            break;
+        case INPUT_VELOCITY:
+            solver->setVX0(event->i, event->j, event->x);
+            solver->setVY0(event->i, event->j, event->y);
+            break;
+        case INPUT_DENSITY:
+            solver->setD0(event->i, event->j, event->x);
+            break;
+        case INPUT_SOURCE:
+            solver->addSource();
+            break;
+        case INPUT_STEP:
+            step_solver();
+            break;
+        case INPUT_RESET:
+            solver->reset();
+            break;
+        case INPUT_START:
+            solver->start();
+            break;
+        case INPUT_STOP:
+            solver->stop();
+            break;
+        case INPUT_EFFORT:
+            solver->setIterations(event->i);
+            solver->setVortConfinement(event->j);
+            break;
+    }
+}
+
+int replay_headless(const char *path, int realtime)
+{
+    InputLogReader reader;
+    if(!reader.open(path, "GridStable", solver->getRowSize(), solver->getColSize())) return 1;
+    //the relaxation the log was written with, whatever this machine would pick
+    RelaxConfig config = reader.getRelaxConfig();
+    solver->matchRelax(config);
+    printf("replay: %s relaxation as logged\n", relaxSchemeName(config.scheme));
+
+    double seconds;
+    int steps = replayInput(&reader, apply_input, NULL, realtime, &seconds);
+
+    uint64_t hash = FIELD_HASH_SEED;
+    hash = hashField(solver->getVX(), solver->getTotSize(), hash);
+    hash = hashField(solver->getVY(), solver->getTotSize(), hash);
+    hash = hashField(solver->getD(), solver->getTotSize(), hash);
+    printf("replayed %d steps in %.3f s (%.1f steps/s), fields hash %016llx\n",
+           steps, seconds, steps/seconds, (unsigned long long)hash);
+    return 0;
+}
+
+//"-threaded" steps the solver on a thread of its own, the viewer draws the frames it
+//hands back and sends it the input through a queue; both sides never wait on each other
+SimThread sim;
+
+//applies an event and logs it, on the thread that steps the solver
+void feed_input(void *arg, const InputEvent *event)
+{
+    apply_input(arg, event);
+    input_log.write(event);
+}
+
+void sim_step(void *arg)
+{
+    step_solver();
+    log_step();
+}
+
+void sim_publish(void *arg, float *fields)
+{
+    solver->saveFrame(fields);
+}
+
+void snapshot_frame()
+{
+    snapshotter.poll();
+    if(!snapshot_on) return;
+
+    int now = glutGet(GLUT_ELAPSED_TIME);
+    if(now-snapshot_time < 5000) return;
+    //a state the solver reached, like 's' saves: with -rate the view is a blend of two
+    //steps, only with -threaded is it the last frame the simulation thread handed off
+    void *state = sim.isRunning() ? (void *)view : (void *)solver;
+    if(snapshotter.begin(fill_checkpoint, state, "snapshot.sfc")) snapshot_time = now;
+}
+
+void send_input(InputEvent event)
+{
+    //a full queue drops the event rather than stall the viewer
+    if(sim.isRunning()) sim.send(&event);
+    else feed_input(NULL, &event);
+}
+
+//"-latency" follows every drag from the mouse event to the frame that shows it,
+//the distribution is printed on escape
+LatencyProbe latency;
+
+void get_input()
+{
+    TraceScope scope("input");
+    send_input(inputEvent(INPUT_CLEAN));
+
+    //int totSize = solver->getTotSize();
+    int rowSize = view->getRowSize();
+    int colSize = view->getColSize();
 
     int xPos;
     int yPos;
@@ -108,25 +452,71 @@ void get_input()
         {
             if(mouse_down[0])
             {
-                solver->setVX0(xPos, yPos, 1.0f * (mx - omx));
-                solver->setVY0(xPos, yPos, 1.0f * (omy - my));
+                send_input(inputEvent(INPUT_VELOCITY, xPos, yPos, 1.0f * (mx - omx), 1.0f * (omy - my)));
             }
 
             if(mouse_down[2])
             {
-                solver->setD0(xPos, yPos, 10.0f);
+                send_input(inputEvent(INPUT_DENSITY, xPos, yPos, 10.0f));
             }
 
             omx = mx;
             omy = my;
         }
 
-        solver->addSource();
+        //the batch number tells the latency probe which frames include this input
+        send_input(inputEvent(INPUT_SOURCE, 0, 0, 0.0f, 0.0f, latency.nextBatch()));
+    }
+}
+
+//'k' hides and shows the counters of the last second when started with -counters
+int counters_shown = 1;
+
+void draw_counters()
+{
+    if(!countersOn() || !counters_shown) return;
+
+    //view units per pixel, lines of the 8x13 font down from the top left corner
+    float width = (float)view->getRowSize();
+    float height = (float)view->getColSize();
+    float unitX = width/win_x;
+    float unitY = height/win_y;
+
+    glPushAttrib(GL_ENABLE_BIT);
+    glDisable(GL_TEXTURE_2D);
+    glColor3f(0.0f, 0.0f, 0.0f);
+    const char *line;
+    for(int k=0; (line = countersLine(k)) != NULL; k++)
+    {
+        glRasterPos2f(6.0f*unitX, height-(k+1)*15.0f*unitY);
+        for(; *line; line++) glutBitmapCharacter(GLUT_BITMAP_8_BY_13, *line);
     }
+    glPopAttrib();
+}
+
+//'[' and ']' halve and double the grid between GRID_MIN and GRID_MAX cells a side,
+//and -budget asks the same when less effort alone cannot hold it; the grid is
+//resized before the next frame steps
+#define GRID_MIN 32
+#define GRID_MAX 512
+int resize_request;
+
+int request_resize(void *arg, int down)
+{
+    int rows = down ? solver->getRowSize()/2 : solver->getRowSize()*2;
+    int cols = down ? solver->getColSize()/2 : solver->getColSize()*2;
+    if(rows < GRID_MIN || cols < GRID_MIN || rows > GRID_MAX || cols > GRID_MAX) return 0;
+    //recordings, input logs and the frames of the simulation thread are all of one size
+    if(play_on || sim.isRunning() || exporter.isRunning() || input_log.isOpen()) return 0;
+    resize_request = down ? -1 : 1;
+    return 1;
 }
 
 void key_func(unsigned char key, int x, int y)
 {
+    //keys use the solver itself, between two steps of the simulation thread
+    sim.pause();
+
     switch(key)
     {
         case 'v':
@@ -138,20 +528,94 @@ void key_func(unsigned char key, int x, int y)
             if(solver->isRunning() == 1)
             {
                 solver->stop();
+                input_log.stop();
             }
             else
             {
                 solver->start();
+                input_log.start();
             }
             break;
         case 'c':
         case 'C':
             solver->reset();
+            input_log.reset();
+            break;
+        case 'r':
+        case 'R':
+            if(exporter.isRunning())
+            {
+                exporter.stop();
+            }
+            else
+            {
+                record_type = disp_type;
+                exporter.start("frame_%05d.png", solver->getImgWidth(), solver->getImgHeight(), 2, 8, 1);
+            }
+            break;
+        case 's':
+        case 'S':
+            solver->saveCheckpoint("checkpoint.sfc");
+            break;
+        case 'l':
+        case 'L':
+            //the frames of the simulation thread, recordings and input logs are all of one
+            //size, a checkpoint of another one waits until they are done
+            solver->loadCheckpoint("checkpoint.sfc", play_on || sim.isRunning() || exporter.isRunning() || input_log.isOpen());
+            break;
+        case 'p':
+        case 'P':
+            snapshot_on = !snapshot_on;
+            snapshot_time = glutGet(GLUT_ELAPSED_TIME)-5000;
+            break;
+        case ',':
+        case '.':
+        case '<':
+        case '>':
+            if(play_on && !solver->isRunning())
+            {
+                play_step(key == ',' ? -1 : (key == '.' ? 1 : (key == '<' ? -100 : 100)));
+            }
+            break;
+        case 'i':
+        case 'I':
+            if(input_log.isOpen())
+            {
+                input_log.close();
+            }
+            else if(input_log.open("input.sfi", "GridStable", solver->getRowSize(), solver->getColSize(), solver->getRelaxConfig()))
+            {
+                //replays start from a cleared simulation as well
+                solver->reset();
+                if(!solver->isRunning()) input_log.stop();
+                input_start = std::chrono::steady_clock::now();
+                //the effort the governor has got to so far
+                effort_changed = governor.isOn();
+                log_effort();
+            }
+            break;
+        case 'k':
+        case 'K':
+            counters_shown = !counters_shown;
+            break;
+        case '[':
+        case ']':
+            if(!request_resize(NULL, key == '['))
+            {
+                printf("resize: the grid stays %d..%d cells a side, and keeps its size while playing, threaded, recording or logging input\n", GRID_MIN, GRID_MAX);
+            }
             break;
         case 27: // escape
+            exporter.stop();
+            snapshotter.wait();
+            sim.stop();
+            input_log.close();
+            latency.print();
             exit(0);
             break;
     }
+
+    sim.resume();
 }
 
 void mouse_func(int button, int state, int x, int y)
@@ -163,12 +627,14 @@ void mouse_func(int button, int state, int x, int y)
     my = y;
 
     mouse_down[button] = state == GLUT_DOWN;
+    if(state == GLUT_DOWN) latency.input();
 }
 
 void motion_func(int x, int y)
 {
     mx = x;
     my = y;
+    latency.input();
 }
 
 void reshape_func (int width, int height)
@@ -179,22 +645,108 @@ void reshape_func (int width, int height)
     win_y = height;
 }
 
+//"-rate hz" steps the solver that many times a second of real time however fast the
+//window draws, the frames in between show the last two steps blended; "-rate 0" steps
+//once a frame. "-fps hz" caps the frames drawn, 0 lifts the cap
+StepClock step_clock;
+//state before the last step, after it and the blend of both that is shown
+float *step_frames[3];
+
 void idle_func()
 {
+    step_clock.waitFrame();
     glutPostRedisplay ();
 }
 
+void step_frame()
+{
+    int steps = step_clock.advance();
+    if(steps > 0)
+    {
+        latency.consumed();
+        for(int k=0; k<steps; k++)
+        {
+            if(k == steps-1) solver->saveFrame(step_frames[0]);
+            step_solver();
+            log_step();
+        }
+        solver->saveFrame(step_frames[1]);
+        latency.stepped();
+    }
+
+    blendFields(step_frames[2], step_frames[0], step_frames[1], step_clock.getAlpha(), solver->getFrameSize());
+    view->loadFrame(step_frames[2]);
+}
+
+void resize_grid()
+{
+    if(resize_request != 0)
+    {
+        int rows = resize_request < 0 ? solver->getRowSize()/2 : solver->getRowSize()*2;
+        int cols = resize_request < 0 ? solver->getColSize()/2 : solver->getColSize()*2;
+        resize_request = 0;
+        if(solver->resize(rows, cols)) printf("grid %dx%d\n", rows, cols);
+    }
+    //misses per cell of the grid as it is now, also after a checkpoint of another size
+    countersSetCells(solver->getRowSize()*solver->getColSize());
+
+    //the copy the window draws with -rate, and the frames it blends, follow the solver
+    //through a resize or a checkpoint of another size
+    if(view == solver || (view->getRowSize() == solver->getRowSize() && view->getColSize() == solver->getColSize())) return;
+    view->resize(solver->getRowSize(), solver->getColSize());
+    for(int k=0; k<3; k++)
+    {
+        free(step_frames[k]);
+        step_frames[k] = (float *)malloc(sizeof(float)*solver->getFrameSize());
+        solver->saveFrame(step_frames[k]);
+    }
+    view->loadFrame(step_frames[2]);
+}
+
  void display_func()
 {
-    get_input();
-    solver->vortConfinement();
-    solver->animVel();
-    solver->animDen();
+    countersFrame();
+    TraceScope scope("frame");
+    resize_grid();
+
+    if(play_on)
+    {
+        if(solver->isRunning()) play_step(1);
+    }
+    else if(sim.isRunning())
+    {
+        get_input();
+        //the newest frame the simulation finished since the last one shown, if any
+        const SimFrame *frame = sim.acquire();
+        if(frame)
+        {
+            view->loadFrame(frame->fields);
+            latency.consumed(frame->batch, frame->consumeTime);
+            latency.stepped(frame->stepTime);
+        }
+    }
+    else if(step_clock.isOn())
+    {
+        get_input();
+        step_frame();
+    }
+    else
+    {
+        get_input();
+        latency.consumed();
+        step_solver();
+        latency.stepped();
+        log_step();
+    }
+    export_frame();
+    snapshot_frame();
 
+    traceBegin("draw");
+    fit_display();
     glViewport(0, 0, win_x, win_y);
     glMatrixMode(GL_PROJECTION);
     glLoadIdentity ();
-    gluOrtho2D(0.0f, (float)(solver->getRowSize()), 0.0f, (float)(solver->getColSize()));
+    gluOrtho2D(0.0f, (float)(view->getRowSize()), 0.0f, (float)(view->getColSize()));
 
     glClearColor(1.0f, 1.0f, 1.0f, 1.0f);
     glClear(GL_COLOR_BUFFER_BIT);
@@ -202,30 +754,215 @@ void idle_func()
     if(disp_type == 0) draw_density();
     if(disp_type == 1) draw_velocity();
     
-    glColor3f(1.0f, 0.0f, 0.0f);
-    glPointSize(1.0f);
-    glBegin(GL_POINTS);
-        for(int i=0; i<solver->getTotSize(); i++)
-        {
-            glVertex2f(solver->getPX()[i], solver->getPY()[i]);
-        }
-    glEnd();
+    glCallList(overlay_list);
 
+    draw_counters();
+
+    traceEnd("draw");
+
+    //waits for the display when vsync is on
+    traceBegin("swap");
     glutSwapBuffers ();
+    if(latency.isOn())
+    {
+        //waits until the swap has been carried out, the frame is on its way to the screen
+        glFinish();
+        latency.presented();
+    }
+    traceEnd("swap");
 }
 
 int main(int argc, char** argv)
 {
     solver=new StableSolver();
-    solver->init();
+    view=solver;
+    solver->init(128, 128);
     solver->reset();
+    //the fastest relaxation for this grid and machine, timed on first use; a replay
+    //runs the one its log names instead
+    int replaying = 0;
+    for(int k=1; k<argc; k++) if(strcmp(argv[k], "-replay") == 0) replaying = 1;
+    if(!replaying) solver->tuneRelax(AUTOTUNE_CACHE);
+
+    //"-trace file" ahead of the other arguments writes a timeline of the frames and
+    //solver stages to file at exit, kill -USR1 writes it while the program keeps running;
+    //"-counters" reads the hardware counters around every stage, shown over the view
+    //and printed at exit, and runs without them where the machine has none;
+    //"-latency" measures input to photon latency in the viewer;
+    //"-threaded" runs the simulation on a thread of its own; "-rate" and "-fps" see step_clock;
+    //"-pipelined" moves the density on the last step's velocity while the next one is solved;
+    //"-velsteps k" moves the velocity every k steps and the density every step on the
+    //velocity blended across them, "-velhold k" on the velocity as of the last update;
+    //"-cfl c t" moves every step t units of time on, in as many substeps as keep the
+    //velocity under c cells each, a single one while the flow is calm;
+    //"-budget ms" see governor
+    int threaded = 0;
+    double budget = 0.0;
+    double rate = 60.0;
+    double fps = 60.0;
+    while(argc > 1)
+    {
+        if(argc > 2 && strcmp(argv[1], "-trace") == 0)
+        {
+            if(!traceStart(argv[2])) return 1;
+            argv[2] = argv[0];
+            argv += 2;
+            argc -= 2;
+        }
+        else if(strcmp(argv[1], "-counters") == 0)
+        {
+            countersStart(solver->getRowSize()*solver->getColSize());
+            argv[1] = argv[0];
+            argv++;
+            argc--;
+        }
+        else if(strcmp(argv[1], "-latency") == 0)
+        {
+            latency.start();
+            argv[1] = argv[0];
+            argv++;
+            argc--;
+        }
+        else if(argc > 2 && (strcmp(argv[1], "-rate") == 0 || strcmp(argv[1], "-fps") == 0))
+        {
+            if(argv[1][1] == 'r') rate = atof(argv[2]);
+            else fps = atof(argv[2]);
+            argv[2] = argv[0];
+            argv += 2;
+            argc -= 2;
+        }
+        else if(strcmp(argv[1], "-threaded") == 0)
+        {
+            threaded = 1;
+            argv[1] = argv[0];
+            argv++;
+            argc--;
+        }
+        else if(strcmp(argv[1], "-pipelined") == 0)
+        {
+            solver->setPipelined(1);
+            argv[1] = argv[0];
+            argv++;
+            argc--;
+        }
+        else if(argc > 2 && (strcmp(argv[1], "-velsteps") == 0 || strcmp(argv[1], "-velhold") == 0))
+        {
+            solver->setVelInterval(atoi(argv[2]), strcmp(argv[1], "-velsteps") == 0);
+            argv[2] = argv[0];
+            argv += 2;
+            argc -= 2;
+        }
+        else if(argc > 3 && strcmp(argv[1], "-cfl") == 0)
+        {
+            solver->setAdaptive((float)atof(argv[2]), (float)atof(argv[3]));
+            argv[3] = argv[0];
+            argv += 3;
+            argc -= 3;
+        }
+        else if(argc > 2 && strcmp(argv[1], "-budget") == 0)
+        {
+            budget = atof(argv[2]);
+            argv[2] = argv[0];
+            argv += 2;
+            argc -= 2;
+        }
+        else break;
+    }
+
+    //the counters follow the main thread alone, so the steps and their sweeps stay on
+    //it while they count
+    if(countersOn())
+    {
+        if(threaded)
+        {
+            printf("counters: stepping on the main thread instead of -threaded, only the main thread is counted\n");
+            threaded = 0;
+        }
+        RelaxConfig config = solver->getRelaxConfig();
+        if(config.threads > 1)
+        {
+            printf("counters: relaxation on 1 thread instead of %d, only the main thread is counted\n", config.threads);
+            config.threads = 1;
+            solver->setRelaxConfig(config);
+        }
+        if(solver->isPipelined()) printf("counters: -pipelined runs half of every step on a thread that is not counted\n");
+    }
+
+    //a replay takes the effort of every step from the log, which the governor
+    //would otherwise make depend on the timing of this machine
+    if(budget > 0.0 && argc > 2 && strcmp(argv[1], "-replay") == 0)
+    {
+        printf("replay: -budget is ignored, the log holds the effort of every step\n");
+        budget = 0.0;
+    }
+
+    //down to 4 sweeps a solve, below that the projection leaves the velocity visibly
+    //divergent; threads are added only where the sweeps run in parallel and uncounted
+    RelaxConfig relax_config = solver->getRelaxConfig();
+    int max_threads = relax_config.threads;
+    if(relax_config.scheme == RELAX_REDBLACK && !solver->isPipelined() && !countersOn()) max_threads = (int)std::thread::hardware_concurrency();
+    governor.start(budget, 4, 20, relax_config.threads, max_threads, 1);
+
+    if(argc > 3 && strcmp(argv[1], "-record") == 0)
+    {
+        return record_headless(argv[2], atoi(argv[3]), argc > 4 && strcmp(argv[4], "-vel") == 0);
+    }
+    if(argc > 3 && strcmp(argv[1], "-save") == 0)
+    {
+        return save_headless(argv[2], atoi(argv[3]));
+    }
+    if(argc > 2 && strcmp(argv[1], "-replay") == 0)
+    {
+        return replay_headless(argv[2], argc > 3 && strcmp(argv[3], "-realtime") == 0);
+    }
 
     glutInit(&argc, argv);
+    //the grid is resized between frames, so only with a window
+    governor.setResizeHook(request_resize, NULL);
+
+    if(argc > 2 && strcmp(argv[1], "-play") == 0)
+    {
+        if(!player.open(argv[2], "GridStable")) return 1;
+        play_on = 1;
+        play_frame = -1;
+        play_step(1);
+    }
+    //resume from a checkpoint given on the command line
+    else if(argc > 1 && !solver->loadCheckpoint(argv[1])) return 1;
+
+    //playback sets the fields itself, there is nothing to simulate; otherwise the window
+    //draws a copy of the solver unless it steps once a frame on this thread
+    step_clock.setFrameRate(fps);
+    if(!play_on && (threaded || rate > 0.0))
+    {
+        view = new StableSolver();
+        view->init(solver->getRowSize(), solver->getColSize());
+        view->reset();
+        //snapshots of the view name the relaxation the solver runs
+        view->matchRelax(solver->getRelaxConfig());
+        if(threaded)
+        {
+            sim.start(feed_input, sim_step, sim_publish, NULL, solver->getFrameSize(), rate > 0.0 ? 1.0/rate : 1.0/60.0);
+        }
+        else
+        {
+            for(int k=0; k<3; k++)
+            {
+                step_frames[k] = (float *)malloc(sizeof(float)*solver->getFrameSize());
+                solver->saveFrame(step_frames[k]);
+            }
+            //a frame pays out at most four steps, a machine too slow for the rate runs slower
+            step_clock.start(rate, 4);
+        }
+    }
+
     glutInitDisplayMode(GLUT_RGBA | GLUT_DOUBLE);
     glutInitWindowPosition(0, 0);
     glutInitWindowSize(win_x, win_y);
     glutCreateWindow("StableFluid2D");
 
+    fit_display();
+
     glutKeyboardFunc(key_func);
     glutMouseFunc(mouse_func);
     glutMotionFunc(motion_func);
@@ -20,9 +20,16 @@
  */
 
 #include "MacStableSolver.h"
+#include "ColorMap.h"
+#include "Checkpoint.h"
+#include "AutoTune.h"
+#include "Tracer.h"
+#include "Resample.h"
+#include "Courant.h"
 #include <stdio.h>
 #include <stdlib.h>
 #include <string.h>
+#include <math.h>
 
 #define SWAP(value0,value) {float *tmp=value0;value0=value;value=tmp;}
 
@@ -32,13 +39,38 @@ StableSolver::StableSolver()
 
 StableSolver::~StableSolver()
 {
+    release();
+}
+
+void StableSolver::init(int _rowCell, int _colCell)
+{
+    //params
+    running = 1;
+    timeStep = 1.0f;
+    diff = 0.0f;
+    visc = 0.0f;
+    iterations = 20;
+
+    //pipelined stepping
+    pipelined = 0;
 
+    //multi-rate stepping
+    velInterval = 1;
+    velBlend = 1;
+    velPhase = 0;
+
+    //adaptive stepping
+    adaptCFL = 0.0f;
+    adaptInterval = 1.0f;
+    velMax = 0.0f;
+
+    allocate(_rowCell, _colCell);
 }
 
-void StableSolver::init()
+void StableSolver::allocate(int _rowCell, int _colCell)
 {
-    rowCell = 128;
-    colCell = 128;
+    rowCell = _rowCell;
+    colCell = _colCell;
     totCell = rowCell*colCell;
     rowVelX = rowCell+1;
     colVelX = colCell;
@@ -51,12 +83,6 @@ void StableSolver::init()
     minY = 0.0f;
     maxY = (float)colCell;
 
-    //params
-    running = 1;
-    timeStep = 1.0f;
-    diff = 0.0f;
-    visc = 0.0f;
-
     vx = (float *)malloc(sizeof(float)*totVelX);
     vy = (float *)malloc(sizeof(float)*totVelY);
     vx0 = (float *)malloc(sizeof(float)*totVelX);
@@ -68,6 +94,16 @@ void StableSolver::init()
     pvx = (Vec2f *)malloc(sizeof(Vec2f)*totVelX);
     pvy = (Vec2f *)malloc(sizeof(Vec2f)*totVelY);
 
+    //pipelined stepping
+    pipeVX = (float *)malloc(sizeof(float)*totVelX);
+    pipeVY = (float *)malloc(sizeof(float)*totVelY);
+
+    //multi-rate stepping
+    multiVX0 = (float *)malloc(sizeof(float)*totVelX);
+    multiVY0 = (float *)malloc(sizeof(float)*totVelY);
+    multiVX = (float *)malloc(sizeof(float)*totVelX);
+    multiVY = (float *)malloc(sizeof(float)*totVelY);
+
     for(int i=0; i<rowVelX; i++)
     {
         for(int j=0; j<colVelX; j++)
@@ -85,6 +121,82 @@ void StableSolver::init()
             pvy[vyIdx(i, j)].y = (float)j;
         }
     }
+
+    //changes below half a color level wait until they add up
+    dirty.init(rowCell, colCell, 16, 0.5f/255.0f);
+}
+
+void StableSolver::release()
+{
+    free(vx);
+    free(vy);
+    free(vx0);
+    free(vy0);
+    free(d);
+    free(d0);
+    free(div);
+    free(p);
+    free(pvx);
+    free(pvy);
+
+    free(pipeVX);
+    free(pipeVY);
+
+    free(multiVX0);
+    free(multiVY0);
+    free(multiVX);
+    free(multiVY);
+}
+
+int StableSolver::resize(int newRowCell, int newColCell)
+{
+    if(newRowCell < 4 || newColCell < 4)
+    {
+        fprintf(stderr, "resize: a %dx%d grid is too small\n", newRowCell, newColCell);
+        return 0;
+    }
+    if(newRowCell == rowCell && newColCell == colCell) return 1;
+    TraceScope scope("resize");
+
+    //the fields that carry over, everything else is worked out again each step
+    int oldRowCell = rowCell;
+    int oldColCell = colCell;
+    float *oldVX = vx;
+    float *oldVY = vy;
+    float *oldD = d;
+    vx = NULL;
+    vy = NULL;
+    d = NULL;
+    release();
+    allocate(newRowCell, newColCell);
+
+    //vx sits on the left faces, vy on the bottom ones and d on the cell centers;
+    //velocities are in cells a step, so they scale with the cells
+    FieldGrid oldGridX = {oldRowCell+1, oldColCell, 0.0f, 0.5f, oldRowCell, oldColCell};
+    FieldGrid newGridX = {rowVelX, colVelX, 0.0f, 0.5f, rowCell, colCell};
+    FieldGrid oldGridY = {oldRowCell, oldColCell+1, 0.5f, 0.0f, oldRowCell, oldColCell};
+    FieldGrid newGridY = {rowVelY, colVelY, 0.5f, 0.0f, rowCell, colCell};
+    FieldGrid oldGrid = {oldRowCell, oldColCell, 0.5f, 0.5f, oldRowCell, oldColCell};
+    FieldGrid newGrid = {rowCell, colCell, 0.5f, 0.5f, rowCell, colCell};
+    resampleField(vx, newGridX, oldVX, oldGridX, RESAMPLE_BILINEAR, (float)rowCell/oldRowCell, 0.0f);
+    resampleField(vy, newGridY, oldVY, oldGridY, RESAMPLE_BILINEAR, (float)colCell/oldColCell, 0.0f);
+    resampleField(d, newGrid, oldD, oldGrid, RESAMPLE_CONSERVATIVE, 1.0f, 0.0f);
+    free(oldVX);
+    free(oldVY);
+    free(oldD);
+
+    //interpolation leaves the velocity slightly divergent
+    setVelBoundary(1);
+    setVelBoundary(2);
+    setCellBoundary(d);
+    projection();
+
+    cleanBuffer();
+    memcpy(pipeVX, vx, sizeof(float)*totVelX);
+    memcpy(pipeVY, vy, sizeof(float)*totVelY);
+    velPhase = 0;
+    dirty.markAll();
+    return 1;
 }
 
 void StableSolver::reset()
@@ -92,6 +204,11 @@ void StableSolver::reset()
     for(int i=0; i<totCell; i++) d[i] = 0.0f;
     for(int i=0; i<totVelX; i++) vx[i] = 0.0f;
     for(int i=0; i<totVelY; i++) vy[i] = 0.0f;
+    for(int i=0; i<totVelX; i++) pipeVX[i] = 0.0f;
+    for(int i=0; i<totVelY; i++) pipeVY[i] = 0.0f;
+    velPhase = 0;
+    velMax = 0.0f;
+    dirty.markAll();
 }
 
 void StableSolver::cleanBuffer()
@@ -162,12 +279,13 @@ void StableSolver::setCellBoundary(float *value)
 
 void StableSolver::projection()
 {
+    TraceScope scope("projection");
     int static count=0;
     for(int i=1; i<=rowCell-2; i++)
     {
         for(int j=1; j<=colCell-2; j++)
         {
-            div[cIdx(i, j)] = (vx[vxIdx(i+1, j)]-vx[vxIdx(i, j)]+vy[vyIdx(i, j+1)]-vy[vyIdx(i, j)]);
+            div[cIdx(i, j)] = -(vx[vxIdx(i+1, j)]-vx[vxIdx(i, j)]+vy[vyIdx(i, j+1)]-vy[vyIdx(i, j)]);
             p[cIdx(i, j)] = 0.0f;
         }
     }
@@ -176,39 +294,39 @@ void StableSolver::projection()
     setCellBoundary(div);
 
     //projection iteration
-    for(int k=0; k<20; k++)
+    for(int k=0; k<iterations; k++)
     {
-        for(int i=1; i<=rowCell-2; i++)
-        {
-            for(int j=1; j<=colCell-2; j++)
-            {
-                p[cIdx(i, j)] = (p[cIdx(i+1, j)]+p[cIdx(i-1, j)]+p[cIdx(i, j+1)]+p[cIdx(i, j-1)]-div[cIdx(i, j)])/4.0f;
-            }
-        }
+        relax.sweep(p, div, rowCell, 1, rowCell-2, 1, colCell-2, 1.0f, 4.0f);
         setCellBoundary(p);
     }
 
-    //velocity minus grad of Pressure
-    for(int i=1; i<=rowVelX-2; i++)
+    //velocity minus grad of Pressure, row by row so the fastest velocity is
+    //picked up while the row is still in cache; the walls only copy the interior
+    float fastest = 0.0f;
+    for(int j=1; j<=colVelX-2; j++)
     {
-        for(int j=1; j<=colVelX-2; j++)
+        for(int i=1; i<=rowVelX-2; i++)
         {
             vx[vxIdx(i, j)] -= (p[cIdx(i, j)]-p[cIdx(i-1, j)]);
         }
+        fastest = maxMagnitude(vx+vxIdx(1, j), rowVelX-2, fastest);
     }
-    for(int i=1; i<=rowVelY-2; i++)
+    for(int j=1; j<=colVelY-2; j++)
     {
-        for(int j=1; j<=colVelY-2; j++)
+        for(int i=1; i<=rowVelY-2; i++)
         {
             vy[vyIdx(i, j)] -= (p[cIdx(i, j)]-p[cIdx(i, j-1)]);
         }
+        fastest = maxMagnitude(vy+vyIdx(1, j), rowVelY-2, fastest);
     }
+    velMax = fastest;
     setVelBoundary(1);
     setVelBoundary(2);
 }
 
 void StableSolver::advectVel()
 {
+    TraceScope scope("advectVel");
     for(int i=1; i<=rowVelX-2; i++)
     {
         for(int j=1; j<=colVelX-2; j++)
@@ -275,8 +393,11 @@ void StableSolver::advectVel()
     setVelBoundary(2);
 }
 
-void StableSolver::advectCell(float *value, float *value0)
+void StableSolver::advectCell(float *value, float *value0, float *u, float *v)
 {
+    TraceScope scope("advectCell");
+    if(u == NULL) u = vx;
+    if(v == NULL) v = vy;
     float oldX;
     float oldY;
     int i0;
@@ -292,8 +413,8 @@ void StableSolver::advectCell(float *value, float *value0)
     {
         for(int j=1; j<=colCell-2; j++)
         {
-            float cvx = getCellVel(i, j).x;
-            float cvy = getCellVel(i, j).y;
+            float cvx = (u[vxIdx(i, j)]+u[vxIdx(i+1, j)])/2;
+            float cvy = (v[vyIdx(i, j)]+v[vyIdx(i, j+1)])/2;
 
             oldX = (float)i+0.5f - cvx*timeStep;
             oldY = (float)j+0.5f - cvy*timeStep;
@@ -318,33 +439,22 @@ void StableSolver::advectCell(float *value, float *value0)
         }
     }
     
-    setCellBoundary(d);
+    setCellBoundary(value);
 }
 
 void StableSolver::diffuseVel()
 {
+    TraceScope scope("diffuseVel");
     for(int i=0; i<totVelX; i++) vx[i] = 0.0f;
     for(int i=0; i<totVelY; i++) vy[i] = 0.0f;
     float a = diff*timeStep;
 
-    for(int k=0; k<20; k++)
+    for(int k=0; k<iterations; k++)
     {
         //diffuse velX
-        for(int i=1; i<=rowVelX-2; i++)
-        {
-            for(int j=1; j<=colVelX-2; j++)
-            {
-                vx[vxIdx(i, j)] = (vx0[vxIdx(i, j)]+a*(vx[vxIdx(i+1, j)]+vx[vxIdx(i-1, j)]+vx[vxIdx(i, j+1)]+vx[vxIdx(i, j-1)])) / (4.0f*a+1.0f);
-            }
-        }
+        relax.sweep(vx, vx0, rowVelX, 1, rowVelX-2, 1, colVelX-2, a, 4.0f*a+1.0f);
         //diffuse velY
-        for(int i=1; i<=rowVelY-2; i++)
-        {
-            for(int j=1; j<=colVelY-2; j++)
-            {
-                vy[vyIdx(i, j)] = (vy0[vyIdx(i, j)]+a*(vy[vyIdx(i+1, j)]+vy[vyIdx(i-1, j)]+vy[vyIdx(i, j+1)]+vy[vyIdx(i, j-1)])) / (4.0f*a+1.0f);
-            }
-        }
+        relax.sweep(vy, vy0, rowVelY, 1, rowVelY-2, 1, colVelY-2, a, 4.0f*a+1.0f);
 
         //boundary
         setVelBoundary(1);
@@ -352,29 +462,37 @@ void StableSolver::diffuseVel()
     }
 }
 
-void StableSolver::diffuseCell(float *value, float *value0)
+void StableSolver::diffuseCell(float *value, float *value0, Relax *solve)
 {
+    TraceScope scope("diffuseCell");
+    if(solve == NULL) solve = &relax;
     for(int i=0; i<totCell; i++) value[i] = 0.0f;
     float a = visc*timeStep;
 
-    for(int k=0; k<20; k++)
+    for(int k=0; k<iterations; k++)
     {
-        for(int i=1; i<=rowCell-2; i++)
-        {
-            for(int j=1; j<=colCell-2; j++)
-            {
-                value[cIdx(i, j)] = (value0[cIdx(i, j)]+a*(value[cIdx(i+1, j)]+value[cIdx(i-1, j)]+value[cIdx(i, j+1)]+value[cIdx(i, j-1)])) / (4.0f*a+1.0f);
-            }
-        }
+        solve->sweep(value, value0, rowCell, 1, rowCell-2, 1, colCell-2, a, 4.0f*a+1.0f);
         setCellBoundary(value);
     }
 }
 
 void StableSolver::addSource()
 {
+    TraceScope scope("addSource");
     for(int i=0; i<totCell; i++) d[i] += d0[i];
-    for(int i=0; i<totVelX; i++) vx[i] += vx0[i];
-    for(int i=0; i<totVelY; i++) vy[i] += vy0[i];
+    float fastest = 0.0f;
+    for(int j=0; j<colVelX; j++)
+    {
+        for(int i=0; i<rowVelX; i++) vx[vxIdx(i, j)] += vx0[vxIdx(i, j)];
+        fastest = maxMagnitude(vx+vxIdx(0, j), rowVelX, fastest);
+    }
+    for(int j=0; j<colVelY; j++)
+    {
+        for(int i=0; i<rowVelY; i++) vy[vyIdx(i, j)] += vy0[vyIdx(i, j)];
+        fastest = maxMagnitude(vy+vyIdx(0, j), rowVelY, fastest);
+    }
+    velMax = fastest;
+    dirty.track(d0, NULL);
 
     setVelBoundary(1);
     setVelBoundary(2);
@@ -383,6 +501,7 @@ void StableSolver::addSource()
 
 void StableSolver::animVel()
 {
+    TraceScope scope("animVel");
     projection();
 
     if(diff > 0.0f)
@@ -401,12 +520,275 @@ void StableSolver::animVel()
 
 void StableSolver::animDen()
 {
+    transportDen(vx, vy, &relax);
+}
+
+void StableSolver::transportDen(float *u, float *v, Relax *solve)
+{
+    TraceScope scope("animDen");
     if(visc > 0.0f)
     {
         SWAP(d0, d);
-        diffuseCell(d, d0);
+        diffuseCell(d, d0, solve);
+        dirty.track(d, d0);
     }
 
     SWAP(d0, d);
-    advectCell(d, d0);
+    advectCell(d, d0, u, v);
+    dirty.track(d, d0);
+}
+
+void StableSolver::setPipelined(int on)
+{
+    if(on == pipelined) return;
+    pipelined = on;
+
+    //the red-black threads go half to each half of the step
+    RelaxConfig config = relax.getConfig();
+    RelaxConfig scalarConfig = config;
+    if(pipelined)
+    {
+        scalarConfig.threads = config.threads/2 > 0 ? config.threads/2 : 1;
+        config.threads = config.threads-scalarConfig.threads > 0 ? config.threads-scalarConfig.threads : 1;
+        pipeline.init(2);
+        memcpy(pipeVX, vx, sizeof(float)*totVelX);
+        memcpy(pipeVY, vy, sizeof(float)*totVelY);
+    }
+    else
+    {
+        config.threads += scalarRelax.getConfig().threads;
+        scalarConfig.threads = 1;
+    }
+    relax.setConfig(config);
+    scalarRelax.setConfig(scalarConfig);
+}
+
+//index 0 is the velocity half, 1 the density half
+void StableSolver::pipelineHalf(void *arg, int begin, int end)
+{
+    StableSolver *solver = (StableSolver *)arg;
+    for(int k=begin; k<end; k++)
+    {
+        if(k == 0) solver->animVel();
+        else solver->transportDen(solver->pipeVX, solver->pipeVY, &solver->scalarRelax);
+    }
+}
+
+void StableSolver::animPipelined()
+{
+    TraceScope scope("animPipelined");
+    pipeline.run(pipelineHalf, this, 2, 1);
+
+    //the density of the next step moves on the velocity just finished
+    memcpy(pipeVX, vx, sizeof(float)*totVelX);
+    memcpy(pipeVY, vy, sizeof(float)*totVelY);
+}
+
+void StableSolver::setVelInterval(int steps, int blend)
+{
+    velInterval = steps > 1 ? steps : 1;
+    velBlend = blend;
+    velPhase = 0;
+}
+
+void StableSolver::animMultiRate()
+{
+    TraceScope scope("animMultiRate");
+    if(velPhase == 0)
+    {
+        memcpy(multiVX0, vx, sizeof(float)*totVelX);
+        memcpy(multiVY0, vy, sizeof(float)*totVelY);
+
+        //one velocity step covers the whole interval
+        float step = timeStep;
+        timeStep = step*velInterval;
+        animVel();
+        timeStep = step;
+    }
+
+    if(velBlend)
+    {
+        //the velocity halfway through this step
+        float alpha = (velPhase+0.5f)/velInterval;
+        for(int i=0; i<totVelX; i++) multiVX[i] = multiVX0[i]+alpha*(vx[i]-multiVX0[i]);
+        for(int i=0; i<totVelY; i++) multiVY[i] = multiVY0[i]+alpha*(vy[i]-multiVY0[i]);
+        transportDen(multiVX, multiVY, &relax);
+    }
+    else transportDen(vx, vy, &relax);
+
+    velPhase = (velPhase+1)%velInterval;
+}
+
+void StableSolver::setAdaptive(float cfl, float interval)
+{
+    adaptCFL = cfl > 0.0f ? cfl : 0.0f;
+    adaptInterval = interval > 0.0f ? interval : 1.0f;
+}
+
+void StableSolver::animAdaptive()
+{
+    TraceScope scope("animAdaptive");
+    float step = timeStep;
+    float remaining = adaptInterval;
+
+    //the substeps are worked out again after each one, the velocity they go by
+    //is the one the last projection left
+    for(int left=COURANT_MAX_SUBSTEPS; left>0; left--)
+    {
+        int steps = courantSteps(remaining, velMax, adaptCFL, left);
+        timeStep = remaining/steps;
+        animVel();
+        animDen();
+        if(steps == 1) break;
+        remaining -= timeStep;
+    }
+    timeStep = step;
+}
+
+void StableSolver::matchRelax(RelaxConfig config)
+{
+    RelaxConfig own = relax.getConfig();
+    own.scheme = config.scheme;
+    own.bandRows = config.bandRows;
+    relax.setConfig(own);
+
+    RelaxConfig scalar = scalarRelax.getConfig();
+    scalar.scheme = config.scheme;
+    scalar.bandRows = config.bandRows;
+    scalarRelax.setConfig(scalar);
+}
+
+void StableSolver::tuneRelax(const char *cachePath)
+{
+    RelaxConfig config;
+    autoTuneRelax("MacStable", rowCell, colCell, cachePath, AUTOTUNE_BUDGET, &config);
+    relax.setConfig(config);
+}
+
+void StableSolver::fillDensImage(unsigned char *pixels)
+{
+    vertexDensityToRGBA(d, rowCell, getImgWidth(), getImgHeight(), pixels, getImgWidth());
+}
+
+void StableSolver::fillDensImage(unsigned char *pixels, DirtyRect rect)
+{
+    vertexDensityToRGBA(d+cIdx(rect.x0, rect.y0), rowCell, rect.x1-rect.x0+1, rect.y1-rect.y0+1,
+                        pixels+(rect.y0*getImgWidth()+rect.x0)*4, getImgWidth());
+}
+
+void StableSolver::fillSpeedImage(unsigned char *pixels, float scale)
+{
+    int width = getImgWidth();
+    float *speed = (float *)malloc(sizeof(float)*width);
+
+    //faces meeting at vertex (i, j): vx at (i, j-1) and (i, j), vy at (i-1, j) and (i, j)
+    for(int j=1; j<=colCell-1; j++)
+    {
+        for(int i=1; i<=rowCell-1; i++)
+        {
+            float u = (vx[vxIdx(i, j-1)]+vx[vxIdx(i, j)])/2;
+            float v = (vy[vyIdx(i-1, j)]+vy[vyIdx(i, j)])/2;
+            speed[i-1] = sqrt(u*u+v*v)*scale;
+        }
+        densityToRGBA(speed, pixels+(j-1)*width*4, width);
+    }
+
+    free(speed);
+}
+
+void StableSolver::saveFrame(float *frame)
+{
+    memcpy(frame, vx, sizeof(float)*totVelX);
+    frame += totVelX;
+    memcpy(frame, vy, sizeof(float)*totVelY);
+    frame += totVelY;
+    memcpy(frame, d, sizeof(float)*totCell);
+}
+
+void StableSolver::loadFrame(const float *frame)
+{
+    memcpy(vx, frame, sizeof(float)*totVelX);
+    frame += totVelX;
+    memcpy(vy, frame, sizeof(float)*totVelY);
+    frame += totVelY;
+    //only the tiles that differ from the last frame are uploaded again
+    dirty.track(frame, d);
+    memcpy(d, frame, sizeof(float)*totCell);
+}
+
+void StableSolver::fillCheckpoint(CheckpointWriter *writer)
+{
+    writer->setSolver("MacStable");
+    writer->addParam("rowCell", rowCell);
+    writer->addParam("colCell", colCell);
+    writer->addParam("timeStep", timeStep);
+    writer->addParam("diff", diff);
+    writer->addParam("visc", visc);
+    writer->addParam("relaxScheme", relax.getConfig().scheme);
+    writer->addParam("relaxBandRows", relax.getConfig().bandRows);
+    writer->addField("vx", vx, rowVelX, colVelX);
+    writer->addField("vy", vy, rowVelY, colVelY);
+    writer->addField("d", d, rowCell, colCell);
+}
+
+int StableSolver::saveCheckpoint(const char *path)
+{
+    CheckpointWriter writer;
+    fillCheckpoint(&writer);
+    return writer.write(path);
+}
+
+int StableSolver::loadCheckpoint(const char *path, int keepSize)
+{
+    CheckpointReader reader;
+    if(!reader.open(path, "MacStable")) return 0;
+
+    //the grid it was saved on, another run's or this one's before a resize
+    double value;
+    int newRowCell = reader.getParam("rowCell", &value) ? (int)value : rowCell;
+    int newColCell = reader.getParam("colCell", &value) ? (int)value : colCell;
+    if(keepSize && (newRowCell != rowCell || newColCell != colCell))
+    {
+        fprintf(stderr, "%s: checkpoint is %dx%d, the grid has to stay %dx%d\n", path, newRowCell, newColCell, rowCell, colCell);
+        return 0;
+    }
+
+    //nothing changes unless every field fits that grid
+    if(newRowCell < 4 || newColCell < 4 || !reader.getField("vx", newRowCell+1, newColCell) ||
+       !reader.getField("vy", newRowCell, newColCell+1) || !reader.getField("d", newRowCell, newColCell))
+    {
+        fprintf(stderr, "%s: checkpoint does not hold a %dx%d grid\n", path, newRowCell, newColCell);
+        return 0;
+    }
+    if(newRowCell != rowCell || newColCell != colCell)
+    {
+        release();
+        allocate(newRowCell, newColCell);
+        cleanBuffer();
+    }
+
+    if(reader.getParam("timeStep", &value)) timeStep = (float)value;
+    if(reader.getParam("diff", &value)) diff = (float)value;
+    if(reader.getParam("visc", &value)) visc = (float)value;
+
+    //resumes with the relaxation it was saved with
+    double bandRows;
+    if(reader.getParam("relaxScheme", &value) && reader.getParam("relaxBandRows", &bandRows))
+    {
+        RelaxConfig config = relax.getConfig();
+        config.scheme = (int)value;
+        config.bandRows = (int)bandRows;
+        matchRelax(config);
+    }
+
+    reader.readField("vx", vx, rowVelX, colVelX);
+    reader.readField("vy", vy, rowVelY, colVelY);
+    reader.readField("d", d, rowCell, colCell);
+    memcpy(pipeVX, vx, sizeof(float)*totVelX);
+    memcpy(pipeVY, vy, sizeof(float)*totVelY);
+    velPhase = 0;
+    velMax = maxMagnitude(vy, totVelY, maxMagnitude(vx, totVelX, 0.0f));
+
+    dirty.markAll();
+    return 1;
 }
@@ -23,15 +23,22 @@
 #define __MACSTABLESOLVER_H__
 
 #include "Vector2f.h"
+#include "DirtyTiles.h"
+#include "Relax.h"
 #include <stdio.h>
 
+class CheckpointWriter;
+
 class StableSolver
 {
 public:
     StableSolver();
     ~StableSolver();
-    void init();
+    void init(int _rowCell, int _colCell);
     void reset();
+    //resamples the velocity and density onto a newRowCell x newColCell grid and
+    //projects again, the picture carries on at the new size; returns 1 on success
+    int resize(int newRowCell, int newColCell);
     void cleanBuffer();
     void start(){ running=1; }
     void stop(){ running=0; }
@@ -42,12 +49,51 @@ public:
     void setCellBoundary(float *value);
     void projection();
     void advectVel();
-    void advectCell(float *value, float *value0);
+    //u, v are the face velocities to move on, NULL for vx, vy
+    void advectCell(float *value, float *value0, float *u=NULL, float *v=NULL);
     void diffuseVel();
-    void diffuseCell(float *value, float *value0);
+    //solve is the relaxation to iterate with, NULL for the solver's own
+    void diffuseCell(float *value, float *value0, Relax *solve=NULL);
     void addSource();
     void animVel();
     void animDen();
+    //pipelined stepping, the density of step n moves on pipeVX/pipeVY on its own
+    //threads while the velocity of step n+1 is computed, so it lags one step
+    //behind the velocity. set once the relaxation is configured, it splits
+    //the relaxation threads between the two halves
+    void setPipelined(int on);
+    int isPipelined(){ return pipelined; }
+    //animVel next to animDen, what step_solver does in turn
+    void animPipelined();
+    //multi-rate stepping, the velocity moves every steps steps, a whole interval
+    //at a time, and the density every step on the velocity blended from the start
+    //to the end of the interval, or on the end velocity held if blend is 0
+    void setVelInterval(int steps, int blend);
+    int getVelInterval(){ return velInterval; }
+    //animVel when an interval starts, animDen every step
+    void animMultiRate();
+    //adaptive stepping, every step covers interval units of time in as few substeps
+    //as keep the velocity under cfl cells a substep; cfl 0 steps timeStep as ever
+    void setAdaptive(float cfl, float interval);
+    float getCFL(){ return adaptCFL; }
+    //animVel+animDen once per substep
+    void animAdaptive();
+    //relaxation of the diffusion and pressure solves
+    void setRelaxConfig(RelaxConfig config){ relax.setConfig(config); }
+    RelaxConfig getRelaxConfig(){ return relax.getConfig(); }
+    //the scheme and band rows of config on this solver's own threads; the scheme
+    //decides the numbers a step gives, the threads do not
+    void matchRelax(RelaxConfig config);
+    //sweeps per diffusion and pressure solve, 20 unless traded for time
+    void setIterations(int value){ iterations = value; }
+    //the fastest relaxation for this grid, timed once per machine and kept in cachePath
+    void tuneRelax(const char *cachePath);
+
+    //checkpoint, returns 1 on success; a checkpoint of another size brings its grid
+    //along unless keepSize is set
+    void fillCheckpoint(CheckpointWriter *writer);
+    int saveCheckpoint(const char *path);
+    int loadCheckpoint(const char *path, int keepSize=0);
 
     //getter
     int getRowCell(){ return rowCell; }
@@ -64,12 +110,27 @@ public:
     float* getD(){ return d;}
     Vec2f* getPVX(){ return pvx; }
     Vec2f* getPVY(){ return pvy; }
+    //the largest face velocity as of the last projection or addSource
+    float getVelMax(){ return velMax; }
     int vxIdx(int i, int j){ return j*rowVelX+i; }
     int vyIdx(int i, int j){ return j*rowVelY+i; }
     int cIdx(int i, int j){ return j*rowCell+i; }
     Vec2f getCellVel(int i, int j){ return Vec2f((vx[vxIdx(i, j)]+vx[vxIdx(i+1, j)])/2, (vy[vyIdx(i, j)]+vy[vyIdx(i, j+1)])/2); }
     float getDens(int i, int j){ return (d[cIdx(i-1, j-1)]+d[cIdx(i, j-1)]+d[cIdx(i-1, j)]+d[cIdx(i, j)])/4.0f; }
 
+    //display, one RGBA8 pixel per grid vertex 1..rowCell-1 x 1..colCell-1
+    int getImgWidth(){ return rowCell-1; }
+    int getImgHeight(){ return colCell-1; }
+    void fillDensImage(unsigned char *pixels);
+    void fillDensImage(unsigned char *pixels, DirtyRect rect);
+    void fillSpeedImage(unsigned char *pixels, float scale);
+    DirtyTiles* getDirty(){ return &dirty; }
+    //the fields the viewer draws packed into one frame, so a copy of the solver
+    //can be drawn while the solver itself goes on stepping
+    int getFrameSize(){ return totVelX+totVelY+totCell; }
+    void saveFrame(float *frame);
+    void loadFrame(const float *frame);
+
     //setter
     void setVel0(int i, int j, float _vx0, float _vy0)
     { 
@@ -79,6 +140,14 @@ public:
         vy0[vyIdx(i, j+1)] += _vy0;
     }
     void setD0(int i, int j, float _d0){ d0[cIdx(i, j)]=_d0; }
+    //rate the velocity diffuses at, cells^2 per step
+    void setViscosity(float value){ diff=value; }
+
+private:
+    void allocate(int _rowCell, int _colCell);
+    void release();
+    void transportDen(float *u, float *v, Relax *solve);
+    static void pipelineHalf(void *arg, int begin, int end);
 
 private:
     int rowCell;
@@ -100,6 +169,7 @@ private:
     float timeStep;
     float diff;
     float visc;
+    int iterations;
 
     float *vx;
     float *vy;
@@ -111,6 +181,31 @@ private:
     float *p;
     Vec2f *pvx;
     Vec2f *pvy;
+
+    //display regions changed by addSource/animDen
+    DirtyTiles dirty;
+    Relax relax;
+
+    //pipelined stepping
+    int pipelined;
+    float *pipeVX;
+    float *pipeVY;
+    ThreadPool pipeline;
+    Relax scalarRelax;
+
+    //multi-rate stepping
+    int velInterval;
+    int velBlend;
+    int velPhase;
+    float *multiVX0;
+    float *multiVY0;
+    float *multiVX;
+    float *multiVY;
+
+    //adaptive stepping
+    float adaptCFL;
+    float adaptInterval;
+    float velMax;
 };
 
 #endif
@@ -0,0 +1,118 @@
+/** File:    bench.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+//"make bench" times every kernel of the solver on its own, see KernelBench.h for the options
+
+#include "MacStableSolver.h"
+#include "KernelBench.h"
+#include <stdlib.h>
+#include <math.h>
+
+StableSolver *solver;
+float *field;
+float *field0;
+
+//a smooth swirl of a couple of cells per step, so advection samples all over the grid
+void init_fields(int size)
+{
+    float *vx = solver->getVX();
+    float *vy = solver->getVY();
+    float *d = solver->getD();
+    for(int j=0; j<size; j++)
+    {
+        for(int i=0; i<=size; i++)
+        {
+            float x = 6.2831853f*i/size;
+            float y = 6.2831853f*(j+0.5f)/size;
+            vx[solver->vxIdx(i, j)] = 2.0f*sinf(y)*cosf(x);
+        }
+    }
+    for(int j=0; j<=size; j++)
+    {
+        for(int i=0; i<size; i++)
+        {
+            float x = 6.2831853f*(i+0.5f)/size;
+            float y = 6.2831853f*j/size;
+            vy[solver->vyIdx(i, j)] = -2.0f*sinf(x)*cosf(y);
+        }
+    }
+    for(int j=0; j<size; j++)
+    {
+        for(int i=0; i<size; i++)
+        {
+            float x = 6.2831853f*(i+0.5f)/size;
+            float y = 6.2831853f*(j+0.5f)/size;
+            d[solver->cIdx(i, j)] = 0.5f+0.5f*sinf(3.0f*x)*sinf(2.0f*y);
+            field0[solver->cIdx(i, j)] = d[solver->cIdx(i, j)];
+            field[solver->cIdx(i, j)] = 0.0f;
+        }
+    }
+}
+
+void bench_advectVel(void *arg){ solver->advectVel(); }
+void bench_advectCell(void *arg){ solver->advectCell(field, field0); }
+void bench_diffuseVel(void *arg){ solver->diffuseVel(); }
+void bench_diffuseCell(void *arg){ solver->diffuseCell(field, field0); }
+void bench_projection(void *arg){ solver->projection(); }
+void bench_setVelBoundary(void *arg){ solver->setVelBoundary(1); solver->setVelBoundary(2); }
+void bench_setCellBoundary(void *arg){ solver->setCellBoundary(field); }
+void bench_addSource(void *arg){ solver->addSource(); }
+
+int main(int argc, char **argv)
+{
+    KernelBench bench;
+    if(!bench.parseArgs(argc, argv)) return 1;
+    if(!bench.begin("MacStable")) return 1;
+
+    for(int k=0; k<bench.getNumSizes(); k++)
+    {
+        int size = bench.getSize(k);
+        double cells = (double)(size-2)*(size-2);
+
+        solver = new StableSolver();
+        solver->init(size, size);
+        RelaxConfig relax;
+        if(bench.getRelax(&relax)) solver->setRelaxConfig(relax);
+        solver->reset();
+        solver->cleanBuffer();
+        field = (float *)malloc(sizeof(float)*size*size);
+        field0 = (float *)malloc(sizeof(float)*size*size);
+        init_fields(size);
+
+        //bytes per cell are what each kernel has to read and write at least, flops count
+        //every add, multiply, divide and square root of its inner loop; a sweep is 6,
+        //three adds over the neighbours, the multiply by a, the add of b and the divide.
+        //velocity kernels count both faces of a cell
+        bench.run("advectVel", size, cells, 2*(8+4+4+4), 2*22, bench_advectVel, NULL);
+        bench.run("advectCell", size, cells, 16, 27, bench_advectCell, NULL);
+        bench.run("diffuseVel", size, cells, 2*(4+20*12), 2*20*6, bench_diffuseVel, NULL);
+        bench.run("diffuseCell", size, cells, 4+20*12, 20*6, bench_diffuseCell, NULL);
+        bench.run("projection", size, cells, 16+20*12+20, 4+20*6+4, bench_projection, NULL);
+        bench.run("setVelBoundary", size, 8.0*size, 8, 0, bench_setVelBoundary, NULL);
+        bench.run("setCellBoundary", size, 4.0*size, 8, 0, bench_setCellBoundary, NULL);
+        bench.run("addSource", size, cells, 40, 3, bench_addSource, NULL);
+
+        free(field);
+        free(field0);
+        delete solver;
+    }
+    return bench.end() ? 0 : 1;
+}
@@ -0,0 +1,108 @@
+/** File:    scenario.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+//"make scenario" runs the canonical scenarios on the solver, see ScenarioBench.h for the options
+
+#include "MacStableSolver.h"
+#include "ScenarioBench.h"
+#include <stdlib.h>
+
+//fluid cell (i, j) of the scenario is cell (i+1, j+1), the outer ring holds the walls;
+//x faces sit on the left and y faces on the bottom of their cell
+StableSolver *solver;
+int n;
+
+void mac_reset(int _n, float visc)
+{
+    n = _n;
+    delete solver;
+    solver = new StableSolver();
+    solver->init(n+2, n+2);
+    solver->reset();
+    solver->cleanBuffer();
+    solver->setViscosity(visc);
+}
+
+void mac_setRelax(RelaxConfig config){ solver->setRelaxConfig(config); }
+
+void mac_setVelocity(VelocityFunc func, void *arg)
+{
+    float *vx = solver->getVX();
+    float *vy = solver->getVY();
+    float u;
+    float v;
+    for(int j=0; j<n; j++)
+    {
+        for(int i=0; i<=n; i++)
+        {
+            if(func(arg, (float)i, j+0.5f, &u, &v)) vx[solver->vxIdx(i+1, j+1)] = u;
+        }
+    }
+    for(int j=0; j<=n; j++)
+    {
+        for(int i=0; i<n; i++)
+        {
+            if(func(arg, i+0.5f, (float)j, &u, &v)) vy[solver->vyIdx(i+1, j+1)] = v;
+        }
+    }
+    solver->setVelBoundary(1);
+    solver->setVelBoundary(2);
+}
+
+void mac_addDensity(int i, int j, float value){ solver->setD0(i+1, j+1, value); }
+
+void mac_step()
+{
+    solver->addSource();
+    solver->animVel();
+    solver->animDen();
+    solver->cleanBuffer();
+}
+
+void mac_getVelocity(int i, int j, float *u, float *v)
+{
+    Vec2f vel = solver->getCellVel(i+1, j+1);
+    *u = vel.x;
+    *v = vel.y;
+}
+
+//net flow out through the faces of the cell, what projection() drives to zero
+float mac_getDivergence(int i, int j)
+{
+    float *vx = solver->getVX();
+    float *vy = solver->getVY();
+    return vx[solver->vxIdx(i+2, j+1)]-vx[solver->vxIdx(i+1, j+1)]+vy[solver->vyIdx(i+1, j+2)]-vy[solver->vyIdx(i+1, j+1)];
+}
+
+float mac_getDensity(int i, int j){ return solver->getD()[solver->cIdx(i+1, j+1)]; }
+
+int main(int argc, char **argv)
+{
+    ScenarioBench bench;
+    if(!bench.parseArgs(argc, argv)) return 1;
+    if(!bench.begin("MacStable")) return 1;
+
+    ScenarioSolver hooks = {mac_reset, mac_setRelax, mac_setVelocity, mac_addDensity, mac_step,
+                            mac_getVelocity, mac_getDivergence, mac_getDensity};
+    bench.run(&hooks);
+    delete solver;
+    return bench.end() ? 0 : 1;
+}
@@ -20,6 +20,12 @@
  */
 
 #include "StableSolver2D.h"
+#include "ColorMap.h"
+#include "Checkpoint.h"
+#include "AutoTune.h"
+#include "Tracer.h"
+#include "Resample.h"
+#include "Courant.h"
 #include <stdlib.h>
 #include <string.h>
 #include <stdio.h>
@@ -34,27 +40,53 @@ StableSolver2D::StableSolver2D()
     visc = 0.0f;
     force = 5.0f;
     source = 2.0f;
+    iterations = 20;
+    texDiffusion = 1;
+    pipelined = 0;
+    velInterval = 1;
+    velBlend = 1;
+    velPhase = 0;
+    adaptCFL = 0.0f;
+    adaptInterval = 1.0f;
+    velMax = 0.0f;
+
+    //nothing is allocated until reset
+    px = NULL;
+    py = NULL;
+    vx = NULL;
+    vy = NULL;
+    vx0 = NULL;
+    vy0 = NULL;
+    d = NULL;
+    d0 = NULL;
+    tx = NULL;
+    ty = NULL;
+    tx0 = NULL;
+    ty0 = NULL;
+    p = NULL;
+    div = NULL;
+    pipeVX = NULL;
+    pipeVY = NULL;
+    multiVX0 = NULL;
+    multiVY0 = NULL;
+    multiVX = NULL;
+    multiVY = NULL;
 }
 
 StableSolver2D::~StableSolver2D()
 {
-    free(px);
-    free(py);
-    free(vx);
-    free(vy);
-    free(vx0);
-    free(vy0);
-    free(d);
-    free(d0);
-    free(tx);
-    free(ty);
-    free(tx0);
-    free(ty0);
-    free(p);
-    free(div);
+    release();
 }
 
 void StableSolver2D::reset(int _rowSize, int _colSize)
+{
+    //a second reset used to leak the fields of the first
+    release();
+    allocate(_rowSize, _colSize);
+    clear();
+}
+
+void StableSolver2D::allocate(int _rowSize, int _colSize)
 {
     rowSize = _rowSize;
     colSize = _colSize;
@@ -86,12 +118,105 @@ void StableSolver2D::reset(int _rowSize, int _colSize)
     p   = (float *)malloc(sizeof(float)*totSize);
     div = (float *)malloc(sizeof(float)*totSize);
 
+    pipeVX = (float *)malloc(sizeof(float)*totSize);
+    pipeVY = (float *)malloc(sizeof(float)*totSize);
+
+    multiVX0 = (float *)malloc(sizeof(float)*totSize);
+    multiVY0 = (float *)malloc(sizeof(float)*totSize);
+    multiVX = (float *)malloc(sizeof(float)*totSize);
+    multiVY = (float *)malloc(sizeof(float)*totSize);
+
+    //changes below half a color level wait until they add up
+    dirty.init(rowSize+2, colSize+2, 16, 0.5f/255.0f);
+}
+
+void StableSolver2D::release()
+{
+    free(px);
+    free(py);
+    free(vx);
+    free(vy);
+    free(vx0);
+    free(vy0);
+    free(d);
+    free(d0);
+    free(tx);
+    free(ty);
+    free(tx0);
+    free(ty0);
+    free(p);
+    free(div);
+    free(pipeVX);
+    free(pipeVY);
+    free(multiVX0);
+    free(multiVY0);
+    free(multiVX);
+    free(multiVY);
+}
+
+int StableSolver2D::resize(int newRowSize, int newColSize)
+{
+    if(newRowSize < 4 || newColSize < 4)
+    {
+        fprintf(stderr, "resize: a %dx%d grid is too small\n", newRowSize, newColSize);
+        return 0;
+    }
+    if(newRowSize == rowSize && newColSize == colSize) return 1;
+    TraceScope scope("resize");
+
+    //the fields that carry over, everything else is worked out again each step
+    int oldRowSize = rowSize;
+    int oldColSize = colSize;
+    float *oldVX = vx;
+    float *oldVY = vy;
+    float *oldD = d;
+    float *oldTX = tx;
+    float *oldTY = ty;
+    vx = NULL;
+    vy = NULL;
+    d = NULL;
+    tx = NULL;
+    ty = NULL;
+    release();
+    allocate(newRowSize, newColSize);
     clear();
+
+    //every field sits on the cell centers, the interior starting one cell in;
+    //velocities are in cells a step and the texture coordinates are positions
+    //in cells from the grid corner, so both scale with the cells
+    float scaleX = (float)rowSize/oldRowSize;
+    float scaleY = (float)colSize/oldColSize;
+    FieldGrid oldGrid = {oldRowSize+2, oldColSize+2, -0.5f, -0.5f, oldRowSize, oldColSize};
+    FieldGrid newGrid = {rowSize+2, colSize+2, -0.5f, -0.5f, rowSize, colSize};
+    resampleField(vx, newGrid, oldVX, oldGrid, RESAMPLE_BILINEAR, scaleX, 0.0f);
+    resampleField(vy, newGrid, oldVY, oldGrid, RESAMPLE_BILINEAR, scaleY, 0.0f);
+    resampleField(d, newGrid, oldD, oldGrid, RESAMPLE_CONSERVATIVE, 1.0f, 0.0f);
+    resampleField(tx, newGrid, oldTX, oldGrid, RESAMPLE_BILINEAR, scaleX, minX*(1.0f-scaleX));
+    resampleField(ty, newGrid, oldTY, oldGrid, RESAMPLE_BILINEAR, scaleY, minY*(1.0f-scaleY));
+    free(oldVX);
+    free(oldVY);
+    free(oldD);
+    free(oldTX);
+    free(oldTY);
+
+    //interpolation leaves the velocity slightly divergent
+    setBoundary(vx, 1);
+    setBoundary(vy, 2);
+    setBoundary(d, 0);
+    setBoundary(tx, 0);
+    setBoundary(ty, 0);
+    projection();
+
+    memcpy(pipeVX, vx, sizeof(float)*totSize);
+    memcpy(pipeVY, vy, sizeof(float)*totSize);
+    return 1;
 }
 
 void StableSolver2D::clear()
 {
     int index;
+    velPhase = 0;
+    velMax = 0.0f;
 
     for(int i=0; i<rowSize+2; i++)
     {
@@ -113,6 +238,8 @@ void StableSolver2D::clear()
             ty0[index] = 0.0f;
             p[index] = 0.0f;
             div[index] = 0.0f;
+            pipeVX[index] = 0.0f;
+            pipeVY[index] = 0.0f;
         }
     }
 
@@ -129,18 +256,31 @@ void StableSolver2D::clear()
             ty[index] = j + 0.5f;
         }
     }
+
+    dirty.markAll();
 }
 
 void StableSolver2D::addSource()
 {
     if(running == 0) return;
+    TraceScope scope("addSource");
 
-    for(int i=0; i<totSize; i++)
+    int index;
+    float fastest = 0.0f;
+    for(int j=0; j<colSize+2; j++)
     {
-        vx[i] += vx0[i];
-        vy[i] += vy0[i];
-        d[i]  += d0[i];
+        for(int i=0; i<rowSize+2; i++)
+        {
+            index = getIndex(i, j);
+            vx[index] += vx0[index];
+            vy[index] += vy0[index];
+            d[index]  += d0[index];
+        }
+        fastest = maxMagnitude(vx+getIndex(0, j), rowSize+2, fastest);
+        fastest = maxMagnitude(vy+getIndex(0, j), rowSize+2, fastest);
     }
+    velMax = fastest;
+    dirty.track(d0, NULL);
 
     setBoundary(vx, 1);
     setBoundary(vy, 2);
@@ -151,6 +291,7 @@ void StableSolver2D::addSource()
 void StableSolver2D::anim_vel()
 {
     if(running == 0) return;
+    TraceScope scope("anim_vel");
 
     SWAP(vx0, vx); 
     SWAP(vy0, vy); 
@@ -171,27 +312,165 @@ void StableSolver2D::anim_vel()
 void StableSolver2D::anim_den()
 {
     if(running == 0) return;
+    transport_den(vx, vy, &relax);
+}
+
+void StableSolver2D::transport_den(float *u, float *v, Relax *solve)
+{
+    TraceScope scope("anim_den");
 
     SWAP(d0, d); 
-    advection(d, d0, vx, vy, 0);
+    advection(d, d0, u, v, 0);
+    dirty.track(d, d0);
 
     SWAP(d0, d); 
-    diffusion(d, d0, diff, 0);
+    diffusion(d, d0, diff, 0, solve);
+    dirty.track(d, d0);
 }
 
 void StableSolver2D::anim_tex()
 {
     if(running == 0) return;
+    transport_tex(vx, vy, &relax);
+}
+
+void StableSolver2D::transport_tex(float *u, float *v, Relax *solve)
+{
+    TraceScope scope("anim_tex");
 
     SWAP(tx0, tx); 
     SWAP(ty0, ty); 
-    advection(tx, tx0, vx, vy, 0);
-    advection(ty, ty0, vx, vy, 0);
+    advection(tx, tx0, u, v, 0);
+    advection(ty, ty0, u, v, 0);
+    if(!texDiffusion) return;
 
     SWAP(tx0, tx); 
     SWAP(ty0, ty);  
-    diffusion(tx, tx0, diff, 0);
-    diffusion(ty, ty0, diff, 0);
+    diffusion(tx, tx0, diff, 0, solve);
+    diffusion(ty, ty0, diff, 0, solve);
+}
+
+void StableSolver2D::setPipelined(int on)
+{
+    if(on == pipelined) return;
+    pipelined = on;
+
+    //the red-black threads go half to each half of the step
+    RelaxConfig config = relax.getConfig();
+    RelaxConfig scalarConfig = config;
+    if(pipelined)
+    {
+        scalarConfig.threads = config.threads/2 > 0 ? config.threads/2 : 1;
+        config.threads = config.threads-scalarConfig.threads > 0 ? config.threads-scalarConfig.threads : 1;
+        pipeline.init(2);
+        memcpy(pipeVX, vx, sizeof(float)*totSize);
+        memcpy(pipeVY, vy, sizeof(float)*totSize);
+    }
+    else
+    {
+        config.threads += scalarRelax.getConfig().threads;
+        scalarConfig.threads = 1;
+    }
+    relax.setConfig(config);
+    scalarRelax.setConfig(scalarConfig);
+}
+
+//index 0 is the velocity half, 1 the texture and density half
+void StableSolver2D::pipelineHalf(void *arg, int begin, int end)
+{
+    StableSolver2D *solver = (StableSolver2D *)arg;
+    for(int k=begin; k<end; k++)
+    {
+        if(k == 0) solver->anim_vel();
+        else
+        {
+            solver->transport_tex(solver->pipeVX, solver->pipeVY, &solver->scalarRelax);
+            solver->transport_den(solver->pipeVX, solver->pipeVY, &solver->scalarRelax);
+        }
+    }
+}
+
+void StableSolver2D::anim_pipelined()
+{
+    if(running == 0) return;
+    TraceScope scope("anim_pipelined");
+    pipeline.run(pipelineHalf, this, 2, 1);
+
+    //the texture and density of the next step move on the velocity just finished
+    memcpy(pipeVX, vx, sizeof(float)*totSize);
+    memcpy(pipeVY, vy, sizeof(float)*totSize);
+}
+
+void StableSolver2D::setVelInterval(int steps, int blend)
+{
+    velInterval = steps > 1 ? steps : 1;
+    velBlend = blend;
+    velPhase = 0;
+}
+
+void StableSolver2D::anim_multirate()
+{
+    if(running == 0) return;
+    TraceScope scope("anim_multirate");
+
+    if(velPhase == 0)
+    {
+        memcpy(multiVX0, vx, sizeof(float)*totSize);
+        memcpy(multiVY0, vy, sizeof(float)*totSize);
+
+        //one velocity step covers the whole interval
+        float step = time_step;
+        time_step = step*velInterval;
+        anim_vel();
+        time_step = step;
+    }
+
+    float *u = vx;
+    float *v = vy;
+    if(velBlend)
+    {
+        //the velocity halfway through this step
+        float alpha = (velPhase+0.5f)/velInterval;
+        for(int i=0; i<totSize; i++)
+        {
+            multiVX[i] = multiVX0[i]+alpha*(vx[i]-multiVX0[i]);
+            multiVY[i] = multiVY0[i]+alpha*(vy[i]-multiVY0[i]);
+        }
+        u = multiVX;
+        v = multiVY;
+    }
+    transport_tex(u, v, &relax);
+    transport_den(u, v, &relax);
+
+    velPhase = (velPhase+1)%velInterval;
+}
+
+void StableSolver2D::setAdaptive(float cfl, float interval)
+{
+    adaptCFL = cfl > 0.0f ? cfl : 0.0f;
+    adaptInterval = interval > 0.0f ? interval : 1.0f;
+}
+
+void StableSolver2D::anim_adaptive()
+{
+    if(running == 0) return;
+    TraceScope scope("anim_adaptive");
+    float step = time_step;
+    float remaining = adaptInterval;
+
+    //the substeps are worked out again after each one, the velocity they go by
+    //is the one the last projection left
+    for(int left=COURANT_MAX_SUBSTEPS; left>0; left--)
+    {
+        int steps = courantSteps(remaining, velMax, adaptCFL, left);
+        time_step = remaining/steps;
+        anim_vel();
+        anim_tex();
+        anim_den();
+        if(steps == 1) break;
+        remaining -= time_step;
+    }
+    time_step = step;
 }
 
 void StableSolver2D::setBoundary(float *value, int flag)
@@ -232,24 +511,19 @@ void StableSolver2D::setBoundary(float *value, int flag)
     value[getIndex(dim+1, dim+1)]    = 0.5f*(value[getIndex(dim, dim+1)]+value[getIndex(dim+1, dim)]);
 }
 
-void StableSolver2D::lin_solve(float *value, float * value0, float a, float c, int flag)
+void StableSolver2D::lin_solve(float *value, float * value0, float a, float c, int flag, Relax *solve)
 {
-    for(int iteration=0; iteration<20; iteration++) 
+    if(solve == NULL) solve = &relax;
+    for(int iteration=0; iteration<iterations; iteration++) 
     {
-        for(int i=1; i<=rowSize; i++) 
-        { 
-            for(int j=1; j<=colSize; j++) 
-            {
-                value[getIndex(i, j)] = (value0[getIndex(i, j)] + a*(value[getIndex(i-1, j)]+value[getIndex(i+1, j)]+value[getIndex(i, j-1)]+value[getIndex(i, j+1)]))/c;
-            } 
-        }
-
+        solve->sweep(value, value0, rowSize+2, 1, rowSize, 1, colSize, a, c);
         setBoundary(value, flag);
     }
 }
 
 void StableSolver2D::advection(float *value, float *value0,  float *u, float *v, int flag)
 {
+    TraceScope scope("advection");
     int idxNow;
     float oldX;
     float oldY;
@@ -298,14 +572,16 @@ void StableSolver2D::advection(float *value, float *value0,  float *u, float *v,
     setBoundary(value, flag);
 }
 
-void StableSolver2D::diffusion(float *value, float *value0, float diff, int flag)
+void StableSolver2D::diffusion(float *value, float *value0, float diff, int flag, Relax *solve)
 {
+    TraceScope scope("diffusion");
     float a=time_step*diff; 
-    lin_solve(value, value0, a, 1+4*a, flag);
+    lin_solve(value, value0, a, 1+4*a, flag, solve);
 }
 
 void StableSolver2D::projection()
 {
+    TraceScope scope("projection");
     for(int i=1; i<=rowSize; i++) 
     { 
         for(int j=1; j<=colSize; j++) 
@@ -319,14 +595,172 @@ void StableSolver2D::projection()
 
     lin_solve(p, div, 1.0, 4.0, 0);
 
-    for(int i=1; i<=rowSize; i++) 
+    //row by row so the fastest velocity is picked up while the row is still in
+    //cache; the walls only mirror the interior
+    float fastest = 0.0f;
+    for(int j=1; j<=colSize; j++) 
     { 
-        for(int j=1; j<=colSize; j++) 
+        for(int i=1; i<=rowSize; i++) 
         {
             vx[getIndex(i,j)] -= 0.5f*(p[getIndex(i+1,j)]-p[getIndex(i-1,j)]);
             vy[getIndex(i,j)] -= 0.5f*(p[getIndex(i,j+1)]-p[getIndex(i,j-1)]);
         }
+        fastest = maxMagnitude(vx+getIndex(1, j), rowSize, fastest);
+        fastest = maxMagnitude(vy+getIndex(1, j), rowSize, fastest);
     }
+    velMax = fastest;
     setBoundary(vx, 1); 
     setBoundary(vy, 2);
 }
+
+void StableSolver2D::matchRelax(RelaxConfig config)
+{
+    RelaxConfig own = relax.getConfig();
+    own.scheme = config.scheme;
+    own.bandRows = config.bandRows;
+    relax.setConfig(own);
+
+    RelaxConfig scalar = scalarRelax.getConfig();
+    scalar.scheme = config.scheme;
+    scalar.bandRows = config.bandRows;
+    scalarRelax.setConfig(scalar);
+}
+
+void StableSolver2D::tuneRelax(const char *cachePath)
+{
+    RelaxConfig config;
+    autoTuneRelax("Texture2D", rowSize+2, colSize+2, cachePath, AUTOTUNE_BUDGET, &config);
+    relax.setConfig(config);
+}
+
+void StableSolver2D::fillDensImage(unsigned char *pixels)
+{
+    vertexDensityToRGBA(d, rowSize+2, getImgWidth(), getImgHeight(), pixels, getImgWidth());
+}
+
+void StableSolver2D::fillDensImage(unsigned char *pixels, DirtyRect rect)
+{
+    vertexDensityToRGBA(d+getIndex(rect.x0, rect.y0), rowSize+2, rect.x1-rect.x0+1, rect.y1-rect.y0+1,
+                        pixels+(rect.y0*getImgWidth()+rect.x0)*4, getImgWidth());
+}
+
+void StableSolver2D::fillSpeedImage(unsigned char *pixels, float scale)
+{
+    vertexSpeedToRGBA(vx, vy, rowSize+2, getImgWidth(), getImgHeight(), scale, pixels, getImgWidth());
+}
+
+void StableSolver2D::saveFrame(float *frame)
+{
+    memcpy(frame, vx, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(frame, vy, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(frame, d, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(frame, tx, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(frame, ty, sizeof(float)*totSize);
+}
+
+void StableSolver2D::loadFrame(const float *frame)
+{
+    memcpy(vx, frame, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(vy, frame, sizeof(float)*totSize);
+    frame += totSize;
+    //only the tiles that differ from the last frame are uploaded again
+    dirty.track(frame, d);
+    memcpy(d, frame, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(tx, frame, sizeof(float)*totSize);
+    frame += totSize;
+    memcpy(ty, frame, sizeof(float)*totSize);
+}
+
+void StableSolver2D::fillCheckpoint(CheckpointWriter *writer)
+{
+    writer->setSolver("Texture2D");
+    writer->addParam("rowSize", rowSize);
+    writer->addParam("colSize", colSize);
+    writer->addParam("timeStep", time_step);
+    writer->addParam("diff", diff);
+    writer->addParam("visc", visc);
+    writer->addParam("force", force);
+    writer->addParam("source", source);
+    writer->addParam("relaxScheme", relax.getConfig().scheme);
+    writer->addParam("relaxBandRows", relax.getConfig().bandRows);
+    writer->addField("vx", vx, rowSize+2, colSize+2);
+    writer->addField("vy", vy, rowSize+2, colSize+2);
+    writer->addField("d", d, rowSize+2, colSize+2);
+    writer->addField("tx", tx, rowSize+2, colSize+2);
+    writer->addField("ty", ty, rowSize+2, colSize+2);
+}
+
+int StableSolver2D::saveCheckpoint(const char *path)
+{
+    CheckpointWriter writer;
+    fillCheckpoint(&writer);
+    return writer.write(path);
+}
+
+int StableSolver2D::loadCheckpoint(const char *path, int keepSize)
+{
+    CheckpointReader reader;
+    if(!reader.open(path, "Texture2D")) return 0;
+
+    //the grid it was saved on, another run's or this one's before a resize
+    double value;
+    int newRowSize = reader.getParam("rowSize", &value) ? (int)value : rowSize;
+    int newColSize = reader.getParam("colSize", &value) ? (int)value : colSize;
+    if(keepSize && (newRowSize != rowSize || newColSize != colSize))
+    {
+        fprintf(stderr, "%s: checkpoint is %dx%d, the grid has to stay %dx%d\n", path, newRowSize, newColSize, rowSize, colSize);
+        return 0;
+    }
+
+    //nothing changes unless every field fits that grid
+    const char *names[] = {"vx", "vy", "d", "tx", "ty"};
+    for(int k=0; k<5; k++)
+    {
+        if(newRowSize < 4 || newColSize < 4 || !reader.getField(names[k], newRowSize+2, newColSize+2))
+        {
+            fprintf(stderr, "%s: checkpoint does not hold a %dx%d grid\n", path, newRowSize, newColSize);
+            return 0;
+        }
+    }
+    if(newRowSize != rowSize || newColSize != colSize)
+    {
+        release();
+        allocate(newRowSize, newColSize);
+        clear();
+    }
+
+    if(reader.getParam("timeStep", &value)) time_step = (float)value;
+    if(reader.getParam("diff", &value)) diff = (float)value;
+    if(reader.getParam("visc", &value)) visc = (float)value;
+    if(reader.getParam("force", &value)) force = (float)value;
+    if(reader.getParam("source", &value)) source = (float)value;
+
+    //resumes with the relaxation it was saved with
+    double bandRows;
+    if(reader.getParam("relaxScheme", &value) && reader.getParam("relaxBandRows", &bandRows))
+    {
+        RelaxConfig config = relax.getConfig();
+        config.scheme = (int)value;
+        config.bandRows = (int)bandRows;
+        matchRelax(config);
+    }
+
+    reader.readField("vx", vx, rowSize+2, colSize+2);
+    reader.readField("vy", vy, rowSize+2, colSize+2);
+    reader.readField("d", d, rowSize+2, colSize+2);
+    reader.readField("tx", tx, rowSize+2, colSize+2);
+    reader.readField("ty", ty, rowSize+2, colSize+2);
+    memcpy(pipeVX, vx, sizeof(float)*totSize);
+    memcpy(pipeVY, vy, sizeof(float)*totSize);
+    velPhase = 0;
+    velMax = maxMagnitude(vy, totSize, maxMagnitude(vx, totSize, 0.0f));
+
+    dirty.markAll();
+    return 1;
+}
@@ -22,6 +22,11 @@
 #ifndef __STABLESOLVER2D_H__
 #define __StABLESOLVER2D_H__
 
+#include "DirtyTiles.h"
+#include "Relax.h"
+
+class CheckpointWriter;
+
 class StableSolver2D
 {
 public:
@@ -33,11 +38,63 @@ public:
     int isRunning(){ return running; }
 
     void reset(int _rowSize, int _colSize);
+    //resamples the velocity, density and texture coordinates onto a newRowSize x
+    //newColSize grid and projects again, the picture carries on at the new size;
+    //returns 1 on success
+    int resize(int newRowSize, int newColSize);
     void clear();
     void addSource();
     void anim_vel();
     void anim_den();
     void anim_tex();
+    //pipelined stepping, the texture coordinates and density of step n move on
+    //pipeVX/pipeVY on their own threads while the velocity of step n+1 is
+    //computed, so they lag one step behind the velocity. set once the
+    //relaxation is configured, it splits the relaxation threads between the halves
+    void setPipelined(int on);
+    int isPipelined(){ return pipelined; }
+    //anim_vel next to anim_tex and anim_den, what step_solver does in turn
+    void anim_pipelined();
+    //multi-rate stepping, the velocity moves every steps steps, a whole interval
+    //at a time, and the texture coordinates and density every step on the velocity
+    //blended from the start to the end of the interval, or on the end velocity
+    //held if blend is 0
+    void setVelInterval(int steps, int blend);
+    int getVelInterval(){ return velInterval; }
+    //anim_vel when an interval starts, anim_tex and anim_den every step
+    void anim_multirate();
+    //adaptive stepping, every step covers interval units of time in as few substeps
+    //as keep the velocity under cfl cells a substep; cfl 0 steps time_step as ever
+    void setAdaptive(float cfl, float interval);
+    float getCFL(){ return adaptCFL; }
+    //anim_vel, anim_tex and anim_den once per substep
+    void anim_adaptive();
+
+    //animtate
+    void setBoundary(float *value, int flag);
+    //solve is the relaxation to iterate with, NULL for the solver's own
+    void lin_solve(float *value, float * value0, float a, float c, int flag, Relax *solve=NULL);
+    void advection(float *value, float *value0, float *u, float *v, int flag);
+    void diffusion(float *value, float *value0, float diff, int flag, Relax *solve=NULL);
+    void projection();
+    //relaxation of the diffusion and pressure solves
+    void setRelaxConfig(RelaxConfig config){ relax.setConfig(config); }
+    RelaxConfig getRelaxConfig(){ return relax.getConfig(); }
+    //the scheme and band rows of config on this solver's own threads; the scheme
+    //decides the numbers a step gives, the threads do not
+    void matchRelax(RelaxConfig config);
+    //sweeps per diffusion and pressure solve, 20 unless traded for time
+    void setIterations(int value){ iterations = value; }
+    //anim_tex only advects the texture coordinates while off
+    void setTexDiffusion(int on){ texDiffusion = on; }
+    //the fastest relaxation for this grid, timed once per machine and kept in cachePath
+    void tuneRelax(const char *cachePath);
+
+    //checkpoint, returns 1 on success; a checkpoint of another size brings its grid
+    //along unless keepSize is set
+    void fillCheckpoint(CheckpointWriter *writer);
+    int saveCheckpoint(const char *path);
+    int loadCheckpoint(const char *path, int keepSize=0);
 
     float getForce(){ return force; }
     float getSource(){ return source; }
@@ -54,11 +111,28 @@ public:
     float* getD(){ return d; }
     float* getTX(){ return tx; }
     float* getTY(){ return ty;}
+    //the largest velocity component as of the last projection or addSource
+    float getVelMax(){ return velMax; }
     float getDens(int i, int j){ return (d[getIndex(i-1, j-1)] +  d[getIndex(i, j-1)] + d[getIndex(i-1, j)] + d[getIndex(i, j)])/4.0f; }
 
+    //display, one RGBA8 pixel per grid vertex 1..rowSize+1 x 1..colSize+1
+    int getImgWidth(){ return rowSize+1; }
+    int getImgHeight(){ return colSize+1; }
+    void fillDensImage(unsigned char *pixels);
+    void fillDensImage(unsigned char *pixels, DirtyRect rect);
+    void fillSpeedImage(unsigned char *pixels, float scale);
+    DirtyTiles* getDirty(){ return &dirty; }
+    //the fields the viewer draws packed into one frame, so a copy of the solver
+    //can be drawn while the solver itself goes on stepping
+    int getFrameSize(){ return 5*totSize; }
+    void saveFrame(float *frame);
+    void loadFrame(const float *frame);
+
     void setVX0(int i, int j, float _vx0){ vx0[getIndex(i, j)] = _vx0; }
     void setVY0(int i, int j, float _vy0){ vy0[getIndex(i, j)] = _vy0; }
     void setD0(int i, int j, float _d0){ d0[getIndex(i, j)] = _d0; }
+    //rate the velocity diffuses at, cells^2 per step
+    void setViscosity(float value){ visc = value; }
 
     void cleanBuffer()
     {
@@ -71,13 +145,11 @@ public:
     }
 
 private:
-
-    //animtate
-    void setBoundary(float *value, int flag);
-    void lin_solve(float *value, float * value0, float a, float c, int flag);
-    void advection(float *value, float *value0, float *u, float *v, int flag);
-    void diffusion(float *value, float *value0, float diff, int flag);
-    void projection();
+    void allocate(int _rowSize, int _colSize);
+    void release();
+    void transport_den(float *u, float *v, Relax *solve);
+    void transport_tex(float *u, float *v, Relax *solve);
+    static void pipelineHalf(void *arg, int begin, int end);
 
 private:
     int running;
@@ -86,6 +158,8 @@ private:
     float visc;
     float force;
     float source;
+    int iterations;
+    int texDiffusion;
 
     int rowSize;
     int colSize;
@@ -116,6 +190,31 @@ private:
 
     float *p;
     float *div;
+
+    //display regions changed by addSource/anim_den
+    DirtyTiles dirty;
+    Relax relax;
+
+    //pipelined stepping
+    int pipelined;
+    float *pipeVX;
+    float *pipeVY;
+    ThreadPool pipeline;
+    Relax scalarRelax;
+
+    //multi-rate stepping
+    int velInterval;
+    int velBlend;
+    int velPhase;
+    float *multiVX0;
+    float *multiVY0;
+    float *multiVX;
+    float *multiVY;
+
+    //adaptive stepping
+    float adaptCFL;
+    float adaptInterval;
+    float velMax;
 };
 
 #endif
@@ -0,0 +1,162 @@
+/** File:    TexWarp.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#include "TexWarp.h"
+#include "StableSolver2D.h"
+#include "ThreadPool.h"
+#include <stdlib.h>
+#include <string.h>
+#include <math.h>
+
+#ifdef __SSE2__
+#include <emmintrin.h>
+#endif
+
+TexWarp::TexWarp()
+{
+    pixels = NULL;
+    imgWidth = 0;
+    imgHeight = 0;
+}
+
+TexWarp::~TexWarp()
+{
+}
+
+void TexWarp::setImage(const unsigned char *_pixels, int _imgWidth, int _imgHeight)
+{
+    pixels = _pixels;
+    imgWidth = _imgWidth;
+    imgHeight = _imgHeight;
+}
+
+void TexWarp::render(StableSolver2D *_solver, unsigned char *_out, int _outWidth, int _outHeight, ThreadPool *pool)
+{
+    if(!pixels) return;
+
+    solver = _solver;
+    out = _out;
+    outWidth = _outWidth;
+    outHeight = _outHeight;
+
+    if(pool) pool->run(renderTask, this, outHeight, 8);
+    else renderRows(0, outHeight);
+}
+
+void TexWarp::renderTask(void *arg, int begin, int end)
+{
+    ((TexWarp *)arg)->renderRows(begin, end);
+}
+
+//bilinear lookup with 8 bit weights, texel coordinates have their centers on integers
+unsigned int TexWarp::sample(float u, float v)
+{
+    float fu = floorf(u);
+    float fv = floorf(v);
+    int wx = (int)((u-fu)*256.0f+0.5f);
+    int wy = (int)((v-fv)*256.0f+0.5f);
+
+    int x0 = (int)fu % imgWidth;
+    int y0 = (int)fv % imgHeight;
+    if(x0 < 0) x0 += imgWidth;
+    if(y0 < 0) y0 += imgHeight;
+    int x1 = x0+1 < imgWidth ? x0+1 : 0;
+    int y1 = y0+1 < imgHeight ? y0+1 : 0;
+
+    const unsigned int *img = (const unsigned int *)pixels;
+    unsigned int p00 = img[y0*imgWidth+x0];
+    unsigned int p10 = img[y0*imgWidth+x1];
+    unsigned int p01 = img[y1*imgWidth+x0];
+    unsigned int p11 = img[y1*imgWidth+x1];
+
+#ifdef __SSE2__
+    //all four channels of two texels side by side in 16 bit lanes
+    const __m128i zero = _mm_setzero_si128();
+    __m128i bottom = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)p00), _mm_cvtsi32_si128((int)p10)), zero);
+    __m128i top = _mm_unpacklo_epi8(_mm_unpacklo_epi32(_mm_cvtsi32_si128((int)p01), _mm_cvtsi32_si128((int)p11)), zero);
+
+    __m128i row = _mm_add_epi16(_mm_mullo_epi16(bottom, _mm_set1_epi16((short)(256-wy))),
+                                _mm_mullo_epi16(top, _mm_set1_epi16((short)wy)));
+    row = _mm_srli_epi16(row, 8);
+
+    __m128i left = _mm_mullo_epi16(row, _mm_set1_epi16((short)(256-wx)));
+    __m128i right = _mm_mullo_epi16(_mm_srli_si128(row, 8), _mm_set1_epi16((short)wx));
+    __m128i texel = _mm_srli_epi16(_mm_add_epi16(left, right), 8);
+
+    return (unsigned int)_mm_cvtsi128_si32(_mm_packus_epi16(texel, zero));
+#else
+    unsigned int texel = 0;
+    for(int c=0; c<32; c+=8)
+    {
+        unsigned int left = (((p00>>c)&0xFF)*(256-wy)+((p01>>c)&0xFF)*wy)>>8;
+        unsigned int right = (((p10>>c)&0xFF)*(256-wy)+((p11>>c)&0xFF)*wy)>>8;
+        texel |= ((left*(256-wx)+right*wx)>>8)<<c;
+    }
+    return texel;
+#endif
+}
+
+void TexWarp::renderRows(int y0, int y1)
+{
+    int rowSize = solver->getRowSize();
+    int colSize = solver->getColSize();
+    float *tx = solver->getTX();
+    float *ty = solver->getTY();
+
+    //texture coordinates of one row of vertices, already in texels
+    float *rowU = (float *)malloc(sizeof(float)*(rowSize+1));
+    float *rowV = (float *)malloc(sizeof(float)*(rowSize+1));
+
+    float scaleU = (float)imgWidth/(float)rowSize;
+    float scaleV = (float)imgHeight/(float)colSize;
+    float stepX = (float)rowSize/(float)outWidth;
+    float stepY = (float)colSize/(float)outHeight;
+
+    for(int oy=y0; oy<y1; oy++)
+    {
+        float gy = ((float)oy+0.5f)*stepY;
+        int j = (int)gy;
+        if(j > colSize-1) j = colSize-1;
+        float fy = gy-(float)j;
+
+        for(int i=0; i<=rowSize; i++)
+        {
+            int idx0 = solver->getIndex(i, j);
+            int idx1 = solver->getIndex(i, j+1);
+            rowU[i] = (tx[idx0]+fy*(tx[idx1]-tx[idx0])-0.5f)*scaleU-0.5f;
+            rowV[i] = (ty[idx0]+fy*(ty[idx1]-ty[idx0])-0.5f)*scaleV-0.5f;
+        }
+
+        unsigned int *dst = (unsigned int *)(out+(size_t)oy*outWidth*4);
+        for(int ox=0; ox<outWidth; ox++)
+        {
+            float gx = ((float)ox+0.5f)*stepX;
+            int i = (int)gx;
+            if(i > rowSize-1) i = rowSize-1;
+            float fx = gx-(float)i;
+
+            dst[ox] = sample(rowU[i]+fx*(rowU[i+1]-rowU[i]), rowV[i]+fx*(rowV[i+1]-rowV[i]));
+        }
+    }
+
+    free(rowU);
+    free(rowV);
+}
@@ -0,0 +1,57 @@
+/** File:    TexWarp.h
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+#ifndef __TEXWARP_H__
+#define __TEXWARP_H__
+
+class StableSolver2D;
+class ThreadPool;
+
+//CPU renderer for the advected texture, the same picture draw_texture() shows
+//output pixel (x, y) lies on the fluid area [1, rowSize+1]x[1, colSize+1], where it
+//interpolates tx/ty between the grid vertices and samples the image bilinearly
+//with repeat wrapping; images and output are RGBA8 with row 0 at the bottom
+class TexWarp
+{
+public:
+    TexWarp();
+    ~TexWarp();
+    void setImage(const unsigned char *_pixels, int _imgWidth, int _imgHeight);
+    void render(StableSolver2D *solver, unsigned char *out, int outWidth, int outHeight, ThreadPool *pool);
+
+private:
+    static void renderTask(void *arg, int begin, int end);
+    void renderRows(int y0, int y1);
+    unsigned int sample(float u, float v);
+
+private:
+    const unsigned char *pixels;
+    int imgWidth;
+    int imgHeight;
+
+    //current render call
+    StableSolver2D *solver;
+    unsigned char *out;
+    int outWidth;
+    int outHeight;
+};
+
+#endif
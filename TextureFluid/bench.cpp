@@ -0,0 +1,97 @@
+/** File:    bench.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+//"make bench" times every kernel of the solver on its own, see KernelBench.h for the options
+
+#include "StableSolver2D.h"
+#include "KernelBench.h"
+#include <stdlib.h>
+#include <math.h>
+
+StableSolver2D *solver;
+float *field;
+float *field0;
+
+//a smooth swirl of a couple of cells per step, so advection samples all over the grid
+void init_fields(int size)
+{
+    float *vx = solver->getVX();
+    float *vy = solver->getVY();
+    float *d = solver->getD();
+    for(int j=0; j<size+2; j++)
+    {
+        for(int i=0; i<size+2; i++)
+        {
+            int index = solver->getIndex(i, j);
+            float x = 6.2831853f*i/size;
+            float y = 6.2831853f*j/size;
+            vx[index] = 2.0f*sinf(y)*cosf(x);
+            vy[index] = -2.0f*sinf(x)*cosf(y);
+            d[index] = 0.5f+0.5f*sinf(3.0f*x)*sinf(2.0f*y);
+            field0[index] = d[index];
+            field[index] = 0.0f;
+        }
+    }
+}
+
+void bench_advection(void *arg){ solver->advection(field, field0, solver->getVX(), solver->getVY(), 0); }
+void bench_diffusion(void *arg){ solver->diffusion(field, field0, 0.1f, 0); }
+void bench_lin_solve(void *arg){ solver->lin_solve(field, field0, 1.0f, 4.0f, 0); }
+void bench_projection(void *arg){ solver->projection(); }
+void bench_setBoundary(void *arg){ solver->setBoundary(field, 0); }
+void bench_addSource(void *arg){ solver->addSource(); }
+
+int main(int argc, char **argv)
+{
+    KernelBench bench;
+    if(!bench.parseArgs(argc, argv)) return 1;
+    if(!bench.begin("Texture2D")) return 1;
+
+    for(int k=0; k<bench.getNumSizes(); k++)
+    {
+        int size = bench.getSize(k);
+        double cells = (double)size*size;
+
+        solver = new StableSolver2D();
+        solver->reset(size, size);
+        RelaxConfig relax;
+        if(bench.getRelax(&relax)) solver->setRelaxConfig(relax);
+        solver->cleanBuffer();
+        field = (float *)malloc(sizeof(float)*(size+2)*(size+2));
+        field0 = (float *)malloc(sizeof(float)*(size+2)*(size+2));
+        init_fields(size);
+
+        //bytes per cell are what each kernel has to read and write at least, flops count
+        //every add, multiply, divide and square root of its inner loop; a sweep is 6,
+        //three adds over the neighbours, the multiply by a, the add of b and the divide
+        bench.run("advection", size, cells, 24, 19, bench_advection, NULL);
+        bench.run("diffusion", size, cells, 20*12, 20*6, bench_diffusion, NULL);
+        bench.run("lin_solve", size, cells, 20*12, 20*6, bench_lin_solve, NULL);
+        bench.run("projection", size, cells, 16+20*12+20, 4+20*6+6, bench_projection, NULL);
+        bench.run("setBoundary", size, 4.0*size, 8, 0, bench_setBoundary, NULL);
+        bench.run("addSource", size, cells, 40, 3, bench_addSource, NULL);
+
+        free(field);
+        free(field0);
+        delete solver;
+    }
+    return bench.end() ? 0 : 1;
+}
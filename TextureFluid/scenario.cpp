@@ -0,0 +1,102 @@
+/** File:    scenario.cpp
+ ** Author:  Dongli Zhang
+ ** Contact: dongli.zhang0129@gmail.com
+ **
+ ** Copyright (C) Dongli Zhang 2013
+ **
+ ** This program is free software;  you can redistribute it and/or modify
+ ** it under the terms of the GNU General Public License as published by
+ ** the Free Software Foundation; either version 2 of the License, or
+ ** (at your option) any later version.
+ **
+ ** This program is distributed in the hope that it will be useful,
+ ** but WITHOUT ANY WARRANTY;  without even the implied warranty of
+ ** MERCHANTABILITY or FITNESS FOR A PARTICULAR PURPOSE.  See
+ ** the GNU General Public License for more details.
+ **
+ ** You should have received a copy of the GNU General Public License
+ ** along with this program;  if not, write to the Free Software 
+ ** Foundation, 51 Franklin Street, Fifth Floor, Boston, MA 02110-1301 USA
+ */
+
+//"make scenario" runs the canonical scenarios on the solver, see ScenarioBench.h for the options
+
+#include "StableSolver2D.h"
+#include "ScenarioBench.h"
+#include <stdlib.h>
+
+//fluid cell (i, j) of the scenario is cell (i+1, j+1), the outer ring holds the walls
+StableSolver2D *solver;
+int n;
+
+int idx(int i, int j){ return solver->getIndex(i+1, j+1); }
+
+void tex_reset(int _n, float visc)
+{
+    n = _n;
+    delete solver;
+    solver = new StableSolver2D();
+    solver->reset(n, n);
+    solver->setViscosity(visc);
+}
+
+void tex_setRelax(RelaxConfig config){ solver->setRelaxConfig(config); }
+
+void tex_setVelocity(VelocityFunc func, void *arg)
+{
+    float *vx = solver->getVX();
+    float *vy = solver->getVY();
+    for(int j=0; j<n; j++)
+    {
+        for(int i=0; i<n; i++)
+        {
+            float u;
+            float v;
+            if(!func(arg, i+0.5f, j+0.5f, &u, &v)) continue;
+            vx[idx(i, j)] = u;
+            vy[idx(i, j)] = v;
+        }
+    }
+    solver->setBoundary(vx, 1);
+    solver->setBoundary(vy, 2);
+}
+
+void tex_addDensity(int i, int j, float value){ solver->setD0(i+1, j+1, value); }
+
+void tex_step()
+{
+    solver->addSource();
+    solver->anim_vel();
+    solver->anim_tex();
+    solver->anim_den();
+    solver->cleanBuffer();
+}
+
+void tex_getVelocity(int i, int j, float *u, float *v)
+{
+    *u = solver->getVX()[idx(i, j)];
+    *v = solver->getVY()[idx(i, j)];
+}
+
+//the central difference projection() drives to zero
+float tex_getDivergence(int i, int j)
+{
+    float *vx = solver->getVX();
+    float *vy = solver->getVY();
+    return 0.5f*(vx[idx(i+1, j)]-vx[idx(i-1, j)]+vy[idx(i, j+1)]-vy[idx(i, j-1)]);
+}
+
+float tex_getDensity(int i, int j){ return solver->getD()[idx(i, j)]; }
+
+int main(int argc, char **argv)
+{
+    ScenarioBench bench;
+    if(!bench.parseArgs(argc, argv)) return 1;
+    if(!bench.begin("Texture2D")) return 1;
+
+    ScenarioSolver hooks = {tex_reset, tex_setRelax, tex_setVelocity, tex_addDensity, tex_step,
+                            tex_getVelocity, tex_getDivergence, tex_getDensity};
+    bench.run(&hooks);
+    delete solver;
+    return bench.end() ? 0 : 1;
+}